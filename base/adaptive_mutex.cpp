@@ -0,0 +1,47 @@
+#include "adaptive_mutex.h"
+
+#include <unistd.h>
+
+using namespace kaycc;
+
+namespace {
+    const bool g_multiCore = ::sysconf(_SC_NPROCESSORS_ONLN) > 1;
+
+    inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#else
+        __asm__ __volatile__("" ::: "memory");
+#endif
+    }
+}
+
+void AdaptiveMutex::lockSlow() {
+    if (g_multiCore) {
+        int spins = spins_.load(std::memory_order_relaxed);
+        int maxSpins = spins * 2 + 10;
+        if (maxSpins > kMaxSpins) {
+            maxSpins = kMaxSpins;
+        }
+
+        int count = 0;
+        while (count < maxSpins) {
+            ++count;
+            cpuRelax();
+            // 先普通读，看到未加锁再CAS，避免自旋时不停地独占cache line
+            if (__atomic_load_n(&state_, __ATOMIC_RELAXED) == 0 && tryLock()) {
+                spins_.store(spins + (count - spins) / 8, std::memory_order_relaxed);
+                return;
+            }
+        }
+        spins_.store(spins + (count - spins) / 8, std::memory_order_relaxed);
+    }
+
+    // 标记为2（有等待者）后休眠，被唤醒后再把状态换成2去抢锁，
+    // 这样抢到锁的线程解锁时一定会去唤醒下一个等待者
+    int32_t c = __atomic_exchange_n(&state_, 2, __ATOMIC_ACQUIRE);
+    while (c != 0) {
+        futex::wait(&state_, 2);
+        c = __atomic_exchange_n(&state_, 2, __ATOMIC_ACQUIRE);
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef KAYCC_BASE_ADAPTIVEMUTEX_H
+#define KAYCC_BASE_ADAPTIVEMUTEX_H
+
+#include "futex.h"
+
+#include <boost/noncopyable.hpp>
+
+#include <atomic>
+#include <stdint.h>
+
+/*
+自适应互斥锁：加锁失败时先自旋一小段时间，持有者很快释放的话就不用进入内核休眠；
+自旋失败再在futex上休眠。适合临界区很短、竞争时持有者大多正在运行的场景。
+state_：0未加锁，1加锁且没有等待者，2加锁且可能有等待者（解锁时需要futex唤醒）。
+自旋次数根据最近的情况自适应（类似glibc的PTHREAD_MUTEX_ADAPTIVE_NP）：
+自旋能成功就逐渐允许多转几圈，总是失败就少转几圈。单核机器上不自旋。
+不记录持有者，也不能和Condition一起使用。
+*/
+
+namespace kaycc {
+
+    class AdaptiveMutex : boost::noncopyable {
+    public:
+        AdaptiveMutex()
+            : state_(0),
+              spins_(0) {
+        }
+
+        void lock() {
+            int32_t expected = 0;
+            if (__atomic_compare_exchange_n(&state_, &expected, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                return;
+            }
+            lockSlow();
+        }
+
+        bool tryLock() {
+            int32_t expected = 0;
+            return __atomic_compare_exchange_n(&state_, &expected, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+        }
+
+        void unlock() {
+            // 之前是2说明可能有线程在futex上休眠
+            if (__atomic_exchange_n(&state_, 0, __ATOMIC_RELEASE) == 2) {
+                futex::wake(&state_, 1);
+            }
+        }
+
+    private:
+        static const int kMaxSpins = 100;
+
+        void lockSlow();
+
+        volatile int32_t state_;
+        std::atomic<int> spins_; //自旋次数的滑动平均，不需要精确，relaxed读写，并发更新时丢掉一次也没关系
+    };
+
+    class AdaptiveMutexGuard : boost::noncopyable {
+    public:
+        explicit AdaptiveMutexGuard(AdaptiveMutex& mutex)
+            : mutex_(mutex) {
+            mutex_.lock();
+        }
+
+        ~AdaptiveMutexGuard() {
+            mutex_.unlock();
+        }
+
+    private:
+        AdaptiveMutex& mutex_;
+    };
+
+}
+
+#define AdaptiveMutexGuard(x) error "Missing guard object name"
+
+#endif
@@ -0,0 +1,219 @@
+#include "async_logging.h"
+
+#include "log.h"
+#include "log_file.h"
+#include "timestamp.h"
+
+#include <boost/bind.hpp>
+
+#include <atomic>
+
+#include <stdio.h>
+
+using namespace kaycc;
+
+namespace {
+    // 其他线程可能正在写日志时被替换，用原子变量；刚换回stdout时读到NULL就直接写stdout
+    std::atomic<AsyncLogging*> g_asyncLog(NULL);
+
+    void asyncOutput(const char* msg, int len) {
+        AsyncLogging* log = g_asyncLog.load(std::memory_order_acquire);
+        if (log != NULL) {
+            log->append(msg, len);
+        } else {
+            ::fwrite(msg, 1, len, stdout);
+        }
+    }
+
+    void asyncFlush() {
+        AsyncLogging* log = g_asyncLog.load(std::memory_order_acquire);
+        if (log != NULL) {
+            log->flush();
+        } else {
+            ::fflush(stdout);
+        }
+    }
+}
+
+AsyncLogging::AsyncLogging(const std::string& basename, off_t rollSize, int flushInterval, size_t maxBuffers)
+    : flushInterval_(flushInterval),
+      maxBuffers_(maxBuffers),
+      basename_(basename),
+      rollSize_(rollSize),
+      running_(false),
+      thread_(boost::bind(&AsyncLogging::threadFunc, this), "Logging"),
+      latch_(1),
+      mutex_(),
+      cond_(mutex_),
+      currentBuffer_(new Buffer),
+      nextBuffer_(new Buffer),
+      buffers_(),
+      flushRequested_(0),
+      flushedUpTo_(0),
+      flushCond_(mutex_) {
+    buffers_.reserve(maxBuffers_);
+}
+
+AsyncLogging::~AsyncLogging() {
+    if (running_) {
+        stop();
+    }
+}
+
+void AsyncLogging::start() {
+    running_ = true;
+    thread_.start();
+    latch_.wait();
+}
+
+void AsyncLogging::stop() {
+    {
+        MutexLockGuard lock(mutex_); //后台线程检查running_和wait之间不会漏掉通知
+        running_ = false;
+        cond_.notify();
+    }
+    thread_.join();
+}
+
+void AsyncLogging::setAsLoggerOutput(AsyncLogging* log) {
+    // 先发布log再换输出函数；换回stdout时反过来，先换输出函数
+    if (log != NULL) {
+        g_asyncLog.store(log, std::memory_order_release);
+        Logger::setOutput(asyncOutput);
+        Logger::setFlush(asyncFlush);
+    } else {
+        Logger::setOutput(NULL);
+        Logger::setFlush(NULL);
+        g_asyncLog.store(NULL, std::memory_order_release);
+    }
+}
+
+void AsyncLogging::append(const char* logline, int len) {
+    if (static_cast<size_t>(len) >= kBufferSize) {
+        len = static_cast<int>(kBufferSize - 1); //超长的一行截断，保证一定能放进空缓冲
+    }
+
+    MutexLockGuard lock(mutex_);
+    if (currentBuffer_->avail() > static_cast<size_t>(len)) {
+        currentBuffer_->append(logline, len);
+        return;
+    }
+
+    // 当前缓冲满了。后台积压太多时丢弃这条日志，不再分配新缓冲
+    if (buffers_.size() >= maxBuffers_) {
+        dropped_.incrementRelaxed();
+        return;
+    }
+
+    buffers_.push_back(std::move(currentBuffer_));
+    if (nextBuffer_) {
+        currentBuffer_ = std::move(nextBuffer_);
+    } else {
+        currentBuffer_.reset(new Buffer); //很少发生，前端写得太快，两块缓冲都用完了
+    }
+    currentBuffer_->append(logline, len);
+    cond_.notify();
+}
+
+void AsyncLogging::flush() {
+    if (!running_) {
+        return;
+    }
+
+    MutexLockGuard lock(mutex_);
+    int64_t ticket = ++flushRequested_;
+    cond_.notify();
+    while (flushedUpTo_ < ticket && running_) {
+        flushCond_.waitForSeconds(flushInterval_);
+    }
+}
+
+void AsyncLogging::threadFunc() {
+    assert(running_ == true);
+    latch_.countDown();
+
+    LogFile output(basename_, rollSize_, flushInterval_);
+    // 后台线程自己的两块缓冲，用来和前端交换
+    BufferPtr newBuffer1(new Buffer);
+    BufferPtr newBuffer2(new Buffer);
+    BufferVector buffersToWrite;
+    buffersToWrite.reserve(maxBuffers_ + 1);
+    int64_t lastDropped = 0;
+
+    while (running_) {
+        assert(newBuffer1 && newBuffer1->length() == 0);
+        assert(newBuffer2 && newBuffer2->length() == 0);
+        assert(buffersToWrite.empty());
+
+        int64_t flushTicket = 0;
+        {
+            MutexLockGuard lock(mutex_);
+            // 没有写满的缓冲、也没有flush请求时最多等待flushInterval_秒
+            if (buffers_.empty() && flushRequested_ == flushedUpTo_) {
+                cond_.waitForSeconds(flushInterval_);
+            }
+            buffers_.push_back(std::move(currentBuffer_));
+            currentBuffer_ = std::move(newBuffer1);
+            buffersToWrite.swap(buffers_);
+            if (!nextBuffer_) {
+                nextBuffer_ = std::move(newBuffer2);
+            }
+            flushTicket = flushRequested_;
+        }
+
+        // 以下都在锁外，前端可以继续写
+        int64_t dropped = dropped_.get();
+        if (dropped != lastDropped) {
+            char buf[128];
+            int n = ::snprintf(buf, sizeof buf, "%s AsyncLogging dropped %lld log messages (%lld in total)\n",
+                               Timestamp::now().toString().c_str(),
+                               static_cast<long long>(dropped - lastDropped),
+                               static_cast<long long>(dropped));
+            output.append(buf, n);
+            lastDropped = dropped;
+        }
+
+        for (size_t i = 0; i < buffersToWrite.size(); ++i) {
+            output.append(buffersToWrite[i]->data(), buffersToWrite[i]->length());
+        }
+
+        // 只留两块缓冲换回去，多出来的（前端临时分配的）释放掉
+        if (buffersToWrite.size() > 2) {
+            buffersToWrite.resize(2);
+        }
+
+        if (!newBuffer1) {
+            newBuffer1 = std::move(buffersToWrite.back());
+            buffersToWrite.pop_back();
+            newBuffer1->reset();
+        }
+
+        if (!newBuffer2) {
+            newBuffer2 = std::move(buffersToWrite.back());
+            buffersToWrite.pop_back();
+            newBuffer2->reset();
+        }
+
+        buffersToWrite.clear();
+        output.flush();
+
+        if (flushTicket != 0) {
+            MutexLockGuard lock(mutex_);
+            flushedUpTo_ = flushTicket;
+            flushCond_.notifyAll();
+        }
+    }
+
+    // 退出前把剩下的日志写完
+    {
+        MutexLockGuard lock(mutex_);
+        buffers_.push_back(std::move(currentBuffer_));
+        buffersToWrite.swap(buffers_);
+        flushedUpTo_ = flushRequested_;
+        flushCond_.notifyAll();
+    }
+    for (size_t i = 0; i < buffersToWrite.size(); ++i) {
+        output.append(buffersToWrite[i]->data(), buffersToWrite[i]->length());
+    }
+    output.flush();
+}
@@ -0,0 +1,112 @@
+#ifndef KAYCC_BASE_ASYNCLOGGING_H
+#define KAYCC_BASE_ASYNCLOGGING_H
+
+#include "atomic.h"
+#include "condition.h"
+#include "latch.h"
+#include "mutex.h"
+#include "thread.h"
+
+#include <boost/noncopyable.hpp>
+
+#include <atomic>
+#include <memory>
+#include <string.h>
+#include <string>
+#include <vector>
+
+/*
+异步日志后端（双缓冲）。
+前端（任意线程）append只是在锁内把日志拷贝进当前缓冲，不做任何I/O；
+当前缓冲写满后换上备用缓冲，写满的缓冲交给后台线程。
+后台线程每flushInterval秒或者有缓冲写满时醒来，把所有写满的缓冲和当前缓冲一起换出来，
+在锁外批量写入LogFile，写完的缓冲再换回来给前端复用，稳定运行时不分配内存。
+后台跟不上时（排队的缓冲达到maxBuffers个），前端直接丢弃日志并计数，不会阻塞也不会无限占用内存，
+后台线程会把丢弃的条数写进日志文件。
+接到Logger下面：
+    AsyncLogging log("/var/log/server", 500 * 1000 * 1000);
+    log.start();
+    AsyncLogging::setAsLoggerOutput(&log);
+*/
+
+namespace kaycc {
+
+    class AsyncLogging : boost::noncopyable {
+    public:
+        static const size_t kBufferSize = 4 * 1024 * 1024;
+
+        AsyncLogging(const std::string& basename,
+                     off_t rollSize,
+                     int flushInterval = 3,
+                     size_t maxBuffers = 16);
+        ~AsyncLogging();
+
+        // 前端接口，线程安全，不会阻塞在磁盘I/O上
+        void append(const char* logline, int len);
+
+        void start();
+        void stop();
+
+        // 等待到目前为止append的日志都写到文件（LOG_FATAL abort前调用）
+        void flush();
+
+        int64_t droppedCount() const {
+            return dropped_.get();
+        }
+
+        // 把Logger的输出换成log，传NULL恢复stdout。可以在其他线程写日志时调用，
+        // 但log要在换回stdout、并且其他线程不再写日志之后才能析构
+        static void setAsLoggerOutput(AsyncLogging* log);
+
+    private:
+        class Buffer : boost::noncopyable {
+        public:
+            Buffer() : cur_(data_) {}
+
+            size_t avail() const { return static_cast<size_t>(end() - cur_); }
+            size_t length() const { return static_cast<size_t>(cur_ - data_); }
+            const char* data() const { return data_; }
+
+            void append(const char* buf, size_t len) {
+                ::memcpy(cur_, buf, len);
+                cur_ += len;
+            }
+
+            void reset() { cur_ = data_; }
+
+        private:
+            const char* end() const { return data_ + sizeof(data_); }
+
+            char data_[kBufferSize];
+            char* cur_;
+        };
+
+        typedef std::unique_ptr<Buffer> BufferPtr;
+        typedef std::vector<BufferPtr> BufferVector;
+
+        void threadFunc();
+
+        const int flushInterval_;
+        const size_t maxBuffers_; //排队等待写入的缓冲最多几个
+        const std::string basename_;
+        const off_t rollSize_;
+
+        std::atomic<bool> running_;
+        Thread thread_;
+        Latch latch_; //等待后台线程启动
+
+        MutexLock mutex_;
+        Condition cond_;
+        BufferPtr currentBuffer_;
+        BufferPtr nextBuffer_;   //备用缓冲，当前缓冲写满时直接换上
+        BufferVector buffers_;   //写满等待写入的缓冲
+        int64_t flushRequested_; //flush()请求的序号
+        int64_t flushedUpTo_;    //后台线程已经完成的flush序号
+        Condition flushCond_;
+
+        AtomicInt64 dropped_;
+    };
+
+}
+
+#endif
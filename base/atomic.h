@@ -2,29 +2,58 @@
 #define KAYCC_BASE_ATOMIC_H
 
 #include <boost/noncopyable.hpp>
+#include <atomic>
 #include <stdint.h>
 
-namespace kaycc { 
+namespace kaycc {
 namespace atomics {
-	
+
+	// 基于std::atomic的整数。
+	// 不带后缀的操作都是memory_order_seq_cst，与原来__sync版本的语义一致；
+	// get()现在只是一次普通的load（x86上就是一条mov），不再用CAS读，不会独占cache line。
+	// 统计计数之类不需要同步其他内存的场景用Relaxed版本；
+	// 发布/获取数据（一个线程写完数据后置标志，另一个线程看到标志后读数据）用Release/Acquire版本。
 	template <typename T>
-	class AtomicInteger {
+	class AtomicInteger : boost::noncopyable {
 		public:
 			AtomicInteger()
 				: value_(0) {
 			}
 
+			T get() const {
+				return value_.load(std::memory_order_seq_cst);
+			}
+
+			T getRelaxed() const {
+				return value_.load(std::memory_order_relaxed);
+			}
+
+			T getAcquire() const {
+				return value_.load(std::memory_order_acquire);
+			}
+
+			void set(T x) {
+				value_.store(x, std::memory_order_seq_cst);
+			}
+
+			void setRelaxed(T x) {
+				value_.store(x, std::memory_order_relaxed);
+			}
 
-			T get() {
-				return __sync_val_compare_and_swap(&value_, 0, 0);
+			void setRelease(T x) {
+				value_.store(x, std::memory_order_release);
 			}
 
 			T getAndAdd(T x) {
-				return __sync_fetch_and_add(&value_, x);
+				return value_.fetch_add(x, std::memory_order_seq_cst); //返回增加之前的数
+			}
+
+			T getAndAddRelaxed(T x) {
+				return value_.fetch_add(x, std::memory_order_relaxed);
 			}
 
 			T addAndGet(T x) {
-				return getAndAdd(x) + x; //getAndAdd(x)返回增加之前的数
+				return getAndAdd(x) + x;
 			}
 
 			T incrementAndGet() {
@@ -39,21 +68,33 @@ namespace atomics {
 				getAndAdd(x);
 			}
 
+			void addRelaxed(T x) {
+				getAndAddRelaxed(x);
+			}
+
 			void increment() {
 				incrementAndGet();
 			}
 
+			void incrementRelaxed() {
+				getAndAddRelaxed(1);
+			}
+
 			void decrement() {
 				decrementAndGet();
 			}
 
 			T getAndSet(T x) {
-				return __sync_lock_test_and_set(&value_, x); //__sync_lock_test_and_set将value_设置为x，返回之前的值
+				return value_.exchange(x, std::memory_order_seq_cst); //将value_设置为x，返回之前的值
+			}
+
+			// value_等于expected时设置为desired并返回true
+			bool compareAndSet(T expected, T desired) {
+				return value_.compare_exchange_strong(expected, desired, std::memory_order_seq_cst);
 			}
 
 		private:
-			volatile T value_; //volatile 这个关键字来避免编译时内存乱序访问 如：
-							   // x = y; y = 1;编译器优化的结果可能导致 y = 1 在 x = r 之前执行完成
+			std::atomic<T> value_;
 	};
 }
 	typedef atomics::AtomicInteger<int32_t> AtomicInt32;
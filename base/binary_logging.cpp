@@ -0,0 +1,481 @@
+#include "binary_logging.h"
+
+#include "current_thread.h"
+#include "log_file.h"
+#include "tsc_clock.h"
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+
+using namespace kaycc;
+using namespace kaycc::binlog;
+
+namespace {
+
+    const size_t kRingSize = 1024 * 1024; //每个线程的环形缓冲大小
+    const int kMaxSites = 65536;
+
+    // 环形缓冲里每条记录的头部，记录按8字节对齐；length为0表示从这里绕回缓冲开头
+    struct RecordHeader {
+        uint32_t length;
+        int32_t siteId;
+        int64_t timestamp; //TscClock::nowNanoSeconds()
+    };
+
+    // 单生产者（所属线程）单消费者（BinaryLogging线程）的字节环形缓冲。
+    // tail/head是一直增长的字节数，对kRingSize取模得到位置
+    struct Ring {
+        Ring()
+            : data(new char[kRingSize]),
+              tid(currentthread::tid()),
+              producerTail(0),
+              recordStart(0),
+              aboveHalf(false),
+              head(0),
+              tail(0),
+              closed(false) {
+        }
+
+        ~Ring() {
+            delete[] data;
+        }
+
+        char* const data;
+        const int tid;
+
+        // 只有生产者访问
+        uint64_t producerTail;
+        uint64_t recordStart;
+        bool aboveHalf; //上一条记录提交后已用空间超过一半
+        char pad0[64];
+
+        std::atomic<uint64_t> head; //消费者写
+        char pad1[64];
+        std::atomic<uint64_t> tail; //生产者写
+        std::atomic<bool> closed;   //线程已退出，取空后由消费者释放
+    };
+
+    std::atomic<Site*> g_sites[kMaxSites];
+    int g_numSites = 0;
+    pthread_mutex_t g_siteMutex = PTHREAD_MUTEX_INITIALIZER;
+
+    std::vector<Ring*> g_rings;
+    pthread_mutex_t g_ringMutex = PTHREAD_MUTEX_INITIALIZER;
+
+    std::atomic<int64_t> g_dropped(0);
+    std::atomic<bool> g_started(false);
+
+    // 后台线程空闲时等在g_wakeCond上，最多等flushInterval秒；
+    // flush()、stop()和用了一半以上的环形缓冲会提前唤醒它。flush()等在g_flushedCond上
+    pthread_mutex_t g_wakeMutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t g_wakeCond = PTHREAD_COND_INITIALIZER;
+    pthread_cond_t g_flushedCond = PTHREAD_COND_INITIALIZER;
+    bool g_wakeup = false; // @GuardedBy g_wakeMutex
+
+    void wakeBackend() {
+        pthread_mutex_lock(&g_wakeMutex);
+        g_wakeup = true;
+        pthread_cond_signal(&g_wakeCond);
+        pthread_mutex_unlock(&g_wakeMutex);
+    }
+
+    __thread Ring* t_ring = NULL;
+
+    pthread_once_t g_keyOnce = PTHREAD_ONCE_INIT;
+    pthread_key_t g_key;
+
+    void onThreadExit(void* ring) {
+        static_cast<Ring*>(ring)->closed.store(true, std::memory_order_release);
+    }
+
+    void createKey() {
+        pthread_key_create(&g_key, &onThreadExit);
+    }
+
+    Ring* createRing() {
+        pthread_once(&g_keyOnce, &createKey);
+        Ring* ring = new Ring;
+        pthread_mutex_lock(&g_ringMutex);
+        g_rings.push_back(ring);
+        pthread_mutex_unlock(&g_ringMutex);
+        pthread_setspecific(g_key, ring);
+        t_ring = ring;
+        return ring;
+    }
+
+    inline uint32_t alignRecord(size_t len) {
+        return static_cast<uint32_t>((len + 7) & ~static_cast<size_t>(7));
+    }
+
+    const char* const kLevelNames[Logger::NUM_LOG_LEVELS] = {
+        "TRACE ", "DEBUG ", "INFO  ", "WARN  ", "ERROR ", "FATAL ",
+    };
+
+    const char* baseName(const char* file) {
+        const char* slash = ::strrchr(file, '/');
+        return slash != NULL ? slash + 1 : file;
+    }
+
+    // 从记录里依次读出参数
+    class Decoder {
+    public:
+        Decoder(const char* begin, const char* end)
+            : cur_(begin),
+              end_(end) {
+        }
+
+        // 没有更多参数时返回false
+        bool next(ArgType* type, int64_t* i, uint64_t* u, double* d, std::string* s) {
+            if (cur_ >= end_) {
+                return false;
+            }
+            *type = static_cast<ArgType>(*cur_++);
+            switch (*type) {
+                case kInt64:
+                    return read(i, sizeof *i);
+                case kUint64:
+                case kPointer:
+                    return read(u, sizeof *u);
+                case kDouble:
+                    return read(d, sizeof *d);
+                case kString: {
+                    uint16_t n = 0;
+                    if (!read(&n, sizeof n) || static_cast<size_t>(end_ - cur_) < n) {
+                        return false;
+                    }
+                    s->assign(cur_, n);
+                    cur_ += n;
+                    return true;
+                }
+                default:
+                    return false;
+            }
+        }
+
+    private:
+        bool read(void* p, size_t len) {
+            if (static_cast<size_t>(end_ - cur_) < len) {
+                cur_ = end_;
+                return false;
+            }
+            ::memcpy(p, cur_, len);
+            cur_ += len;
+            return true;
+        }
+
+        const char* cur_;
+        const char* end_;
+    };
+
+    // 按格式串格式化一条记录的参数。长度修饰被忽略，按保存的实际类型选择printf的转换
+    void formatMessage(const char* format, const char* args, const char* argsEnd, std::string* out) {
+        Decoder decoder(args, argsEnd);
+        char buf[kMaxStringLength + 64];
+        std::string spec;
+        std::string str;
+
+        const char* f = format;
+        while (*f != '\0') {
+            if (*f != '%') {
+                out->push_back(*f++);
+                continue;
+            }
+            if (f[1] == '%') {
+                out->push_back('%');
+                f += 2;
+                continue;
+            }
+
+            spec.assign(1, '%');
+            ++f;
+            while (*f != '\0' && ::strchr("-+ #0123456789.", *f) != NULL) {
+                spec.push_back(*f++);
+            }
+            while (*f != '\0' && ::strchr("hlLqjzt", *f) != NULL) {
+                ++f;
+            }
+            if (*f == '\0') {
+                break;
+            }
+            char conv = *f++;
+
+            ArgType type;
+            int64_t i = 0;
+            uint64_t u = 0;
+            double d = 0;
+            if (!decoder.next(&type, &i, &u, &d, &str)) {
+                out->append("<missing>");
+                continue;
+            }
+
+            bool wantFloat = ::strchr("fFeEgGaA", conv) != NULL;
+            bool wantUnsigned = ::strchr("uxXo", conv) != NULL;
+            int n = 0;
+            switch (type) {
+                case kInt64:
+                case kUint64:
+                    if (wantFloat) {
+                        n = ::snprintf(buf, sizeof buf, (spec + conv).c_str(),
+                                       type == kInt64 ? static_cast<double>(i) : static_cast<double>(u));
+                    } else if (conv == 'c') {
+                        n = ::snprintf(buf, sizeof buf, (spec + 'c').c_str(), static_cast<int>(type == kInt64 ? i : u));
+                    } else if (wantUnsigned) {
+                        n = ::snprintf(buf, sizeof buf, (spec + "ll" + conv).c_str(),
+                                       static_cast<unsigned long long>(type == kInt64 ? i : u));
+                    } else if (type == kInt64) {
+                        n = ::snprintf(buf, sizeof buf, (spec + "lld").c_str(), static_cast<long long>(i));
+                    } else {
+                        n = ::snprintf(buf, sizeof buf, (spec + "llu").c_str(), static_cast<unsigned long long>(u));
+                    }
+                    break;
+                case kDouble:
+                    n = ::snprintf(buf, sizeof buf, (spec + (wantFloat ? conv : 'g')).c_str(), d);
+                    break;
+                case kString:
+                    n = ::snprintf(buf, sizeof buf, (spec + 's').c_str(), str.c_str());
+                    break;
+                case kPointer:
+                    n = ::snprintf(buf, sizeof buf, "%p", reinterpret_cast<void*>(static_cast<uintptr_t>(u)));
+                    break;
+            }
+            if (n > 0) {
+                out->append(buf, std::min(static_cast<size_t>(n), sizeof buf - 1));
+            }
+        }
+    }
+
+    // 单调时钟换算成墙上时间的偏移
+    int64_t g_wallClockOffsetNs = 0;
+
+    void formatRecord(const RecordHeader* header, int tid, std::string* out) {
+        const Site* site = g_sites[header->siteId].load(std::memory_order_acquire);
+
+        int64_t wallNs = header->timestamp + g_wallClockOffsetNs;
+        time_t seconds = static_cast<time_t>(wallNs / 1000000000);
+        int microseconds = static_cast<int>(wallNs % 1000000000 / 1000);
+        struct tm tm;
+        ::localtime_r(&seconds, &tm);
+        char prefix[160];
+        size_t n = ::strftime(prefix, sizeof prefix, "%Y%m%d %H:%M:%S", &tm);
+        n += ::snprintf(prefix + n, sizeof prefix - n, ".%06d %5d %s%s:%d ",
+                        microseconds, tid, kLevelNames[site->level], baseName(site->file), site->line);
+        out->append(prefix, std::min(n, sizeof prefix - 1));
+
+        const char* args = reinterpret_cast<const char*>(header + 1);
+        formatMessage(site->format, args, reinterpret_cast<const char*>(header) + header->length, out);
+        out->push_back('\n');
+    }
+
+    // 取出一个环形缓冲里所有已提交的记录，返回条数
+    int drainRing(Ring* ring, std::string* out) {
+        uint64_t head = ring->head.load(std::memory_order_relaxed);
+        uint64_t tail = ring->tail.load(std::memory_order_acquire);
+        int count = 0;
+        while (head < tail) {
+            size_t offset = head % kRingSize;
+            const RecordHeader* header = reinterpret_cast<const RecordHeader*>(ring->data + offset);
+            if (header->length == 0) {
+                head += kRingSize - offset; //绕回开头
+                continue;
+            }
+            formatRecord(header, ring->tid, out);
+            head += header->length;
+            ++count;
+        }
+        ring->head.store(head, std::memory_order_release);
+        return count;
+    }
+
+    // 取出所有线程的记录，释放已经退出并且取空了的线程的缓冲。
+    // 只在锁里拷贝缓冲列表，格式化时不持锁，新线程注册缓冲不用等；缓冲只在这里释放，拷贝出来的指针一直有效
+    int drainAll(std::vector<Ring*>* rings, std::string* out) {
+        pthread_mutex_lock(&g_ringMutex);
+        *rings = g_rings;
+        pthread_mutex_unlock(&g_ringMutex);
+
+        int count = 0;
+        size_t numClosed = 0;
+        for (size_t i = 0; i < rings->size(); ++i) {
+            Ring* ring = (*rings)[i];
+            bool closed = ring->closed.load(std::memory_order_acquire);
+            count += drainRing(ring, out);
+            if (closed) {
+                (*rings)[numClosed++] = ring;
+            }
+        }
+
+        if (numClosed > 0) {
+            rings->resize(numClosed);
+            pthread_mutex_lock(&g_ringMutex);
+            for (size_t i = 0; i < numClosed; ++i) {
+                g_rings.erase(std::find(g_rings.begin(), g_rings.end(), (*rings)[i]));
+            }
+            pthread_mutex_unlock(&g_ringMutex);
+            for (size_t i = 0; i < numClosed; ++i) {
+                delete (*rings)[i];
+            }
+        }
+        return count;
+    }
+}
+
+int binlog::registerSite(Site* site) {
+    pthread_mutex_lock(&g_siteMutex);
+    int id = site->id.load(std::memory_order_relaxed);
+    if (id < 0) {
+        if (g_numSites >= kMaxSites) {
+            pthread_mutex_unlock(&g_siteMutex);
+            ::fprintf(stderr, "binlog: too many log sites\n");
+            ::abort();
+        }
+        id = g_numSites++;
+        g_sites[id].store(site, std::memory_order_release);
+        site->id.store(id, std::memory_order_release);
+    }
+    pthread_mutex_unlock(&g_siteMutex);
+    return id;
+}
+
+char* binlog::beginRecord(int siteId, char** payloadEnd) {
+    Ring* ring = t_ring;
+    if (__builtin_expect(ring == NULL, 0)) {
+        ring = createRing();
+    }
+
+    // 每条记录预留kMaxRecordSize的连续空间，到缓冲末尾放不下就绕回开头
+    uint64_t tail = ring->producerTail;
+    size_t offset = tail % kRingSize;
+    size_t pad = kRingSize - offset < kMaxRecordSize ? kRingSize - offset : 0;
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+    if (kRingSize - (tail - head) < pad + kMaxRecordSize) {
+        g_dropped.fetch_add(1, std::memory_order_relaxed);
+        return NULL;
+    }
+
+    if (pad != 0) {
+        reinterpret_cast<RecordHeader*>(ring->data + offset)->length = 0;
+        tail += pad;
+        offset = 0;
+    }
+
+    RecordHeader* header = reinterpret_cast<RecordHeader*>(ring->data + offset);
+    header->siteId = siteId;
+    header->timestamp = TscClock::nowNanoSeconds();
+    ring->recordStart = tail;
+    *payloadEnd = ring->data + offset + kMaxRecordSize;
+    return reinterpret_cast<char*>(header + 1);
+}
+
+void binlog::commitRecord(char* recordEnd) {
+    Ring* ring = t_ring;
+    char* start = ring->data + ring->recordStart % kRingSize;
+    uint32_t length = alignRecord(static_cast<size_t>(recordEnd - start));
+    reinterpret_cast<RecordHeader*>(start)->length = length;
+    ring->producerTail = ring->recordStart + length;
+    ring->tail.store(ring->producerTail, std::memory_order_release);
+
+    // 后台线程平时最多休眠flushInterval秒，缓冲用过一半时叫醒它，每次越过一半只叫一次
+    bool aboveHalf = ring->producerTail - ring->head.load(std::memory_order_relaxed) > kRingSize / 2;
+    if (aboveHalf && !ring->aboveHalf) {
+        wakeBackend();
+    }
+    ring->aboveHalf = aboveHalf;
+}
+
+BinaryLogging::BinaryLogging(const std::string& basename, off_t rollSize, int flushInterval)
+    : basename_(basename),
+      rollSize_(rollSize),
+      flushInterval_(flushInterval),
+      running_(false),
+      flushRequested_(0),
+      flushedUpTo_(0),
+      thread_(boost::bind(&BinaryLogging::threadFunc, this), "BinaryLogging") {
+}
+
+BinaryLogging::~BinaryLogging() {
+    if (running_) {
+        stop();
+    }
+}
+
+void BinaryLogging::start() {
+    bool expected = false;
+    if (!g_started.compare_exchange_strong(expected, true)) {
+        ::fprintf(stderr, "BinaryLogging: another instance is running\n");
+        ::abort();
+    }
+
+    struct timespec ts;
+    ::clock_gettime(CLOCK_REALTIME, &ts);
+    g_wallClockOffsetNs = static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec - TscClock::nowNanoSeconds();
+
+    running_ = true;
+    thread_.start();
+}
+
+void BinaryLogging::stop() {
+    pthread_mutex_lock(&g_wakeMutex);
+    running_ = false;
+    pthread_cond_signal(&g_wakeCond);
+    pthread_cond_broadcast(&g_flushedCond);
+    pthread_mutex_unlock(&g_wakeMutex);
+    thread_.join();
+    g_started = false;
+}
+
+void BinaryLogging::flush() {
+    int64_t ticket = flushRequested_.fetch_add(1) + 1;
+    pthread_mutex_lock(&g_wakeMutex);
+    g_wakeup = true;
+    pthread_cond_signal(&g_wakeCond);
+    while (running_ && flushedUpTo_.load() < ticket) {
+        pthread_cond_wait(&g_flushedCond, &g_wakeMutex);
+    }
+    pthread_mutex_unlock(&g_wakeMutex);
+}
+
+int64_t BinaryLogging::droppedCount() {
+    return g_dropped.load(std::memory_order_relaxed);
+}
+
+void BinaryLogging::threadFunc() {
+    LogFile output(basename_, rollSize_, flushInterval_);
+    std::vector<Ring*> rings;
+    std::string batch;
+
+    while (running_) {
+        // 先取flush序号再取记录，flush()之前提交的记录一定会在这一轮取到
+        int64_t ticket = flushRequested_.load();
+        batch.clear();
+        if (drainAll(&rings, &batch) > 0) {
+            output.append(batch.data(), batch.size());
+            output.flush(); //每次唤醒最多一次，不用再等到空闲
+        }
+
+        pthread_mutex_lock(&g_wakeMutex);
+        if (ticket != flushedUpTo_.load(std::memory_order_relaxed)) {
+            flushedUpTo_.store(ticket);
+            pthread_cond_broadcast(&g_flushedCond);
+        }
+        if (!g_wakeup && running_) {
+            struct timespec abstime;
+            ::clock_gettime(CLOCK_REALTIME, &abstime);
+            abstime.tv_sec += flushInterval_;
+            pthread_cond_timedwait(&g_wakeCond, &g_wakeMutex, &abstime);
+        }
+        g_wakeup = false;
+        pthread_mutex_unlock(&g_wakeMutex);
+    }
+
+    batch.clear();
+    drainAll(&rings, &batch);
+    output.append(batch.data(), batch.size());
+    output.flush();
+}
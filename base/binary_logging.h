@@ -0,0 +1,229 @@
+#ifndef KAYCC_BASE_BINARYLOGGING_H
+#define KAYCC_BASE_BINARYLOGGING_H
+
+#include "log.h"
+#include "thread.h"
+
+#include <boost/noncopyable.hpp>
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <type_traits>
+
+/*
+二进制延迟格式化日志：热路径上不做任何格式化。
+    BLOG_INFO("conn %s recv %d bytes in %.3f ms", name, n, ms);
+每个调用点有一个静态的Site（格式串、文件、行号、级别），第一次执行时分配一个编号；
+之后每次调用只把 编号 + 单调时钟 + 参数的原始字节 拷进当前线程自己的环形缓冲（单生产者单消费者，无锁），
+由BinaryLogging的后台线程取出，按格式串格式化成文本写入LogFile。
+    整数、浮点数、指针按值保存；const char*和std::string会拷贝内容（最长kMaxStringLength字节），
+    所以参数的生命周期不需要延长到格式化的时候。
+    格式串里的长度修饰（l、ll、h、z等）会被忽略，按实际保存的参数类型格式化，类型写错也不会读错内存。
+环形缓冲满了（后台跟不上）时丢弃这条日志并计数，不会阻塞。
+级别过滤和LOG_*一样：编译期KAYCC_LOG_COMPILE_LEVEL，运行时Logger::logLevel()。
+没有启动BinaryLogging时，日志留在环形缓冲里，满了之后丢弃。
+*/
+
+namespace kaycc {
+namespace binlog {
+
+    struct Site {
+        const char* format;
+        const char* file;
+        int line;
+        int level;
+        std::atomic<int> id; //-1表示还没注册
+    };
+
+    // 参数的类型标记，和参数的原始字节一起存进环形缓冲
+    enum ArgType {
+        kInt64 = 1,
+        kUint64,
+        kDouble,
+        kString,  //uint16长度 + 内容
+        kPointer,
+    };
+
+    const size_t kMaxStringLength = 256;
+    const size_t kMaxRecordSize = 2048; //单条日志编码后的最大长度，超出的参数丢弃
+
+    // 编码参数，写不下时置overflow，不会越界
+    class Encoder {
+    public:
+        Encoder(char* buf, size_t size)
+            : cur_(buf),
+              end_(buf + size),
+              overflow_(false) {
+        }
+
+        char* current() const { return cur_; }
+        bool overflow() const { return overflow_; }
+
+        void putRaw(const void* p, size_t len) {
+            if (static_cast<size_t>(end_ - cur_) < len) {
+                overflow_ = true;
+                return;
+            }
+            ::memcpy(cur_, p, len);
+            cur_ += len;
+        }
+
+        void putTag(ArgType t) {
+            char c = static_cast<char>(t);
+            putRaw(&c, 1);
+        }
+
+        void putString(const char* s, size_t len) {
+            if (len > kMaxStringLength) {
+                len = kMaxStringLength;
+            }
+            uint16_t n = static_cast<uint16_t>(len);
+            putTag(kString);
+            putRaw(&n, sizeof n);
+            putRaw(s, len);
+        }
+
+    private:
+        char* cur_;
+        char* end_;
+        bool overflow_;
+    };
+
+    template <typename T>
+    inline typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+    encodeArg(Encoder& enc, T v) {
+        int64_t x = v;
+        enc.putTag(kInt64);
+        enc.putRaw(&x, sizeof x);
+    }
+
+    template <typename T>
+    inline typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+    encodeArg(Encoder& enc, T v) {
+        uint64_t x = v;
+        enc.putTag(kUint64);
+        enc.putRaw(&x, sizeof x);
+    }
+
+    template <typename T>
+    inline typename std::enable_if<std::is_enum<T>::value>::type
+    encodeArg(Encoder& enc, T v) {
+        encodeArg(enc, static_cast<int64_t>(v));
+    }
+
+    template <typename T>
+    inline typename std::enable_if<std::is_floating_point<T>::value>::type
+    encodeArg(Encoder& enc, T v) {
+        double x = v;
+        enc.putTag(kDouble);
+        enc.putRaw(&x, sizeof x);
+    }
+
+    inline void encodeArg(Encoder& enc, const char* s) {
+        if (s == NULL) {
+            s = "(null)";
+        }
+        enc.putString(s, ::strlen(s));
+    }
+
+    inline void encodeArg(Encoder& enc, char* s) {
+        encodeArg(enc, static_cast<const char*>(s));
+    }
+
+    inline void encodeArg(Encoder& enc, const std::string& s) {
+        enc.putString(s.data(), s.size());
+    }
+
+    template <typename T>
+    inline void encodeArg(Encoder& enc, const T* p) {
+        uint64_t x = reinterpret_cast<uintptr_t>(p);
+        enc.putTag(kPointer);
+        enc.putRaw(&x, sizeof x);
+    }
+
+    inline void encodeArgs(Encoder&) {
+    }
+
+    template <typename T, typename... Args>
+    inline void encodeArgs(Encoder& enc, const T& first, const Args&... rest) {
+        encodeArg(enc, first);
+        encodeArgs(enc, rest...);
+    }
+
+    // 第一次执行某个调用点时注册，返回编号
+    int registerSite(Site* site);
+
+    // 当前线程的环形缓冲里预留一条记录的空间，写完后commit；返回NULL表示缓冲已满（已计数）
+    char* beginRecord(int siteId, char** payloadEnd);
+    void commitRecord(char* recordEnd);
+
+    template <typename... Args>
+    void log(Site* site, const Args&... args) {
+        int id = site->id.load(std::memory_order_acquire);
+        if (__builtin_expect(id < 0, 0)) {
+            id = registerSite(site);
+        }
+
+        char* end = NULL;
+        char* payload = beginRecord(id, &end);
+        if (payload == NULL) {
+            return;
+        }
+        Encoder enc(payload, static_cast<size_t>(end - payload));
+        encodeArgs(enc, args...);
+        commitRecord(enc.current());
+    }
+
+} //end binlog
+
+    /*
+    后台格式化线程：取出所有线程的环形缓冲里的记录，格式化后写入LogFile（按大小和时间滚动）。
+    每flushInterval秒醒来一次，某个线程的环形缓冲用过一半或者调用flush()时提前醒来。
+    同一时间只能有一个实例在运行。
+    */
+    class BinaryLogging : boost::noncopyable {
+    public:
+        BinaryLogging(const std::string& basename, off_t rollSize, int flushInterval = 3);
+        ~BinaryLogging();
+
+        void start();
+        void stop();
+
+        // 等待到目前为止记录的日志都格式化并写入文件
+        void flush();
+
+        // 因为环形缓冲满了而丢弃的日志条数（所有线程合计）
+        static int64_t droppedCount();
+
+    private:
+        void threadFunc();
+
+        const std::string basename_;
+        const off_t rollSize_;
+        const int flushInterval_;
+        std::atomic<bool> running_;
+        std::atomic<int64_t> flushRequested_;
+        std::atomic<int64_t> flushedUpTo_;
+        Thread thread_;
+    };
+
+}
+
+#define KAYCC_BLOG_IF(level, fmt, ...) \
+    do { \
+        if (KAYCC_LOG_LEVEL_##level >= KAYCC_LOG_COMPILE_LEVEL \
+            && kaycc::Logger::logLevel() <= KAYCC_LOG_LEVEL_##level) { \
+            static kaycc::binlog::Site kaycc_blog_site = {fmt, __FILE__, __LINE__, KAYCC_LOG_LEVEL_##level, {-1}}; \
+            kaycc::binlog::log(&kaycc_blog_site, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+#define BLOG_TRACE(fmt, ...) KAYCC_BLOG_IF(TRACE, fmt, ##__VA_ARGS__)
+#define BLOG_DEBUG(fmt, ...) KAYCC_BLOG_IF(DEBUG, fmt, ##__VA_ARGS__)
+#define BLOG_INFO(fmt, ...)  KAYCC_BLOG_IF(INFO, fmt, ##__VA_ARGS__)
+#define BLOG_WARN(fmt, ...)  KAYCC_BLOG_IF(WARN, fmt, ##__VA_ARGS__)
+#define BLOG_ERROR(fmt, ...) KAYCC_BLOG_IF(ERROR, fmt, ##__VA_ARGS__)
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef KAYCC_BASE_BOUNDEDMPMCQUEUE_H
+#define KAYCC_BASE_BOUNDEDMPMCQUEUE_H
+
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_array.hpp>
+
+#include <algorithm>
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+有界的多生产者多消费者无锁队列（Dmitry Vyukov的基于序号的环形数组）。
+每个槽位有一个序号sequence：
+    sequence == pos      槽位空闲，位置pos的生产者可以写入
+    sequence == pos + 1  槽位已写入，位置pos的消费者可以读取
+消费者读完后把sequence设为pos + capacity，留给下一轮的生产者。
+生产者/消费者各自只需要对enqueuePos_/dequeuePos_做一次CAS，不用加锁。
+容量不要求是2的幂，setMaxQueueSize给多少就是多少。
+*/
+
+namespace kaycc {
+
+    template <typename T>
+    class BoundedMpmcQueue : boost::noncopyable {
+    public:
+        explicit BoundedMpmcQueue(size_t capacity)
+            : capacity_(capacity),
+              buffer_(new Cell[capacity]),
+              enqueuePos_(0),
+              dequeuePos_(0) {
+            assert(capacity > 0);
+            for (size_t i = 0; i < capacity; ++i) {
+                buffer_[i].sequence = i;
+            }
+        }
+
+        // 队列满时返回false，不会阻塞
+        bool push(const T& value) {
+            Cell* cell = NULL;
+            size_t pos = __atomic_load_n(&enqueuePos_, __ATOMIC_RELAXED);
+            for (;;) {
+                cell = &buffer_[pos % capacity_];
+                size_t seq = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+                intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+                if (diff == 0) { //槽位空闲，尝试占用
+                    if (__sync_bool_compare_and_swap(&enqueuePos_, pos, pos + 1)) {
+                        break;
+                    }
+                    pos = __atomic_load_n(&enqueuePos_, __ATOMIC_RELAXED);
+                } else if (diff < 0) { //上一轮的数据还没有被取走，队列已满
+                    return false;
+                } else { //被其他生产者抢先了
+                    pos = __atomic_load_n(&enqueuePos_, __ATOMIC_RELAXED);
+                }
+            }
+
+            cell->data = value;
+            __atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
+            return true;
+        }
+
+        // 队列空时返回false。取出的数据与*value交换，槽位里留下*value原来的值（一般为空）
+        bool pop(T* value) {
+            Cell* cell = NULL;
+            size_t pos = __atomic_load_n(&dequeuePos_, __ATOMIC_RELAXED);
+            for (;;) {
+                cell = &buffer_[pos % capacity_];
+                size_t seq = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+                intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+                if (diff == 0) {
+                    if (__sync_bool_compare_and_swap(&dequeuePos_, pos, pos + 1)) {
+                        break;
+                    }
+                    pos = __atomic_load_n(&dequeuePos_, __ATOMIC_RELAXED);
+                } else if (diff < 0) { //还没有生产者写入，队列为空
+                    return false;
+                } else {
+                    pos = __atomic_load_n(&dequeuePos_, __ATOMIC_RELAXED);
+                }
+            }
+
+            using std::swap;
+            swap(*value, cell->data);
+            __atomic_store_n(&cell->sequence, pos + capacity_, __ATOMIC_RELEASE);
+            return true;
+        }
+
+        // 近似值，并发修改时只用于统计
+        size_t size() const {
+            size_t enq = __atomic_load_n(&enqueuePos_, __ATOMIC_RELAXED);
+            size_t deq = __atomic_load_n(&dequeuePos_, __ATOMIC_RELAXED);
+            return enq > deq ? enq - deq : 0;
+        }
+
+        bool empty() const {
+            return size() == 0;
+        }
+
+        size_t capacity() const {
+            return capacity_;
+        }
+
+    private:
+        static const size_t kCacheLineSize = 64;
+
+        struct Cell {
+            size_t sequence;
+            T data;
+        };
+
+        typedef char CacheLinePad[kCacheLineSize];
+
+        // 生产者和消费者的位置放在不同的cache line上，避免互相干扰（false sharing）
+        CacheLinePad pad0_;
+        const size_t capacity_;
+        boost::scoped_array<Cell> buffer_;
+        CacheLinePad pad1_;
+        size_t enqueuePos_;
+        CacheLinePad pad2_;
+        size_t dequeuePos_;
+        CacheLinePad pad3_;
+    };
+
+}
+
+#endif
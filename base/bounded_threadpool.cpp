@@ -0,0 +1,137 @@
+#include "bounded_threadpool.h"
+
+#include <boost/bind.hpp>
+#include <assert.h>
+#include <stdio.h>
+#include "log.h"
+
+using namespace kaycc;
+
+BoundedThreadPool::BoundedThreadPool(const std::string& name)
+    : name_(name),
+      maxQueueSize_(kDefaultQueueSize),
+      running_(false) {
+
+}
+
+BoundedThreadPool::~BoundedThreadPool() {
+    if (running_) {
+        stop();
+    }
+}
+
+void BoundedThreadPool::setMaxQueueSize(int maxSize) {
+    assert(maxSize > 0);
+    assert(!queue_); //start()之后队列已经创建，容量不能再改
+    maxQueueSize_ = maxSize;
+}
+
+void BoundedThreadPool::start(int numThreads) {
+    assert(threads_.empty());
+    assert(maxQueueSize_ > 0);
+    queue_.reset(new BoundedMpmcQueue<TaskFunc>(maxQueueSize_));
+    running_ = true;
+    threads_.reserve(numThreads);
+
+    for (int i = 0; i < numThreads; ++i) {
+        char id[32];
+        snprintf(id, sizeof(id), "%d", i+1);
+
+        threads_.push_back(new kaycc::Thread(
+            boost::bind(&BoundedThreadPool::runInThread, this), name_ + id));
+        threads_[i].start();
+    }
+
+    if (numThreads == 0 && threadInitCallback_) {
+        threadInitCallback_();
+    }
+}
+
+void BoundedThreadPool::stop() {
+    running_ = false;
+    notEmpty_.notifyAll();
+    notFull_.notifyAll();
+
+    for_each(threads_.begin(), threads_.end(),
+        boost::bind(&kaycc::Thread::join, _1));
+}
+
+size_t BoundedThreadPool::queueSize() const {
+    return queue_ ? queue_->size() : 0;
+}
+
+void BoundedThreadPool::run(const TaskFunc& task) {
+    if (threads_.empty()) {
+        task();
+        return;
+    }
+
+    if (!running_) {
+        LOG_ERROR << "BoundedThreadPool " << name_ << " run() after stop(), task dropped" << std::endl;
+        return;
+    }
+
+    while (!queue_->push(task)) { //队列已满，在notFull_上休眠
+        int32_t key = notFull_.prepareWait();
+        if (queue_->push(task)) { //prepareWait之后再试一次，避免错过取任务线程的通知
+            notFull_.cancelWait();
+            break;
+        }
+
+        if (!running_) {
+            notFull_.cancelWait();
+            LOG_ERROR << "BoundedThreadPool " << name_ << " stopped while run() was waiting, task dropped" << std::endl;
+            return;
+        }
+
+        notFull_.wait(key);
+    }
+
+    notEmpty_.notify();
+}
+
+bool BoundedThreadPool::tryRun(const TaskFunc& task) {
+    if (threads_.empty()) {
+        task();
+        return true;
+    }
+
+    if (!running_ || !queue_->push(task)) {
+        return false;
+    }
+
+    notEmpty_.notify();
+    return true;
+}
+
+void BoundedThreadPool::runInThread() {
+    try {
+        if (threadInitCallback_) {
+            threadInitCallback_();
+        }
+
+        TaskFunc task;
+        while (running_) {
+            if (queue_->pop(&task)) {
+                notFull_.notify();
+                task();
+                task = NULL; //尽早释放任务绑定的资源
+                continue;
+            }
+
+            // 队列为空，在notEmpty_上休眠
+            int32_t key = notEmpty_.prepareWait();
+            if (!queue_->empty() || !running_) {
+                notEmpty_.cancelWait();
+                continue;
+            }
+            notEmpty_.wait(key);
+        }
+    } catch (std::exception& ex) {
+        LOG_ERROR << "exception caught in BoundedThreadPool " << name_ << " ,reason: " << ex.what() << std::endl;
+        abort();
+    } catch (...) {
+        LOG_ERROR << "unknown exception caught in BoundedThreadPool " << name_ << std::endl;
+        throw;
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef KAYCC_BASE_BOUNDEDTHREADPOOL_H
+#define KAYCC_BASE_BOUNDEDTHREADPOOL_H
+
+#include "bounded_mpmc_queue.h"
+#include "futex.h"
+#include "thread.h"
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <atomic>
+
+/*
+有界线程池，接口与ThreadPool一致。
+任务队列是固定容量的无锁MPMC环形队列，提交和取任务的快速路径都不加锁；
+队列为空时工作线程、队列满时提交线程在futex上休眠（EventCount），
+只有确实有线程在休眠时才会进入内核唤醒。
+队列容量在start()时确定，之后不能再调用setMaxQueueSize。
+*/
+
+namespace kaycc {
+    class BoundedThreadPool : boost::noncopyable {
+    public:
+        typedef boost::function<void ()> TaskFunc;
+
+        static const int kDefaultQueueSize = 4096;
+
+        explicit BoundedThreadPool(const std::string& name = "BoundedThreadPool");
+        ~BoundedThreadPool();
+
+        // 队列容量，必须大于0，并且在start()之前设置；不设置时使用kDefaultQueueSize
+        void setMaxQueueSize(int maxSize);
+        void setThreadInitCallback(const TaskFunc& cb) {
+            threadInitCallback_ = cb;
+        }
+
+        void start(int numThreads);
+        void stop();
+
+        const std::string& name() const {
+            return name_;
+        }
+
+        size_t queueSize() const;
+
+        // 队列满时阻塞等待；线程池已经stop时任务被丢弃，并记录一条错误日志
+        void run(const TaskFunc& f);
+
+        // 队列满或者线程池已经stop时不等待，直接返回false
+        bool tryRun(const TaskFunc& f);
+
+    private:
+        void runInThread();
+
+    private:
+        std::string name_;
+
+        TaskFunc threadInitCallback_;
+        boost::ptr_vector<kaycc::Thread> threads_;
+        boost::scoped_ptr<BoundedMpmcQueue<TaskFunc> > queue_;
+
+        EventCount notEmpty_; //工作线程等待队列非空
+        EventCount notFull_;  //提交线程等待队列不满
+
+        int maxQueueSize_;
+        // 工作线程和run/tryRun不加锁读。用默认的seq_cst：stop()先写running_再notifyAll，
+        // 等待者先prepareWait再读running_，两边都是全序的原子操作，不会错过通知
+        std::atomic<bool> running_;
+    };
+}
+
+#endif
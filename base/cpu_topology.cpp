@@ -0,0 +1,287 @@
+#include "cpu_topology.h"
+
+#include "log.h"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace kaycc;
+
+namespace {
+    const int kMpolPreferred = 1; //<numaif.h>里的MPOL_PREFERRED，不依赖libnuma
+    const int kMaxNodes = 1024;
+
+    // 读取文件的第一行，去掉结尾的换行
+    bool readLine(const std::string& path, std::string* line) {
+        FILE* fp = ::fopen(path.c_str(), "r");
+        if (fp == NULL) {
+            return false;
+        }
+
+        char buf[4096];
+        bool ok = ::fgets(buf, sizeof buf, fp) != NULL;
+        ::fclose(fp);
+        if (!ok) {
+            return false;
+        }
+
+        line->assign(buf);
+        while (!line->empty() && ((*line)[line->size() - 1] == '\n' || (*line)[line->size() - 1] == ' ')) {
+            line->resize(line->size() - 1);
+        }
+        return true;
+    }
+
+    int readInt(const std::string& path, int defaultValue) {
+        std::string line;
+        if (!readLine(path, &line) || line.empty()) {
+            return defaultValue;
+        }
+        return atoi(line.c_str());
+    }
+
+    std::string cpuDir(const std::string& root, int cpu) {
+        char buf[32];
+        snprintf(buf, sizeof buf, "/cpu/cpu%d", cpu);
+        return root + buf;
+    }
+
+    // node/下所有nodeN的编号
+    std::vector<int> listNodes(const std::string& root) {
+        std::vector<int> nodes;
+        DIR* dir = ::opendir((root + "/node").c_str());
+        if (dir == NULL) {
+            return nodes;
+        }
+
+        struct dirent* entry;
+        while ((entry = ::readdir(dir)) != NULL) {
+            int node = 0;
+            char tail = 0;
+            if (sscanf(entry->d_name, "node%d%c", &node, &tail) == 1) {
+                nodes.push_back(node);
+            }
+        }
+        ::closedir(dir);
+        std::sort(nodes.begin(), nodes.end());
+        return nodes;
+    }
+
+    const CpuTopology* g_instance = NULL;
+    pthread_once_t g_once = PTHREAD_ONCE_INIT;
+
+    void initInstance() {
+        g_instance = new CpuTopology();
+    }
+}
+
+CpuTopology::CpuTopology(const std::string& root, bool onlyAllowed)
+    : numCores_(0),
+      numNodes_(0) {
+    std::string online;
+    std::vector<int> ids;
+    if (readLine(root + "/cpu/online", &online)) {
+        ids = parseCpuList(online);
+    }
+    if (ids.empty()) { //没有sysfs，只知道CPU的个数
+        long n = ::sysconf(_SC_NPROCESSORS_ONLN);
+        for (long i = 0; i < n; ++i) {
+            ids.push_back(static_cast<int>(i));
+        }
+    }
+
+    std::map<int, int> nodeOfCpu;
+    std::vector<int> nodes = listNodes(root);
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        char buf[32];
+        snprintf(buf, sizeof buf, "/node/node%d/cpulist", nodes[i]);
+        std::string list;
+        if (readLine(root + buf, &list)) {
+            std::vector<int> cpus = parseCpuList(list);
+            for (size_t j = 0; j < cpus.size(); ++j) {
+                nodeOfCpu[cpus[j]] = nodes[i];
+            }
+        }
+    }
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (onlyAllowed && ::sched_getaffinity(0, sizeof allowed, &allowed) != 0) {
+        onlyAllowed = false;
+    }
+
+    std::map<std::pair<int, int>, int> cores; //(package, core_id) -> core
+    std::vector<int> usedNodes;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        int id = ids[i];
+        if (onlyAllowed && (id >= CPU_SETSIZE || !CPU_ISSET(id, &allowed))) {
+            continue;
+        }
+
+        std::string dir = cpuDir(root, id);
+        Cpu cpu;
+        cpu.id = id;
+        cpu.package = readInt(dir + "/topology/physical_package_id", 0);
+        int coreId = readInt(dir + "/topology/core_id", id); //没有拓扑信息时每个CPU算一个核
+        std::pair<int, int> key(cpu.package, coreId);
+        std::map<std::pair<int, int>, int>::iterator it = cores.find(key);
+        if (it == cores.end()) {
+            it = cores.insert(std::make_pair(key, static_cast<int>(cores.size()))).first;
+        }
+        cpu.core = it->second;
+        std::map<int, int>::iterator node = nodeOfCpu.find(id);
+        cpu.node = node == nodeOfCpu.end() ? 0 : node->second;
+        if (std::find(usedNodes.begin(), usedNodes.end(), cpu.node) == usedNodes.end()) {
+            usedNodes.push_back(cpu.node);
+        }
+        cpus_.push_back(cpu);
+    }
+
+    numCores_ = static_cast<int>(cores.size());
+    numNodes_ = static_cast<int>(usedNodes.size());
+}
+
+const CpuTopology& CpuTopology::instance() {
+    pthread_once(&g_once, &initInstance);
+    return *g_instance;
+}
+
+int CpuTopology::nodeOf(int cpu) const {
+    for (size_t i = 0; i < cpus_.size(); ++i) {
+        if (cpus_[i].id == cpu) {
+            return cpus_[i].node;
+        }
+    }
+    return -1;
+}
+
+std::vector<int> CpuTopology::spread(int n) const {
+    std::vector<int> result;
+    if (cpus_.empty() || n <= 0) {
+        return result;
+    }
+
+    // 每个核上的逻辑CPU（按编号），以及每个节点上的核（按核里最小的CPU编号）
+    std::vector<std::vector<int> > siblings(numCores_);
+    std::map<int, std::vector<int> > coresOfNode;
+    for (size_t i = 0; i < cpus_.size(); ++i) {
+        const Cpu& cpu = cpus_[i];
+        if (siblings[cpu.core].empty()) {
+            coresOfNode[cpu.node].push_back(cpu.core);
+        }
+        siblings[cpu.core].push_back(cpu.id);
+    }
+
+    // 核的顺序：各节点轮流取一个
+    std::vector<int> coreOrder;
+    for (size_t round = 0; coreOrder.size() < siblings.size(); ++round) {
+        for (std::map<int, std::vector<int> >::iterator it = coresOfNode.begin(); it != coresOfNode.end(); ++it) {
+            if (round < it->second.size()) {
+                coreOrder.push_back(it->second[round]);
+            }
+        }
+    }
+
+    // 先用每个核的第一个超线程，再用第二个……
+    std::vector<int> order;
+    for (size_t thread = 0; order.size() < cpus_.size(); ++thread) {
+        for (size_t i = 0; i < coreOrder.size(); ++i) {
+            const std::vector<int>& s = siblings[coreOrder[i]];
+            if (thread < s.size()) {
+                order.push_back(s[thread]);
+            }
+        }
+    }
+
+    for (int i = 0; i < n; ++i) {
+        result.push_back(order[i % order.size()]);
+    }
+    return result;
+}
+
+std::vector<int> CpuTopology::parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    const char* p = list.c_str();
+    while (*p != '\0') {
+        char* end = NULL;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0) {
+            return std::vector<int>();
+        }
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            ++p;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first) {
+                return std::vector<int>();
+            }
+            p = end;
+        }
+        for (long cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+
+        if (*p == ',') {
+            ++p;
+        } else if (*p != '\0' && *p != '\n') {
+            return std::vector<int>();
+        } else {
+            break;
+        }
+    }
+    return cpus;
+}
+
+bool CpuTopology::bindCurrentThread(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return false;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int ret = ::pthread_setaffinity_np(::pthread_self(), sizeof set, &set);
+    if (ret != 0) {
+        LOG_ERROR << "CpuTopology::bindCurrentThread cpu " << cpu << " failed: " << strerror(ret) << std::endl;
+        return false;
+    }
+
+    const CpuTopology& topology = instance();
+    if (topology.numNodes() > 1) { //只有一个节点时内存总是本地的
+        int node = topology.nodeOf(cpu);
+        if (node >= 0) {
+            preferMemoryNode(node);
+        }
+    }
+    return true;
+}
+
+bool CpuTopology::preferMemoryNode(int node) {
+    if (node < 0 || node >= kMaxNodes) {
+        return false;
+    }
+
+    const int kBitsPerLong = static_cast<int>(sizeof(unsigned long) * 8);
+    unsigned long mask[kMaxNodes / kBitsPerLong];
+    memset(mask, 0, sizeof mask);
+    mask[node / kBitsPerLong] = 1UL << (node % kBitsPerLong);
+
+    // 内核会少读一位，所以maxnode是位数加1
+    if (::syscall(SYS_set_mempolicy, kMpolPreferred, mask, static_cast<unsigned long>(kMaxNodes + 1)) != 0) {
+        LOG_WARN << "CpuTopology::preferMemoryNode node " << node << " failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,70 @@
+#ifndef KAYCC_BASE_CPUTOPOLOGY_H
+#define KAYCC_BASE_CPUTOPOLOGY_H
+
+#include <string>
+#include <vector>
+
+/*
+CPU拓扑（逻辑CPU、物理核、NUMA节点），从/sys/devices/system读取，不依赖libnuma。
+用来给线程池的线程选择CPU：把线程绑定在固定的CPU上，调度器不会把它挪来挪去，
+线程访问的数据（连接、Buffer、任务队列）一直留在同一个核的缓存里；
+绑定的同时让线程的内存优先从这个CPU所在的NUMA节点分配。
+*/
+
+namespace kaycc {
+
+    class CpuTopology {
+    public:
+        struct Cpu {
+            int id;       //逻辑CPU编号
+            int core;     //物理核的编号，在整个机器里唯一（同一个核上的超线程相同）
+            int package;  //physical_package_id
+            int node;     //NUMA节点，没有NUMA信息时为0
+        };
+
+        // 读取root下的cpu/和node/，只保留online的CPU；
+        // onlyAllowed为true时再去掉当前进程不能使用的CPU（sched_getaffinity，比如taskset、cgroup cpuset）
+        explicit CpuTopology(const std::string& root = "/sys/devices/system", bool onlyAllowed = true);
+
+        // 本机的拓扑，第一次调用时读取
+        static const CpuTopology& instance();
+
+        // 按逻辑CPU编号排序
+        const std::vector<Cpu>& cpus() const {
+            return cpus_;
+        }
+
+        int numCores() const {
+            return numCores_;
+        }
+
+        int numNodes() const {
+            return numNodes_;
+        }
+
+        // cpu所在的NUMA节点，不存在时返回-1
+        int nodeOf(int cpu) const;
+
+        // 给n个线程选择CPU：每个物理核先只用一个超线程，核按NUMA节点交替排列，
+        // 所有核都用过之后才用各个核的第二个超线程，n超过CPU数时循环使用
+        std::vector<int> spread(int n) const;
+
+        // 解析"0-3,8,10-11"格式的CPU列表（sysfs的格式），格式错误时返回空
+        static std::vector<int> parseCpuList(const std::string& list);
+
+        // 把当前线程绑定到cpu，并且让它的内存优先从cpu所在的NUMA节点分配，绑定失败时返回false
+        static bool bindCurrentThread(int cpu);
+
+        // 当前线程的内存优先从node分配（set_mempolicy(MPOL_PREFERRED)），
+        // 会覆盖从父线程继承的策略（比如numactl --interleave）
+        static bool preferMemoryNode(int node);
+
+    private:
+        std::vector<Cpu> cpus_;
+        int numCores_;
+        int numNodes_;
+    };
+
+}
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef KAYCC_BASE_FUTEX_H
+#define KAYCC_BASE_FUTEX_H
+
+#include <boost/noncopyable.hpp>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+futex系统调用的简单封装。
+futex只在真正需要休眠/唤醒时才进入内核，没有竞争时只是一次用户态的原子操作。
+这里只用进程内的FUTEX_PRIVATE_FLAG版本。
+*/
+
+namespace kaycc {
+namespace futex {
+
+    // *addr == expected时休眠，直到被wake唤醒、超时或者被信号打断；
+    // *addr != expected时立即返回。timeout为相对时间，NULL表示一直等待
+    inline int wait(volatile int32_t* addr, int32_t expected, const struct timespec* timeout = NULL) {
+        return static_cast<int>(::syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expected, timeout, NULL, 0));
+    }
+
+    // 最多唤醒count个在addr上休眠的线程，返回实际唤醒的个数
+    inline int wake(volatile int32_t* addr, int count) {
+        return static_cast<int>(::syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0));
+    }
+
+}
+
+    /*
+    基于futex的事件计数，用来代替Condition让线程在某个条件上休眠，不需要额外的互斥锁。
+    等待方：
+        int32_t key = ec.prepareWait();
+        if (条件已满足) { ec.cancelWait(); } else { ec.wait(key); }
+    通知方先让条件满足，再调用notify()。
+    prepareWait之后如果有notify，epoch_已经变化，wait会立即返回，所以不会丢失唤醒。
+    没有线程等待时notify只是一次内存屏障加一次读，不进入内核。
+    */
+    class EventCount : boost::noncopyable {
+    public:
+        EventCount()
+            : epoch_(0),
+              waiters_(0) {
+        }
+
+        int32_t prepareWait() {
+            __sync_fetch_and_add(&waiters_, 1); //全内存屏障，之后对条件的检查不会被重排到前面
+            return __atomic_load_n(&epoch_, __ATOMIC_ACQUIRE);
+        }
+
+        void cancelWait() {
+            __sync_fetch_and_sub(&waiters_, 1);
+        }
+
+        void wait(int32_t key) {
+            while (__atomic_load_n(&epoch_, __ATOMIC_ACQUIRE) == key) {
+                futex::wait(&epoch_, key);
+            }
+            __sync_fetch_and_sub(&waiters_, 1);
+        }
+
+        void notify() {
+            notifyMany(1);
+        }
+
+        void notifyAll() {
+            notifyMany(INT32_MAX);
+        }
+
+    private:
+        void notifyMany(int count) {
+            __sync_synchronize(); //与prepareWait里的屏障配对，保证条件的修改先于对waiters_的读取
+            if (__atomic_load_n(&waiters_, __ATOMIC_RELAXED) > 0) {
+                __sync_fetch_and_add(&epoch_, 1);
+                futex::wake(&epoch_, count);
+            }
+        }
+
+    private:
+        volatile int32_t epoch_;    //每次通知加1，futex等待的就是这个值
+        volatile int32_t waiters_;  //正在等待（或准备等待）的线程数
+    };
+
+}
+
+#endif
@@ -0,0 +1,428 @@
+#ifndef KAYCC_BASE_FUTURE_H
+#define KAYCC_BASE_FUTURE_H
+
+#include "condition.h"
+#include "mutex.h"
+#include "timestamp.h"
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/utility/result_of.hpp>
+
+#include <exception>
+#include <vector>
+
+/*
+轻量的Promise/Future，配合ThreadPool::submit使用。
+Promise负责设置结果，Future负责取结果，两者共享同一个FutureState。
+Future::then(f)注册一个延续：结果就绪后在设置结果的线程里调用f（已经就绪则在调用then的线程里立即调用），
+返回f的结果对应的Future，可以继续串联。
+Future::then(loop, f)让f在指定的EventLoop线程里执行（通过loop->queueInLoop），
+这里对Loop类型做成模板参数，base不依赖net。
+任务抛出的异常不会传递到Future，仍然按ThreadPool的方式处理。
+Promise的所有拷贝都销毁了还没有设置结果（比如任务还在队列里时ThreadPool::stop()），
+Future变为broken：等待的线程被唤醒，get()抛出BrokenPromise，已经注册的延续不再调用，
+它们的Future也随之broken。
+*/
+
+namespace kaycc {
+
+    template <typename T> class Future;
+    template <typename T> class Promise;
+
+    // Promise没有设置结果就被销毁了
+    class BrokenPromise : public std::exception {
+    public:
+        virtual const char* what() const throw() {
+            return "kaycc::BrokenPromise";
+        }
+    };
+
+namespace detail {
+
+    struct Void {}; //Future<void>内部使用的占位值
+
+    template <typename T>
+    class FutureState : boost::noncopyable {
+    public:
+        typedef boost::function<void ()> Callback;
+
+        FutureState()
+            : mutex_(),
+              cond_(mutex_),
+              ready_(false),
+              broken_(false) {
+        }
+
+        void set(const T& value) {
+            std::vector<Callback> callbacks;
+            {
+                MutexLockGuard lock(mutex_);
+                assert(!ready_);
+                value_ = value;
+                ready_ = true;
+                callbacks.swap(callbacks_);
+                cond_.notifyAll();
+            }
+
+            // 在锁外调用延续，延续里可能再访问这个FutureState
+            for (size_t i = 0; i < callbacks.size(); ++i) {
+                callbacks[i]();
+            }
+        }
+
+        // 最后一个Promise销毁时调用，还没有设置结果就标记为broken
+        void abandon() {
+            std::vector<Callback> callbacks;
+            {
+                MutexLockGuard lock(mutex_);
+                if (ready_) {
+                    return;
+                }
+                broken_ = true;
+                callbacks.swap(callbacks_);
+                cond_.notifyAll();
+            }
+            // 延续不调用，在锁外销毁，它们持有的Promise随之销毁，后面的Future也变为broken
+        }
+
+        // 就绪后调用cb，已经就绪就立即调用；已经broken时cb被丢弃
+        void onReady(const Callback& cb) {
+            {
+                MutexLockGuard lock(mutex_);
+                if (broken_) {
+                    return;
+                }
+                if (!ready_) {
+                    callbacks_.push_back(cb);
+                    return;
+                }
+            }
+            cb();
+        }
+
+        // broken时抛出BrokenPromise
+        const T& get() {
+            wait();
+            if (broken_) {
+                throw BrokenPromise();
+            }
+            return *value_; //就绪后value_不再修改，可以在锁外读
+        }
+
+        // 就绪或者broken时返回
+        void wait() {
+            MutexLockGuard lock(mutex_);
+            while (!ready_ && !broken_) {
+                cond_.wait();
+            }
+        }
+
+        // 超时返回false。Condition::waitForSeconds可能提前返回（虚假唤醒），按截止时间重新计算剩余的时间
+        bool waitForSeconds(double seconds) {
+            Timestamp deadline(addTime(Timestamp::monotonicNow(), seconds));
+            MutexLockGuard lock(mutex_);
+            while (!ready_ && !broken_) {
+                double remaining = timeDifference(deadline, Timestamp::monotonicNow());
+                if (remaining <= 0) {
+                    break;
+                }
+                cond_.waitForSeconds(remaining);
+            }
+            return ready_ || broken_;
+        }
+
+        bool ready() const {
+            MutexLockGuard lock(mutex_);
+            return ready_;
+        }
+
+        bool broken() const {
+            MutexLockGuard lock(mutex_);
+            return broken_;
+        }
+
+    private:
+        mutable MutexLock mutex_;
+        Condition cond_;
+        bool ready_;
+        bool broken_;
+        boost::optional<T> value_;
+        std::vector<Callback> callbacks_;
+    };
+
+    // Promise的所有拷贝共享一个，最后一个拷贝销毁时放弃还没有设置的结果
+    template <typename T>
+    class PromiseOwner : boost::noncopyable {
+    public:
+        PromiseOwner()
+            : state_(new FutureState<T>) {
+        }
+
+        ~PromiseOwner() {
+            state_->abandon();
+        }
+
+        const boost::shared_ptr<FutureState<T> >& state() const {
+            return state_;
+        }
+
+    private:
+        boost::shared_ptr<FutureState<T> > state_;
+    };
+
+    // 调用f，把结果设置到promise上；R为void时单独处理
+    template <typename R>
+    struct Fulfill {
+        template <typename F>
+        static void call(Promise<R>& promise, F& f) {
+            promise.setValue(f());
+        }
+
+        template <typename F, typename A>
+        static void callWith(Promise<R>& promise, F& f, const A& arg) {
+            promise.setValue(f(arg));
+        }
+    };
+
+    template <>
+    struct Fulfill<void> {
+        template <typename F>
+        static void call(Promise<void>& promise, F& f);
+
+        template <typename F, typename A>
+        static void callWith(Promise<void>& promise, F& f, const A& arg);
+    };
+
+    // 下面都不用boost::bind，f本身可能就是bind表达式，嵌套的bind会被当成参数求值
+
+    // 执行f()并设置结果，ThreadPool::submit用
+    template <typename R, typename F>
+    struct RunTask {
+        RunTask(const Promise<R>& p, const F& func)
+            : promise(p), f(func) {
+        }
+
+        void operator()() {
+            Fulfill<R>::call(promise, f);
+        }
+
+        Promise<R> promise;
+        F f;
+    };
+
+    // 前一个Future就绪后执行f(value)并设置结果，Future::then用。
+    // 延续由FutureState自己持有，这里只保存裸指针，避免shared_ptr循环引用；
+    // 延续被调用时（set()里或者已就绪时的onReady()里）FutureState一定还活着
+    template <typename R, typename F, typename A>
+    struct Continuation {
+        Continuation(const Promise<R>& p, const F& func, FutureState<A>* s)
+            : promise(p), f(func), state(s) {
+        }
+
+        void operator()() {
+            Fulfill<R>::callWith(promise, f, state->get());
+        }
+
+        Promise<R> promise;
+        F f;
+        FutureState<A>* state;
+    };
+
+    // 保存了结果副本的延续，在EventLoop线程里执行，那时FutureState可能已经销毁
+    template <typename R, typename F, typename A>
+    struct BoundContinuation {
+        BoundContinuation(const Promise<R>& p, const F& func, const A& v)
+            : promise(p), f(func), value(v) {
+        }
+
+        void operator()() {
+            Fulfill<R>::callWith(promise, f, value);
+        }
+
+        Promise<R> promise;
+        F f;
+        A value;
+    };
+
+    // Future<void>的延续，f没有参数
+    template <typename R, typename F>
+    struct VoidContinuation {
+        VoidContinuation(const Promise<R>& p, const F& func)
+            : promise(p), f(func) {
+        }
+
+        void operator()() {
+            Fulfill<R>::call(promise, f);
+        }
+
+        Promise<R> promise;
+        F f;
+    };
+
+    // 就绪时把延续投递到loop里执行
+    template <typename Loop, typename R, typename F, typename A>
+    struct LoopContinuation {
+        LoopContinuation(Loop* l, const Promise<R>& p, const F& func, FutureState<A>* s)
+            : loop(l), promise(p), f(func), state(s) {
+        }
+
+        void operator()() {
+            loop->queueInLoop(BoundContinuation<R, F, A>(promise, f, state->get()));
+        }
+
+        Loop* loop;
+        Promise<R> promise;
+        F f;
+        FutureState<A>* state;
+    };
+
+    template <typename Loop, typename R, typename F>
+    struct LoopVoidContinuation {
+        LoopVoidContinuation(Loop* l, const Promise<R>& p, const F& func)
+            : loop(l), promise(p), f(func) {
+        }
+
+        void operator()() {
+            loop->queueInLoop(VoidContinuation<R, F>(promise, f));
+        }
+
+        Loop* loop;
+        Promise<R> promise;
+        F f;
+    };
+
+}
+
+    template <typename T>
+    class Future {
+    public:
+        Future() {}
+
+        bool valid() const { return static_cast<bool>(state_); }
+        bool ready() const { return state_->ready(); }
+        bool broken() const { return state_->broken(); }
+        // 就绪或者broken时返回
+        void wait() const { state_->wait(); }
+        bool waitForSeconds(double seconds) const { return state_->waitForSeconds(seconds); }
+
+        // 阻塞直到结果就绪，broken时抛出BrokenPromise
+        const T& get() const { return state_->get(); }
+
+        // f的参数为const T&
+        template <typename F>
+        Future<typename boost::result_of<F(const T&)>::type> then(F f) const {
+            typedef typename boost::result_of<F(const T&)>::type R;
+            Promise<R> promise;
+            state_->onReady(detail::Continuation<R, F, T>(promise, f, state_.get()));
+            return promise.getFuture();
+        }
+
+        // f在loop所在的线程里执行
+        template <typename Loop, typename F>
+        Future<typename boost::result_of<F(const T&)>::type> then(Loop* loop, F f) const {
+            typedef typename boost::result_of<F(const T&)>::type R;
+            Promise<R> promise;
+            state_->onReady(detail::LoopContinuation<Loop, R, F, T>(loop, promise, f, state_.get()));
+            return promise.getFuture();
+        }
+
+    private:
+        friend class Promise<T>;
+
+        explicit Future(const boost::shared_ptr<detail::FutureState<T> >& state)
+            : state_(state) {
+        }
+
+        boost::shared_ptr<detail::FutureState<T> > state_;
+    };
+
+    template <>
+    class Future<void> {
+    public:
+        Future() {}
+
+        bool valid() const { return static_cast<bool>(state_); }
+        bool ready() const { return state_->ready(); }
+        bool broken() const { return state_->broken(); }
+        void wait() const { state_->wait(); }
+        bool waitForSeconds(double seconds) const { return state_->waitForSeconds(seconds); }
+        void get() const { state_->get(); }
+
+        // f没有参数
+        template <typename F>
+        Future<typename boost::result_of<F()>::type> then(F f) const {
+            typedef typename boost::result_of<F()>::type R;
+            Promise<R> promise;
+            state_->onReady(detail::VoidContinuation<R, F>(promise, f));
+            return promise.getFuture();
+        }
+
+        template <typename Loop, typename F>
+        Future<typename boost::result_of<F()>::type> then(Loop* loop, F f) const {
+            typedef typename boost::result_of<F()>::type R;
+            Promise<R> promise;
+            state_->onReady(detail::LoopVoidContinuation<Loop, R, F>(loop, promise, f));
+            return promise.getFuture();
+        }
+
+    private:
+        friend class Promise<void>;
+
+        explicit Future(const boost::shared_ptr<detail::FutureState<detail::Void> >& state)
+            : state_(state) {
+        }
+
+        boost::shared_ptr<detail::FutureState<detail::Void> > state_;
+    };
+
+    // 可拷贝，拷贝之间共享同一个结果，只能设置一次
+    template <typename T>
+    class Promise {
+    public:
+        Promise()
+            : owner_(new detail::PromiseOwner<T>) {
+        }
+
+        void setValue(const T& value) { owner_->state()->set(value); }
+        Future<T> getFuture() const { return Future<T>(owner_->state()); }
+
+    private:
+        boost::shared_ptr<detail::PromiseOwner<T> > owner_;
+    };
+
+    template <>
+    class Promise<void> {
+    public:
+        Promise()
+            : owner_(new detail::PromiseOwner<detail::Void>) {
+        }
+
+        void setValue() { owner_->state()->set(detail::Void()); }
+        Future<void> getFuture() const { return Future<void>(owner_->state()); }
+
+    private:
+        boost::shared_ptr<detail::PromiseOwner<detail::Void> > owner_;
+    };
+
+namespace detail {
+
+    template <typename F>
+    void Fulfill<void>::call(Promise<void>& promise, F& f) {
+        f();
+        promise.setValue();
+    }
+
+    template <typename F, typename A>
+    void Fulfill<void>::callWith(Promise<void>& promise, F& f, const A& arg) {
+        f(arg);
+        promise.setValue();
+    }
+
+}
+
+}
+
+#endif
@@ -0,0 +1,172 @@
+#ifndef KAYCC_BASE_INTHASHMAP_H
+#define KAYCC_BASE_INTHASHMAP_H
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+/*
+以uint64_t为键的开放寻址哈希表（线性探测），用来代替std::map<std::string, ...>这类按名字查找的表：
+    所有槽位在一个连续数组里，插入、查找都没有额外的内存分配（只有扩容时整体重建）；
+    键乘以黄金分割常数取高位作为起始槽位（Fibonacci hashing），连续或等间隔的id也能均匀分布；
+    删除时把后面同一簇的元素往前移（backward shift），不留墓碑，表不会随着增删变慢。
+键0保留表示空槽位，调用者的id要从1开始。不是线程安全的。
+*/
+
+namespace kaycc {
+
+    template <typename V>
+    class IntHashMap {
+    public:
+        explicit IntHashMap(size_t initialCapacity = 16)
+            : size_(0) {
+            size_t capacity = 8;
+            while (capacity < initialCapacity) {
+                capacity <<= 1;
+            }
+            rehash(capacity);
+        }
+
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+        size_t capacity() const { return slots_.size(); }
+
+        // 已经存在时不覆盖，返回false
+        bool insert(uint64_t key, const V& value) {
+            assert(key != 0);
+            if ((size_ + 1) * 4 > slots_.size() * 3) { //负载因子不超过3/4
+                rehash(slots_.size() * 2);
+            }
+
+            size_t i = indexFor(key);
+            while (slots_[i].key != 0) {
+                if (slots_[i].key == key) {
+                    return false;
+                }
+                i = (i + 1) & mask_;
+            }
+            slots_[i].key = key;
+            slots_[i].value = value;
+            ++size_;
+            return true;
+        }
+
+        // 不存在时返回NULL，返回的指针在下一次insert/erase之前有效
+        V* find(uint64_t key) {
+            assert(key != 0);
+            size_t i = indexFor(key);
+            while (slots_[i].key != 0) {
+                if (slots_[i].key == key) {
+                    return &slots_[i].value;
+                }
+                i = (i + 1) & mask_;
+            }
+            return NULL;
+        }
+
+        const V* find(uint64_t key) const {
+            return const_cast<IntHashMap*>(this)->find(key);
+        }
+
+        bool erase(uint64_t key) {
+            assert(key != 0);
+            size_t i = indexFor(key);
+            while (slots_[i].key != key) {
+                if (slots_[i].key == 0) {
+                    return false;
+                }
+                i = (i + 1) & mask_;
+            }
+
+            // 把后面的元素往前移，直到遇到空槽位，或者某个元素已经在它的起始槽位和空洞之间（不能前移）
+            size_t hole = i;
+            size_t j = i;
+            for (;;) {
+                j = (j + 1) & mask_;
+                if (slots_[j].key == 0) {
+                    break;
+                }
+                size_t home = indexFor(slots_[j].key);
+                // home在(hole, j]之间（循环意义下）时，j不能移到hole
+                if (((j - home) & mask_) >= ((j - hole) & mask_)) {
+                    slots_[hole].key = slots_[j].key;
+                    slots_[hole].value = std::move(slots_[j].value);
+                    hole = j;
+                }
+            }
+            slots_[hole].key = 0;
+            slots_[hole].value = V();
+            --size_;
+            return true;
+        }
+
+        void clear() {
+            for (size_t i = 0; i < slots_.size(); ++i) {
+                slots_[i].key = 0;
+                slots_[i].value = V();
+            }
+            size_ = 0;
+        }
+
+        void swap(IntHashMap& that) {
+            slots_.swap(that.slots_);
+            std::swap(size_, that.size_);
+            std::swap(mask_, that.mask_);
+            std::swap(shift_, that.shift_);
+        }
+
+        // 遍历所有元素，f(key, value)，遍历期间不能增删
+        template <typename F>
+        void forEach(F f) {
+            for (size_t i = 0; i < slots_.size(); ++i) {
+                if (slots_[i].key != 0) {
+                    f(slots_[i].key, slots_[i].value);
+                }
+            }
+        }
+
+    private:
+        struct Slot {
+            Slot() : key(0), value() {}
+
+            uint64_t key;
+            V value;
+        };
+
+        size_t indexFor(uint64_t key) const {
+            return static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> shift_);
+        }
+
+        void rehash(size_t capacity) {
+            std::vector<Slot> old;
+            old.swap(slots_);
+            slots_.resize(capacity);
+            mask_ = capacity - 1;
+            shift_ = 64;
+            for (size_t c = capacity; c > 1; c >>= 1) {
+                --shift_;
+            }
+
+            for (size_t i = 0; i < old.size(); ++i) {
+                if (old[i].key != 0) {
+                    size_t j = indexFor(old[i].key);
+                    while (slots_[j].key != 0) {
+                        j = (j + 1) & mask_;
+                    }
+                    slots_[j].key = old[i].key;
+                    slots_[j].value = std::move(old[i].value);
+                }
+            }
+        }
+
+        std::vector<Slot> slots_;
+        size_t size_;
+        size_t mask_;
+        int shift_; //64 - log2(capacity)
+    };
+
+}
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef KAYCC_BASE_LATCH_H
+#define KAYCC_BASE_LATCH_H
+
+#include "futex.h"
+
+#include <boost/noncopyable.hpp>
+
+#include <assert.h>
+#include <stdint.h>
+#include <time.h>
+
+/*
+基于futex的同步原语，不需要MutexLock和Condition：
+Latch         倒计时，计数减到0时唤醒所有等待者，和CountDownLatch语义相同
+Barrier       可重复使用的屏障，凑齐count个线程后一起放行
+OneShotEvent  一次性事件，set之后所有wait立即返回，不能复位
+没有线程等待时countDown/set只是一次原子操作（外加一次普通的读），不进入内核。
+CountDownLatch保留原来的接口和实现，这里是新代码的首选。
+*/
+
+namespace kaycc {
+
+    class Latch : boost::noncopyable {
+    public:
+        explicit Latch(int count)
+            : count_(count),
+              waiters_(0) {
+            assert(count >= 0);
+        }
+
+        void countDown() {
+            // seq_cst：计数的修改和对waiters_的读，与wait中的顺序正好相反，两边至少有一方能看到对方
+            if (__atomic_sub_fetch(&count_, 1, __ATOMIC_SEQ_CST) == 0
+                && __atomic_load_n(&waiters_, __ATOMIC_SEQ_CST) != 0) {
+                futex::wake(&count_, INT32_MAX);
+            }
+        }
+
+        void wait() {
+            int32_t c = __atomic_load_n(&count_, __ATOMIC_ACQUIRE);
+            if (c <= 0) {
+                return;
+            }
+
+            __atomic_store_n(&waiters_, 1, __ATOMIC_SEQ_CST);
+            while ((c = __atomic_load_n(&count_, __ATOMIC_SEQ_CST)) > 0) {
+                futex::wait(&count_, c); //计数变了就立即返回，重新检查
+            }
+        }
+
+        bool tryWait() const {
+            return __atomic_load_n(&count_, __ATOMIC_ACQUIRE) <= 0;
+        }
+
+        int getCount() const {
+            return __atomic_load_n(&count_, __ATOMIC_RELAXED);
+        }
+
+    private:
+        volatile int32_t count_;
+        volatile int32_t waiters_; //曾经有线程进入过休眠，countDown到0时才需要futex唤醒
+    };
+
+    class Barrier : boost::noncopyable {
+    public:
+        explicit Barrier(int count)
+            : count_(count),
+              arrived_(0),
+              generation_(0) {
+            assert(count > 0);
+        }
+
+        // 等到凑齐count个线程；最后一个到达的线程返回true（可以用来做每轮一次的收尾工作），其他返回false
+        bool arriveAndWait() {
+            int32_t gen = __atomic_load_n(&generation_, __ATOMIC_ACQUIRE);
+            if (__atomic_add_fetch(&arrived_, 1, __ATOMIC_ACQ_REL) == count_) {
+                // 先清零再换代：下一轮的线程一定是看到新的generation_之后才会修改arrived_
+                __atomic_store_n(&arrived_, 0, __ATOMIC_RELAXED);
+                __atomic_add_fetch(&generation_, 1, __ATOMIC_RELEASE);
+                if (count_ > 1) {
+                    futex::wake(&generation_, INT32_MAX);
+                }
+                return true;
+            }
+
+            while (__atomic_load_n(&generation_, __ATOMIC_ACQUIRE) == gen) {
+                futex::wait(&generation_, gen);
+            }
+            return false;
+        }
+
+    private:
+        const int32_t count_;
+        volatile int32_t arrived_;    //本轮已到达的线程数
+        volatile int32_t generation_; //轮次，futex等待的就是这个值
+    };
+
+    class OneShotEvent : boost::noncopyable {
+    public:
+        OneShotEvent()
+            : state_(kUnset) {
+        }
+
+        void set() {
+            if (__atomic_exchange_n(&state_, kSet, __ATOMIC_RELEASE) == kWaiting) {
+                futex::wake(&state_, INT32_MAX);
+            }
+        }
+
+        bool isSet() const {
+            return __atomic_load_n(&state_, __ATOMIC_ACQUIRE) == kSet;
+        }
+
+        void wait() {
+            while (!prepareWait()) {
+                futex::wait(&state_, kWaiting);
+            }
+        }
+
+        // 最多等待seconds秒，返回事件是否已经发生
+        bool waitForSeconds(double seconds) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            int64_t ns = static_cast<int64_t>(seconds * 1e9) + deadline.tv_nsec;
+            deadline.tv_sec += static_cast<time_t>(ns / 1000000000);
+            deadline.tv_nsec = static_cast<long>(ns % 1000000000);
+
+            while (!prepareWait()) {
+                struct timespec now;
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                struct timespec timeout;
+                timeout.tv_sec = deadline.tv_sec - now.tv_sec;
+                timeout.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+                if (timeout.tv_nsec < 0) {
+                    timeout.tv_nsec += 1000000000;
+                    --timeout.tv_sec;
+                }
+                if (timeout.tv_sec < 0) {
+                    return isSet();
+                }
+                futex::wait(&state_, kWaiting, &timeout);
+            }
+            return true;
+        }
+
+    private:
+        static const int32_t kUnset = 0;
+        static const int32_t kWaiting = 1; //未发生，且有线程在等待，set时需要futex唤醒
+        static const int32_t kSet = 2;
+
+        // 已经发生返回true；否则把状态标记为kWaiting后返回false
+        bool prepareWait() {
+            int32_t s = __atomic_load_n(&state_, __ATOMIC_ACQUIRE);
+            if (s == kSet) {
+                return true;
+            }
+            if (s == kUnset) {
+                __atomic_compare_exchange_n(&state_, &s, kWaiting, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE);
+                return s == kSet; //CAS失败时s是当前值
+            }
+            return false;
+        }
+
+        volatile int32_t state_;
+    };
+
+}
+
+#endif
@@ -0,0 +1,158 @@
+#include "lock_profiler.h"
+
+#include <algorithm>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+using namespace kaycc;
+
+std::atomic<bool> LockProfiler::s_enabled(::getenv("KAYCC_LOCK_PROFILE") != NULL);
+
+namespace {
+    // 这里不能用MutexLock，否则统计自己时会递归
+    pthread_mutex_t g_registryMutex = PTHREAD_MUTEX_INITIALIZER;
+    std::map<std::string, LockStats*>* g_registry = NULL; //键是锁名，按位置统计时是“锁名 文件:行号”
+
+    // 按位置查找统计项的线程局部缓存（直接映射），命中时不用加g_registryMutex
+    struct SiteCacheEntry {
+        LockStats* lock;
+        const char* file;
+        int line;
+        LockStats* stats;
+    };
+
+    const size_t kSiteCacheSize = 64;
+    __thread SiteCacheEntry t_siteCache[kSiteCacheSize];
+
+    // 必须持有g_registryMutex
+    LockStats* findOrCreate(const std::string& key, const std::string& name, const std::string& site) {
+        if (g_registry == NULL) {
+            g_registry = new std::map<std::string, LockStats*>;
+        }
+
+        LockStats*& stats = (*g_registry)[key];
+        if (stats == NULL) {
+            stats = new LockStats(name, site);
+        }
+        return stats;
+    }
+
+    int64_t nowNs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    bool byWaitTime(const LockProfiler::Snapshot& lhs, const LockProfiler::Snapshot& rhs) {
+        return lhs.waitNs > rhs.waitNs;
+    }
+}
+
+LockStats* LockProfiler::statsFor(const std::string& name) {
+    pthread_mutex_lock(&g_registryMutex);
+    LockStats* result = findOrCreate(name, name, std::string());
+    pthread_mutex_unlock(&g_registryMutex);
+    return result;
+}
+
+LockStats* LockProfiler::statsFor(LockStats* lock, const char* file, int line) {
+    // file是字符串字面量，同一处的指针不变，直接按指针比较
+    uintptr_t hash = reinterpret_cast<uintptr_t>(file) ^ (reinterpret_cast<uintptr_t>(lock) >> 4) ^ static_cast<uintptr_t>(line) * 31;
+    SiteCacheEntry& entry = t_siteCache[hash % kSiteCacheSize];
+    if (entry.lock == lock && entry.file == file && entry.line == line) {
+        return entry.stats;
+    }
+
+    const char* base = strrchr(file, '/');
+    char site[256];
+    snprintf(site, sizeof(site), "%s:%d", base != NULL ? base + 1 : file, line);
+
+    pthread_mutex_lock(&g_registryMutex);
+    LockStats* result = findOrCreate(lock->name + " " + site, lock->name, site);
+    pthread_mutex_unlock(&g_registryMutex);
+
+    entry.lock = lock;
+    entry.file = file;
+    entry.line = line;
+    entry.stats = result;
+    return result;
+}
+
+void LockProfiler::lock(pthread_mutex_t* mutex, LockStats* stats) {
+    stats->acquisitions.fetch_add(1, std::memory_order_relaxed);
+    if (pthread_mutex_trylock(mutex) == 0) {
+        return;
+    }
+
+    int64_t start = nowNs();
+    pthread_mutex_lock(mutex);
+    int64_t wait = nowNs() - start;
+
+    stats->contentions.fetch_add(1, std::memory_order_relaxed);
+    stats->waitNs.fetch_add(wait, std::memory_order_relaxed);
+
+    int64_t maxWait = stats->maxWaitNs.load(std::memory_order_relaxed);
+    while (wait > maxWait && !stats->maxWaitNs.compare_exchange_weak(maxWait, wait, std::memory_order_relaxed)) {
+    }
+}
+
+std::vector<LockProfiler::Snapshot> LockProfiler::snapshot() {
+    std::vector<Snapshot> result;
+    pthread_mutex_lock(&g_registryMutex);
+    if (g_registry != NULL) {
+        for (std::map<std::string, LockStats*>::const_iterator it = g_registry->begin(); it != g_registry->end(); ++it) {
+            const LockStats* stats = it->second;
+            Snapshot s;
+            s.name = stats->name;
+            s.site = stats->site;
+            s.acquisitions = stats->acquisitions.load(std::memory_order_relaxed);
+            s.contentions = stats->contentions.load(std::memory_order_relaxed);
+            s.waitNs = stats->waitNs.load(std::memory_order_relaxed);
+            s.maxWaitNs = stats->maxWaitNs.load(std::memory_order_relaxed);
+            result.push_back(s);
+        }
+    }
+    pthread_mutex_unlock(&g_registryMutex);
+
+    std::sort(result.begin(), result.end(), byWaitTime);
+    return result;
+}
+
+std::string LockProfiler::report() {
+    std::vector<Snapshot> stats(snapshot());
+    std::string result;
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%-32s %-28s %12s %12s %14s %12s\n",
+             "lock", "site", "acquired", "contended", "wait(us)", "max(us)");
+    result += buf;
+    for (size_t i = 0; i < stats.size(); ++i) {
+        if (stats[i].acquisitions == 0) {
+            continue;
+        }
+        snprintf(buf, sizeof(buf), "%-32s %-28s %12lld %12lld %14.1f %12.1f\n",
+                 stats[i].name.c_str(), stats[i].site.empty() ? "-" : stats[i].site.c_str(),
+                 static_cast<long long>(stats[i].acquisitions),
+                 static_cast<long long>(stats[i].contentions),
+                 static_cast<double>(stats[i].waitNs) / 1000,
+                 static_cast<double>(stats[i].maxWaitNs) / 1000);
+        result += buf;
+    }
+    return result;
+}
+
+void LockProfiler::reset() {
+    pthread_mutex_lock(&g_registryMutex);
+    if (g_registry != NULL) {
+        for (std::map<std::string, LockStats*>::iterator it = g_registry->begin(); it != g_registry->end(); ++it) {
+            LockStats* stats = it->second;
+            stats->acquisitions.store(0, std::memory_order_relaxed);
+            stats->contentions.store(0, std::memory_order_relaxed);
+            stats->waitNs.store(0, std::memory_order_relaxed);
+            stats->maxWaitNs.store(0, std::memory_order_relaxed);
+        }
+    }
+    pthread_mutex_unlock(&g_registryMutex);
+}
@@ -0,0 +1,83 @@
+#ifndef KAYCC_BASE_LOCKPROFILER_H
+#define KAYCC_BASE_LOCKPROFILER_H
+
+#include <boost/noncopyable.hpp>
+
+#include <atomic>
+#include <pthread.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/*
+锁竞争统计。默认关闭，设置环境变量KAYCC_LOCK_PROFILE或者调用LockProfiler::setEnabled(true)打开。
+只统计调用过MutexLock::setName的锁，按“锁名 + 加锁的位置”分别统计：
+MutexLockGuard的构造函数用__builtin_FILE/__builtin_LINE默认参数取得调用处的文件和行号，
+同名的锁（比如所有EventLoop的mutex_）在同一处加锁时合并，不同的加锁位置各占一行，可以看出竞争发生在哪里；
+直接调用MutexLock::lock()时只按锁名统计。
+打开后MutexLock::lock先trylock：成功算一次无竞争的获取；失败再计时阻塞加锁，记一次竞争和等待时间。
+关闭时lock的额外开销只是一次分支判断；打开时按位置查找统计项先查线程局部的缓存，不加锁。
+*/
+
+namespace kaycc {
+
+    struct LockStats : boost::noncopyable {
+        LockStats(const std::string& n, const std::string& s)
+            : name(n),
+              site(s),
+              acquisitions(0),
+              contentions(0),
+              waitNs(0),
+              maxWaitNs(0) {
+        }
+
+        const std::string name;
+        const std::string site;            //加锁的位置“文件:行号”，只按锁名统计时为空
+        std::atomic<int64_t> acquisitions; //加锁次数
+        std::atomic<int64_t> contentions;  //trylock失败、需要等待的次数
+        std::atomic<int64_t> waitNs;       //等待时间总和（纳秒）
+        std::atomic<int64_t> maxWaitNs;    //最长的一次等待
+    };
+
+    class LockProfiler : boost::noncopyable {
+    public:
+        static bool enabled() {
+            return s_enabled.load(std::memory_order_relaxed);
+        }
+
+        static void setEnabled(bool on) {
+            s_enabled.store(on, std::memory_order_relaxed);
+        }
+
+        // 返回name对应的统计项，不存在就创建；统计项在进程退出前不会释放
+        static LockStats* statsFor(const std::string& name);
+
+        // 锁lock（statsFor返回的统计项）在file:line处加锁时使用的统计项，不存在就创建
+        static LockStats* statsFor(LockStats* lock, const char* file, int line);
+
+        // 统计加锁，由MutexLock::lock在打开统计时调用
+        static void lock(pthread_mutex_t* mutex, LockStats* stats);
+
+        // 所有统计项的快照，按等待时间总和从大到小排序
+        struct Snapshot {
+            std::string name;
+            std::string site;
+            int64_t acquisitions;
+            int64_t contentions;
+            int64_t waitNs;
+            int64_t maxWaitNs;
+        };
+        static std::vector<Snapshot> snapshot();
+
+        // 每行一个（锁，加锁位置）的文本报告，没有加过锁的项不列出
+        static std::string report();
+
+        static void reset();
+
+    private:
+        static std::atomic<bool> s_enabled;
+    };
+
+}
+
+#endif
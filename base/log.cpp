@@ -0,0 +1,116 @@
+#include "log.h"
+
+#include "current_thread.h"
+#include "timestamp.h"
+
+#include <atomic>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+using namespace kaycc;
+
+namespace {
+    const char* const kLevelNames[Logger::NUM_LOG_LEVELS] = {
+        "TRACE ",
+        "DEBUG ",
+        "INFO  ",
+        "WARN  ",
+        "ERROR ",
+        "FATAL ",
+    };
+
+    Logger::LogLevel initLogLevel() {
+        const char* env = ::getenv("KAYCC_LOG_LEVEL");
+        if (env != NULL && *env != '\0') {
+            for (int i = 0; i < Logger::NUM_LOG_LEVELS; ++i) {
+                if (::strncasecmp(env, kLevelNames[i], ::strlen(env)) == 0) {
+                    return static_cast<Logger::LogLevel>(i);
+                }
+            }
+        }
+        return Logger::INFO;
+    }
+
+    void defaultOutput(const char* msg, int len) {
+        ::fwrite(msg, 1, len, stdout);
+    }
+
+    void defaultFlush() {
+        ::fflush(stdout);
+    }
+
+    // 可能在其他线程写日志时被替换
+    std::atomic<Logger::OutputFunc> g_output(defaultOutput);
+    std::atomic<Logger::FlushFunc> g_flush(defaultFlush);
+
+    // 同一秒内的日志复用格式化好的日期时间，只重新格式化微秒部分
+    __thread time_t t_lastSecond = 0;
+    __thread char t_time[32];
+
+    // 只保留文件名，去掉路径
+    const char* baseName(const char* file) {
+        const char* slash = ::strrchr(file, '/');
+        return slash != NULL ? slash + 1 : file;
+    }
+}
+
+std::atomic<int> Logger::s_logLevel(initLogLevel());
+
+Logger::Logger(const char* file, int line, LogLevel level, const char* func)
+    : file_(file),
+      line_(line),
+      level_(level),
+      func_(func) {
+}
+
+Logger::~Logger() {
+    Timestamp now(Timestamp::now());
+    time_t seconds = now.secondsSinceEpoch();
+    int microseconds = static_cast<int>(now.microSecondsSinceEpoch() % Timestamp::kMicroSecondsPerSecond);
+    if (seconds != t_lastSecond) {
+        t_lastSecond = seconds;
+        struct tm tm;
+        ::localtime_r(&seconds, &tm);
+        ::strftime(t_time, sizeof(t_time), "%Y%m%d %H:%M:%S", &tm);
+    }
+
+    currentthread::tid();
+
+    // 前缀：20260101 12:00:00.123456 12345 INFO  file.cpp:10:func
+    char prefix[160];
+    int n = ::snprintf(prefix, sizeof(prefix), "%s.%06d %s %s%s:%d:%s ",
+                       t_time, microseconds, currentthread::tidString(), kLevelNames[level_],
+                       baseName(file_), line_, func_);
+    if (n >= static_cast<int>(sizeof(prefix))) {
+        n = sizeof(prefix) - 1;
+    }
+
+    std::string line(prefix, n);
+    line += stream_.str();
+    // 原来的调用点都以std::endl结尾，没有的补上换行
+    if (line.empty() || line[line.size() - 1] != '\n') {
+        line += '\n';
+    }
+    g_output.load(std::memory_order_acquire)(line.data(), static_cast<int>(line.size()));
+
+    if (level_ == FATAL) {
+        g_flush.load(std::memory_order_acquire)();
+        ::abort();
+    }
+}
+
+void Logger::setLogLevel(LogLevel level) {
+    s_logLevel.store(level, std::memory_order_relaxed);
+}
+
+void Logger::setOutput(OutputFunc out) {
+    g_output.store(out != NULL ? out : defaultOutput, std::memory_order_release);
+}
+
+void Logger::setFlush(FlushFunc flush) {
+    g_flush.store(flush != NULL ? flush : defaultFlush, std::memory_order_release);
+}
@@ -1,8 +1,101 @@
 #ifndef KAYCC_BASE_LOG_H
 #define KAYCC_BASE_LOG_H
 
+#include <boost/noncopyable.hpp>
+
+#include <atomic>
 #include <iostream>
+#include <sstream>
+
+/*
+分级日志。用法和原来的LOG一样：
+    LOG_DEBUG << "fd=" << fd << std::endl;
+每条日志先格式化到Logger自己的缓冲里，析构时加上时间、线程id、级别和位置，整行交给输出函数，
+默认的输出函数写stdout，可以用Logger::setOutput换成异步后端。
+两道过滤：
+    运行时：级别低于Logger::logLevel()的日志不求值参数，只有一次比较。
+            初始级别取自环境变量KAYCC_LOG_LEVEL（TRACE/DEBUG/INFO/WARN/ERROR/FATAL），默认INFO。
+    编译期：级别低于KAYCC_LOG_COMPILE_LEVEL的日志整条语句被编译器删掉。
+            默认是KAYCC_LOG_LEVEL_INFO，即TRACE/DEBUG不进入默认构建的可执行文件，
+            调试时编译加-DKAYCC_LOG_COMPILE_LEVEL=0打开。
+事件循环里每次循环、每个事件都会走到的日志用TRACE，连接建立/断开这类每个连接一次的用DEBUG，
+这样默认构建的数据路径上没有任何I/O。
+LOG保留为LOG_INFO的别名。
+*/
+
+#define KAYCC_LOG_LEVEL_TRACE 0
+#define KAYCC_LOG_LEVEL_DEBUG 1
+#define KAYCC_LOG_LEVEL_INFO  2
+#define KAYCC_LOG_LEVEL_WARN  3
+#define KAYCC_LOG_LEVEL_ERROR 4
+#define KAYCC_LOG_LEVEL_FATAL 5
+
+#ifndef KAYCC_LOG_COMPILE_LEVEL
+#define KAYCC_LOG_COMPILE_LEVEL KAYCC_LOG_LEVEL_INFO
+#endif
+
+namespace kaycc {
+
+    class Logger : boost::noncopyable {
+    public:
+        enum LogLevel {
+            TRACE = KAYCC_LOG_LEVEL_TRACE,
+            DEBUG = KAYCC_LOG_LEVEL_DEBUG,
+            INFO  = KAYCC_LOG_LEVEL_INFO,
+            WARN  = KAYCC_LOG_LEVEL_WARN,
+            ERROR = KAYCC_LOG_LEVEL_ERROR,
+            FATAL = KAYCC_LOG_LEVEL_FATAL,
+            NUM_LOG_LEVELS,
+        };
+
+        // 输出整行日志（已经带换行），需要是线程安全的
+        typedef void (*OutputFunc)(const char* msg, int len);
+        typedef void (*FlushFunc)();
+
+        Logger(const char* file, int line, LogLevel level, const char* func);
+        ~Logger();
+
+        std::ostream& stream() {
+            return stream_;
+        }
+
+        static LogLevel logLevel() {
+            return static_cast<LogLevel>(s_logLevel.load(std::memory_order_relaxed));
+        }
+
+        static void setLogLevel(LogLevel level);
+
+        // 传NULL恢复默认的stdout
+        static void setOutput(OutputFunc out);
+        static void setFlush(FlushFunc flush);
+
+    private:
+        static std::atomic<int> s_logLevel; //运行时可能被修改，每条日志都要读，用relaxed原子操作
+
+        const char* file_;
+        int line_;
+        LogLevel level_;
+        const char* func_;
+        std::ostringstream stream_;
+    };
+
+}
+
+// if/else的写法避免宏后面跟else时的悬垂else问题；第一个条件是常量，编译期就能判定
+#define KAYCC_LOG_IF(level) \
+    if (KAYCC_LOG_LEVEL_##level < KAYCC_LOG_COMPILE_LEVEL \
+        || kaycc::Logger::logLevel() > KAYCC_LOG_LEVEL_##level) {} \
+    else kaycc::Logger(__FILE__, __LINE__, \
+                       static_cast<kaycc::Logger::LogLevel>(KAYCC_LOG_LEVEL_##level), __FUNCTION__).stream()
+
+#define LOG_TRACE KAYCC_LOG_IF(TRACE)
+#define LOG_DEBUG KAYCC_LOG_IF(DEBUG)
+#define LOG_INFO  KAYCC_LOG_IF(INFO)
+#define LOG_WARN  KAYCC_LOG_IF(WARN)
+#define LOG_ERROR KAYCC_LOG_IF(ERROR)
+// 输出后abort，不受运行时级别的限制
+#define LOG_FATAL kaycc::Logger(__FILE__, __LINE__, kaycc::Logger::FATAL, __FUNCTION__).stream()
 
-#define LOG std::cout <<  __FILE__ << ":" << __LINE__ << ":" << __FUNCTION__ << " "
+#define LOG LOG_INFO
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,115 @@
+#include "log_file.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace kaycc;
+
+LogFile::LogFile(const std::string& basename, off_t rollSize, int flushInterval, int rollInterval)
+    : basename_(basename),
+      rollSize_(rollSize),
+      flushInterval_(flushInterval),
+      rollInterval_(rollInterval),
+      fp_(NULL),
+      writtenBytes_(0),
+      startOfPeriod_(0),
+      lastRoll_(0),
+      lastFlush_(0),
+      rollCount_(0) {
+    assert(!basename.empty());
+    assert(rollInterval > 0);
+    rollFile();
+}
+
+LogFile::~LogFile() {
+    closeFile();
+}
+
+void LogFile::append(const char* logline, size_t len) {
+    if (fp_ == NULL) {
+        return;
+    }
+
+    size_t n = ::fwrite_unlocked(logline, 1, len, fp_);
+    if (n != len) {
+        ::fprintf(stderr, "LogFile::append() failed: %s\n", ::strerror(errno));
+    }
+    writtenBytes_ += static_cast<off_t>(n);
+
+    // 后台线程每次写一整块缓冲，所以每次都检查一下时间也不贵
+    if (writtenBytes_ > rollSize_) {
+        rollFile();
+    } else {
+        time_t now = ::time(NULL);
+        time_t thisPeriod = now / rollInterval_ * rollInterval_;
+        if (thisPeriod != startOfPeriod_) {
+            rollFile();
+        } else if (now - lastFlush_ >= flushInterval_) {
+            lastFlush_ = now;
+            ::fflush(fp_);
+        }
+    }
+}
+
+void LogFile::flush() {
+    if (fp_ != NULL) {
+        ::fflush(fp_);
+    }
+}
+
+bool LogFile::rollFile() {
+    time_t now = ::time(NULL);
+    if (now <= lastRoll_) {
+        return false;
+    }
+
+    lastRoll_ = now;
+    lastFlush_ = now;
+    startOfPeriod_ = now / rollInterval_ * rollInterval_;
+    closeFile();
+    openFile(getLogFileName(basename_, now));
+    ++rollCount_;
+    return true;
+}
+
+std::string LogFile::getLogFileName(const std::string& basename, time_t now) {
+    std::string filename(basename);
+
+    char timebuf[32];
+    struct tm tm;
+    ::gmtime_r(&now, &tm);
+    ::strftime(timebuf, sizeof(timebuf), ".%Y%m%d-%H%M%S.", &tm);
+    filename += timebuf;
+
+    char hostname[256];
+    if (::gethostname(hostname, sizeof(hostname)) == 0) {
+        hostname[sizeof(hostname) - 1] = '\0';
+        filename += hostname;
+    } else {
+        filename += "unknownhost";
+    }
+
+    char pidbuf[32];
+    ::snprintf(pidbuf, sizeof(pidbuf), ".%d.log", ::getpid());
+    filename += pidbuf;
+    return filename;
+}
+
+void LogFile::openFile(const std::string& filename) {
+    fp_ = ::fopen(filename.c_str(), "ae"); // 'e'：O_CLOEXEC
+    if (fp_ == NULL) {
+        ::fprintf(stderr, "LogFile: cannot open %s: %s\n", filename.c_str(), ::strerror(errno));
+        return;
+    }
+    ::setbuffer(fp_, buffer_, sizeof(buffer_));
+    writtenBytes_ = 0;
+}
+
+void LogFile::closeFile() {
+    if (fp_ != NULL) {
+        ::fclose(fp_);
+        fp_ = NULL;
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef KAYCC_BASE_LOGFILE_H
+#define KAYCC_BASE_LOGFILE_H
+
+#include <boost/noncopyable.hpp>
+
+#include <stdio.h>
+#include <string>
+#include <time.h>
+
+/*
+日志文件，按大小和时间滚动：
+    写入的字节数超过rollSize，或者进入了新的时间段（rollInterval秒，默认一天，按UTC对齐），就换一个新文件。
+    文件名：basename.20260101-120000.hostname.pid.log
+每flushInterval秒fflush一次，其余时间依赖stdio的缓冲（缓冲区设为64KB）。
+不是线程安全的，由AsyncLogging的后台线程独占使用。
+*/
+
+namespace kaycc {
+
+    class LogFile : boost::noncopyable {
+    public:
+        LogFile(const std::string& basename,
+                off_t rollSize,
+                int flushInterval = 3,
+                int rollInterval = 60 * 60 * 24);
+        ~LogFile();
+
+        void append(const char* logline, size_t len);
+        void flush();
+
+        // 立即换一个新文件，同一秒内不会重复滚动（文件名会相同），返回是否换了
+        bool rollFile();
+
+        int rollCount() const {
+            return rollCount_;
+        }
+
+    private:
+        static std::string getLogFileName(const std::string& basename, time_t now);
+
+        void openFile(const std::string& filename);
+        void closeFile();
+
+        const std::string basename_;
+        const off_t rollSize_;
+        const int flushInterval_;
+        const int rollInterval_;
+
+        FILE* fp_;
+        off_t writtenBytes_;   //当前文件已写入的字节数
+        time_t startOfPeriod_; //当前文件所在时间段的起点
+        time_t lastRoll_;
+        time_t lastFlush_;
+        int rollCount_;
+        char buffer_[64 * 1024];
+    };
+
+}
+
+#endif
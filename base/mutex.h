@@ -2,6 +2,7 @@
 #define KAYCC_BASE_MUTEX_H
 
 #include "current_thread.h"
+#include "lock_profiler.h"
 #include <boost/noncopyable.hpp>
 #include <assert.h>
 #include <pthread.h>
@@ -50,7 +51,8 @@ namespace kaycc {
 	class MutexLock : boost::noncopyable { //default public
 		public:
 			MutexLock()
-				: holder_(0) {
+				: holder_(0),
+				  stats_(NULL) {
 					KCHECK(pthread_mutex_init(&mutex_, NULL));
 				}
 			~MutexLock() {
@@ -66,8 +68,27 @@ namespace kaycc {
 				assert(isLockedByThisThread());
 			}
 
+			// 给锁起个名字，打开LockProfiler后按名字和加锁位置统计加锁次数和等待时间
+			void setName(const std::string& name) {
+				stats_ = LockProfiler::statsFor(name);
+			}
+
 			void lock() {
-				KCHECK(pthread_mutex_lock(&mutex_));
+				if (__builtin_expect(stats_ != NULL && LockProfiler::enabled(), 0)) {
+					LockProfiler::lock(&mutex_, stats_);
+				} else {
+					KCHECK(pthread_mutex_lock(&mutex_));
+				}
+				assignHolder();
+			}
+
+			// 同lock()，打开LockProfiler时按file:line处的加锁分别统计（MutexLockGuard使用）
+			void lock(const char* file, int line) {
+				if (__builtin_expect(stats_ != NULL && LockProfiler::enabled(), 0)) {
+					LockProfiler::lock(&mutex_, LockProfiler::statsFor(stats_, file, line));
+				} else {
+					KCHECK(pthread_mutex_lock(&mutex_));
+				}
 				assignHolder();
 			}
 
@@ -110,13 +131,18 @@ namespace kaycc {
 		private:
 			pthread_mutex_t mutex_;
 			pid_t holder_;
+			LockStats* stats_; //没有setName时为NULL，不统计
 	};
 
 	class MutexLockGuard : boost::noncopyable {
 		public:
-			explicit MutexLockGuard(MutexLock &mutex) //这里不能为const引用,non-const指针/引用可以转换为const指针引用，反之不行
+			//这里不能为const引用,non-const指针/引用可以转换为const指针引用，反之不行。
+			//file和line的默认值在调用处求值，是构造这个guard的位置，给LockProfiler按位置统计
+			explicit MutexLockGuard(MutexLock &mutex,
+									const char* file = __builtin_FILE(),
+									int line = __builtin_LINE())
 				: mutex_(mutex) {
-					mutex_.lock();
+					mutex_.lock(file, line);
 				}
 
 			~MutexLockGuard() {
@@ -0,0 +1,194 @@
+#ifndef KAYCC_BASE_PARALLEL_H
+#define KAYCC_BASE_PARALLEL_H
+
+#include "atomic.h"
+#include "latch.h"
+#include "threadpool.h"
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <algorithm>
+#include <vector>
+
+/*
+基于ThreadPool的parallelFor/parallelReduce。
+把[begin, end)切成大小为grain的块，工作线程和调用线程都通过一个原子下标领取下一块，
+先做完的线程自动多领，负载不均衡时不用手动拆分。
+调用线程自己也参与计算，并且会把所有没人领取的块都做完；辅助任务用tryRun提交，
+线程池的队列满了（setMaxQueueSize）就不再提交，剩下的块都由调用线程自己做，提交时不会阻塞。
+所以即使线程池很忙（或者在线程池的任务里再调用parallelFor），也不会因为等待工作线程或者队列空位而死锁。
+被拒绝的tryRun会计入ThreadPool::rejectedCount()。
+grain为0时自动选择：每个参与的线程大约分到kChunksPerThread块。
+f会在多个线程里并发调用，需要是线程安全的。
+*/
+
+namespace kaycc {
+
+namespace detail {
+
+    const size_t kChunksPerThread = 4;
+
+    class ParallelState : boost::noncopyable {
+    public:
+        ParallelState(size_t begin, size_t end, size_t grain)
+            : begin_(begin),
+              end_(end),
+              grain_(grain),
+              numChunks_(static_cast<int64_t>((end - begin + grain - 1) / grain)) {
+        }
+
+        int64_t numChunks() const { return numChunks_; }
+
+        // 不断领取块并调用body(chunkIndex, chunkBegin, chunkEnd)，直到没有剩余的块
+        template <typename Body>
+        void work(Body& body) {
+            for (;;) {
+                int64_t chunk = next_.getAndAdd(1);
+                if (chunk >= numChunks_) {
+                    break;
+                }
+
+                size_t b = begin_ + static_cast<size_t>(chunk) * grain_;
+                size_t e = std::min(b + grain_, end_);
+                body(static_cast<size_t>(chunk), b, e);
+
+                if (done_.incrementAndGet() == numChunks_) {
+                    finished_.set();
+                }
+            }
+        }
+
+        // 等待其他线程领走的块全部完成
+        void waitAll() {
+            if (numChunks_ > 0) {
+                finished_.wait();
+            }
+        }
+
+    private:
+        const size_t begin_;
+        const size_t end_;
+        const size_t grain_;
+        const int64_t numChunks_;
+
+        AtomicInt64 next_; //下一个要领取的块
+        AtomicInt64 done_; //已经完成的块数
+
+        OneShotEvent finished_; //所有块都完成时触发
+    };
+
+    // 线程池里执行的任务，晚到的任务发现没有剩余块就直接返回，所以state和body要共享持有
+    template <typename Body>
+    struct ParallelHelper {
+        ParallelHelper(const boost::shared_ptr<ParallelState>& s, const boost::shared_ptr<Body>& b)
+            : state(s), body(b) {
+        }
+
+        void operator()() {
+            state->work(*body);
+        }
+
+        boost::shared_ptr<ParallelState> state;
+        boost::shared_ptr<Body> body;
+    };
+
+    template <typename F>
+    struct ForBody {
+        explicit ForBody(const F& func)
+            : f(func) {
+        }
+
+        void operator()(size_t, size_t b, size_t e) {
+            f(b, e);
+        }
+
+        F f;
+    };
+
+    // 每块的结果放在各自的位置，最后由调用线程按顺序合并，结果与线程数无关
+    template <typename T, typename Map>
+    struct ReduceBody {
+        ReduceBody(const Map& m, size_t numChunks)
+            : map(m), partials(numChunks) {
+        }
+
+        void operator()(size_t chunk, size_t b, size_t e) {
+            partials[chunk] = map(b, e);
+        }
+
+        Map map;
+        std::vector<T> partials;
+    };
+
+    inline size_t chooseGrain(size_t n, size_t workers, size_t grain) {
+        if (grain > 0) {
+            return grain;
+        }
+        return std::max<size_t>(1, n / ((workers + 1) * kChunksPerThread));
+    }
+
+    template <typename Body>
+    void runParallel(ThreadPool& pool, const boost::shared_ptr<ParallelState>& state,
+                     const boost::shared_ptr<Body>& body) {
+        size_t helpers = std::min(pool.numThreads(), static_cast<size_t>(state->numChunks() - 1));
+        for (size_t i = 0; i < helpers; ++i) {
+            if (!pool.tryRun(ParallelHelper<Body>(state, body))) { //队列满了，剩下的由调用线程做
+                break;
+            }
+        }
+
+        state->work(*body);
+        state->waitAll();
+    }
+
+}
+
+    // 对[begin, end)的每一块调用f(chunkBegin, chunkEnd)，返回时所有块都已完成
+    template <typename F>
+    void parallelFor(ThreadPool& pool, size_t begin, size_t end, F f, size_t grain = 0) {
+        if (begin >= end) {
+            return;
+        }
+
+        size_t n = end - begin;
+        grain = detail::chooseGrain(n, pool.numThreads(), grain);
+        if (pool.numThreads() == 0 || grain >= n) { //只有一块，直接在调用线程执行
+            f(begin, end);
+            return;
+        }
+
+        boost::shared_ptr<detail::ParallelState> state(new detail::ParallelState(begin, end, grain));
+        boost::shared_ptr<detail::ForBody<F> > body(new detail::ForBody<F>(f));
+        detail::runParallel(pool, state, body);
+    }
+
+    // 每块调用map(chunkBegin, chunkEnd)得到部分结果，再从init开始用combine(acc, partial)按块的顺序合并
+    template <typename T, typename Map, typename Combine>
+    T parallelReduce(ThreadPool& pool, size_t begin, size_t end, const T& init,
+                     Map map, Combine combine, size_t grain = 0) {
+        if (begin >= end) {
+            return init;
+        }
+
+        size_t n = end - begin;
+        grain = detail::chooseGrain(n, pool.numThreads(), grain);
+        if (pool.numThreads() == 0 || grain >= n) {
+            return combine(init, map(begin, end));
+        }
+
+        boost::shared_ptr<detail::ParallelState> state(new detail::ParallelState(begin, end, grain));
+        boost::shared_ptr<detail::ReduceBody<T, Map> > body(
+            new detail::ReduceBody<T, Map>(map, static_cast<size_t>(state->numChunks())));
+        detail::runParallel(pool, state, body);
+
+        T result(init);
+        for (size_t i = 0; i < body->partials.size(); ++i) {
+            result = combine(result, body->partials[i]);
+        }
+        return result;
+    }
+
+}
+
+#endif
@@ -0,0 +1,205 @@
+#include "rcu.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace kaycc;
+
+std::atomic<size_t> rcu::detail::g_pending(0);
+
+namespace {
+
+    const uint64_t kOffline = 0;
+
+    // 每个读者线程一个，独占cache line，读者只写自己的记录
+    struct alignas(64) ThreadRecord {
+        ThreadRecord() : epoch(kOffline) {}
+
+        std::atomic<uint64_t> epoch; //最近一次静止状态时看到的全局epoch，kOffline表示离线
+    };
+
+    struct Retired {
+        uint64_t epoch; //所有在线读者的epoch都不小于它时才能执行
+        rcu::Callback callback;
+    };
+
+    // 写者每次发布都把它加1，从1开始，所以不会和kOffline混淆
+    std::atomic<uint64_t> g_epoch(1);
+
+    // 保护g_records和g_retired，读者的读路径不会碰它
+    pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+    std::vector<ThreadRecord*>* g_records = NULL;
+    std::vector<Retired>* g_retired = NULL;
+
+    __thread ThreadRecord* t_record = NULL;
+
+    pthread_once_t g_keyOnce = PTHREAD_ONCE_INIT;
+    pthread_key_t g_key;
+
+    // 线程退出时自动注销，避免一个已经退出的线程永远挡住回收
+    void onThreadExit(void*) {
+        rcu::unregisterThread();
+    }
+
+    void createKey() {
+        pthread_key_create(&g_key, &onThreadExit);
+    }
+
+    // 所有在线读者里最小的epoch，都离线时返回UINT64_MAX。需要持有g_mutex
+    uint64_t minOnlineEpoch() {
+        uint64_t result = UINT64_MAX;
+        if (g_records != NULL) {
+            for (size_t i = 0; i < g_records->size(); ++i) {
+                uint64_t e = (*g_records)[i]->epoch.load(std::memory_order_seq_cst);
+                if (e != kOffline) {
+                    result = std::min(result, e);
+                }
+            }
+        }
+        return result;
+    }
+
+    // 新的宽限期：之后报告了静止状态（或者离线）的读者都看不到之前发布的旧版本
+    uint64_t advanceEpoch() {
+        return g_epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+    }
+}
+
+void rcu::registerThread() {
+    if (t_record != NULL) {
+        return;
+    }
+
+    pthread_once(&g_keyOnce, &createKey);
+
+    ThreadRecord* record = new ThreadRecord;
+    pthread_mutex_lock(&g_mutex);
+    if (g_records == NULL) {
+        g_records = new std::vector<ThreadRecord*>;
+    }
+    g_records->push_back(record);
+    pthread_mutex_unlock(&g_mutex);
+
+    t_record = record;
+    pthread_setspecific(g_key, record);
+    threadOnline();
+}
+
+void rcu::unregisterThread() {
+    ThreadRecord* record = t_record;
+    if (record == NULL) {
+        return;
+    }
+
+    record->epoch.store(kOffline, std::memory_order_release);
+    pthread_mutex_lock(&g_mutex);
+    g_records->erase(std::remove(g_records->begin(), g_records->end(), record), g_records->end());
+    pthread_mutex_unlock(&g_mutex);
+
+    t_record = NULL;
+    pthread_setspecific(g_key, NULL);
+    delete record;
+}
+
+bool rcu::isRegistered() {
+    return t_record != NULL;
+}
+
+void rcu::quiescentState() {
+    assert(t_record != NULL);
+    // acquire：看到新的epoch之后，后面读到的一定是那之前发布的版本或者更新的版本
+    t_record->epoch.store(g_epoch.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+void rcu::threadOffline() {
+    assert(t_record != NULL);
+    // release：离线之前对旧版本的读都已经完成
+    t_record->epoch.store(kOffline, std::memory_order_release);
+}
+
+void rcu::threadOnline() {
+    assert(t_record != NULL);
+    // 上线之后的读不能被重排到上线之前，否则写者可能在我们看起来还离线时释放正在读的版本
+    t_record->epoch.store(g_epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+void rcu::synchronize() {
+    bool wasOnline = t_record != NULL && t_record->epoch.load(std::memory_order_relaxed) != kOffline;
+    if (wasOnline) {
+        threadOffline(); //否则会等待自己
+    }
+
+    uint64_t target = advanceEpoch();
+    for (;;) {
+        pthread_mutex_lock(&g_mutex);
+        uint64_t minEpoch = minOnlineEpoch();
+        pthread_mutex_unlock(&g_mutex);
+
+        if (minEpoch >= target) {
+            break;
+        }
+        // 读者通常一次事件循环内就会经过静止状态，不需要太积极地检查
+        ::usleep(100);
+    }
+
+    if (wasOnline) {
+        threadOnline();
+    }
+}
+
+void rcu::retire(const Callback& f) {
+    Retired r;
+    r.epoch = advanceEpoch();
+    r.callback = f;
+
+    pthread_mutex_lock(&g_mutex);
+    if (g_retired == NULL) {
+        g_retired = new std::vector<Retired>;
+    }
+    g_retired->push_back(r);
+    detail::g_pending.fetch_add(1, std::memory_order_relaxed);
+    pthread_mutex_unlock(&g_mutex);
+
+    reclaim();
+}
+
+size_t rcu::reclaim(bool tryLock) {
+    if (tryLock) {
+        if (pthread_mutex_trylock(&g_mutex) != 0) {
+            return 0;
+        }
+    } else {
+        pthread_mutex_lock(&g_mutex);
+    }
+
+    // 回调在锁外执行，回调里可以再调用retire
+    std::vector<Callback> ready;
+    if (g_retired != NULL && !g_retired->empty()) {
+        uint64_t minEpoch = minOnlineEpoch();
+        std::vector<Retired>::iterator keep = g_retired->begin();
+        for (std::vector<Retired>::iterator it = g_retired->begin(); it != g_retired->end(); ++it) {
+            if (it->epoch <= minEpoch) {
+                ready.push_back(it->callback);
+            } else {
+                *keep++ = *it;
+            }
+        }
+        g_retired->erase(keep, g_retired->end());
+        detail::g_pending.fetch_sub(ready.size(), std::memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&g_mutex);
+
+    for (size_t i = 0; i < ready.size(); ++i) {
+        ready[i]();
+    }
+    return ready.size();
+}
+
+size_t rcu::pendingCount() {
+    return detail::g_pending.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,123 @@
+#ifndef KAYCC_BASE_RCU_H
+#define KAYCC_BASE_RCU_H
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <atomic>
+#include <stddef.h>
+
+/*
+基于QSBR（quiescent-state-based reclamation）的RCU，用于路由表、配置这类读多写少的共享数据。
+读者直接读一个原子指针，不加锁、不修改任何共享的引用计数（wait-free）；
+写者发布新版本，旧版本要等所有读者都经过一次“静止状态”之后才释放。
+
+静止状态：读者手里不持有任何RCU保护的指针的时刻。
+    读者线程先registerThread()，之后在两次quiescentState()之间可以随意使用get()得到的指针，
+    但不能跨过quiescentState()/threadOffline()保存它。
+    线程长时间阻塞前调用threadOffline()，回来后调用threadOnline()，离线期间不会拖慢回收。
+EventLoop在每次poll前离线、poll返回后上线，所以IO线程的回调里可以直接使用RcuCell::get()，
+只要不把指针保存到下一次循环。其他线程读之前需要自己注册并定期报告静止状态，
+线程退出时会自动注销。没有注册的线程不能读。
+
+回收：
+    retire(f)        延迟执行f（通常是delete旧版本），不阻塞；
+                     由之后的retire/reclaim以及EventLoop在空闲时执行，所以f可能在IO线程里运行。
+    synchronize()    阻塞到当前所有读者都经过静止状态，之后可以直接释放旧版本。
+*/
+
+namespace kaycc {
+namespace rcu {
+
+    typedef boost::function<void()> Callback;
+
+    // 当前线程注册为读者（已注册则什么都不做），注册后处于在线状态
+    void registerThread();
+    void unregisterThread();
+    bool isRegistered();
+
+    // 报告一次静止状态，只是一次读和一次写
+    void quiescentState();
+
+    // 离线期间不持有任何RCU保护的指针，synchronize不会等待离线的线程
+    void threadOffline();
+    void threadOnline();
+
+    // 等待所有在线读者经过静止状态，调用线程如果在线会临时离线
+    void synchronize();
+
+    void retire(const Callback& f);
+
+    // 执行已经可以执行的retire回调，返回执行的个数；tryLock为true时拿不到锁就直接返回
+    size_t reclaim(bool tryLock = false);
+
+    // 还没执行的retire回调个数
+    size_t pendingCount();
+
+namespace detail {
+    extern std::atomic<size_t> g_pending;
+}
+
+    // 只有待回收的回调时才去拿锁，EventLoop每次循环调用一次
+    inline void reclaimIfPending() {
+        if (detail::g_pending.load(std::memory_order_relaxed) > 0) {
+            reclaim(true);
+        }
+    }
+
+} //end rcu
+
+    /*
+    保存一个不可变对象的指针。get()是wait-free的；update()发布新版本，旧版本通过rcu::retire延迟释放。
+    读-改-写（拷贝一份修改后再update）时，多个写者之间需要调用者自己加锁。
+    */
+    template <typename T>
+    class RcuCell : boost::noncopyable {
+    public:
+        explicit RcuCell(T* initial = NULL)
+            : ptr_(initial) {
+        }
+
+        // 析构时不应该还有读者
+        ~RcuCell() {
+            delete ptr_.load(std::memory_order_relaxed);
+        }
+
+        const T* get() const {
+            return ptr_.load(std::memory_order_acquire);
+        }
+
+        // 发布新版本，旧版本在所有读者经过静止状态后释放，不阻塞
+        void update(T* newValue) {
+            T* old = ptr_.exchange(newValue, std::memory_order_seq_cst);
+            if (old != NULL) {
+                rcu::retire(Deleter(old));
+            }
+        }
+
+        // 发布新版本，阻塞到旧版本没有读者后在当前线程释放
+        void updateSync(T* newValue) {
+            T* old = ptr_.exchange(newValue, std::memory_order_seq_cst);
+            if (old != NULL) {
+                rcu::synchronize();
+                delete old;
+            }
+        }
+
+    private:
+        struct Deleter {
+            explicit Deleter(T* p) : ptr(p) {}
+
+            void operator()() const {
+                delete ptr;
+            }
+
+            T* ptr;
+        };
+
+        std::atomic<T*> ptr_;
+    };
+
+}
+
+#endif
@@ -0,0 +1,90 @@
+#include "rwlock.h"
+
+#include <new>
+#include <sched.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace kaycc;
+
+namespace {
+    std::atomic<int> g_nextThreadIndex(0);
+    __thread int t_threadIndex = -1;
+
+    int threadIndex() {
+        if (__builtin_expect(t_threadIndex < 0, 0)) {
+            t_threadIndex = g_nextThreadIndex.fetch_add(1, std::memory_order_relaxed);
+        }
+        return t_threadIndex;
+    }
+}
+
+DistributedRwLock::DistributedRwLock()
+    : numSlots_(1),
+      slots_(NULL),
+      writerActive_(0) {
+    // 槽位数取不小于CPU个数的2的幂
+    long ncpu = ::sysconf(_SC_NPROCESSORS_CONF);
+    while (numSlots_ < ncpu) {
+        numSlots_ <<= 1;
+    }
+
+    void* mem = NULL;
+    if (::posix_memalign(&mem, kCacheLineSize, sizeof(Slot) * numSlots_) != 0) {
+        throw std::bad_alloc();
+    }
+
+    slots_ = static_cast<Slot*>(mem);
+    for (int i = 0; i < numSlots_; ++i) {
+        new (&slots_[i]) Slot;
+    }
+}
+
+DistributedRwLock::~DistributedRwLock() {
+    for (int i = 0; i < numSlots_; ++i) {
+        slots_[i].~Slot();
+    }
+    ::free(slots_);
+}
+
+DistributedRwLock::Slot& DistributedRwLock::mySlot() {
+    return slots_[threadIndex() & (numSlots_ - 1)];
+}
+
+void DistributedRwLock::readLock() {
+    Slot& slot = mySlot();
+    for (;;) {
+        slot.readers.fetch_add(1, std::memory_order_seq_cst);
+        if (__atomic_load_n(&writerActive_, __ATOMIC_SEQ_CST) == 0) {
+            return;
+        }
+
+        // 有写者，撤销并等待写者结束
+        slot.readers.fetch_sub(1, std::memory_order_seq_cst);
+        while (__atomic_load_n(&writerActive_, __ATOMIC_ACQUIRE) != 0) {
+            futex::wait(&writerActive_, 1);
+        }
+    }
+}
+
+void DistributedRwLock::readUnlock() {
+    mySlot().readers.fetch_sub(1, std::memory_order_release);
+}
+
+void DistributedRwLock::writeLock() {
+    writerMutex_.lock();
+    __atomic_store_n(&writerActive_, 1, __ATOMIC_SEQ_CST);
+
+    // 读者的临界区一般很短，等待时让出CPU
+    for (int i = 0; i < numSlots_; ++i) {
+        while (slots_[i].readers.load(std::memory_order_seq_cst) != 0) {
+            ::sched_yield();
+        }
+    }
+}
+
+void DistributedRwLock::writeUnlock() {
+    __atomic_store_n(&writerActive_, 0, __ATOMIC_RELEASE);
+    futex::wake(&writerActive_, INT32_MAX);
+    writerMutex_.unlock();
+}
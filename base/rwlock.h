@@ -0,0 +1,89 @@
+#ifndef KAYCC_BASE_RWLOCK_H
+#define KAYCC_BASE_RWLOCK_H
+
+#include "futex.h"
+#include "mutex.h"
+
+#include <boost/noncopyable.hpp>
+
+#include <atomic>
+#include <stdint.h>
+
+/*
+读多写少场景（比如路由表）的分布式读写锁。
+pthread_rwlock的读锁也要修改同一个计数，读线程多时这条cache line会在CPU之间来回传递。
+这里每个线程按编号落到一个独占cache line的槽位上，读锁只修改自己的槽位：
+    读：自己槽位的读者数加1，再检查有没有写者；有写者就撤销并等写者结束。
+    写：先拿写者互斥锁，置写者标志，再等所有槽位的读者数都变为0。
+读者和写者都是“先改自己的变量，再读对方的变量”，且都是seq_cst，所以不会同时进入。
+写锁的代价与槽位数成正比，只适合写很少的场景。读锁不可重入（写者等待时重入会死锁）。
+*/
+
+namespace kaycc {
+
+    class DistributedRwLock : boost::noncopyable {
+    public:
+        DistributedRwLock();
+        ~DistributedRwLock();
+
+        void readLock();
+        void readUnlock();
+
+        void writeLock();
+        void writeUnlock();
+
+    private:
+        static const size_t kCacheLineSize = 64;
+
+        struct Slot {
+            Slot() : readers(0) {}
+
+            std::atomic<int32_t> readers;
+            char pad[kCacheLineSize - sizeof(std::atomic<int32_t>)];
+        };
+
+        Slot& mySlot();
+
+        int numSlots_;
+        Slot* slots_;
+
+        MutexLock writerMutex_;          //写者之间互斥
+        volatile int32_t writerActive_;  //1表示有写者，读者在这个值上用futex等待
+    };
+
+    class ReadLockGuard : boost::noncopyable {
+    public:
+        explicit ReadLockGuard(DistributedRwLock& lock)
+            : lock_(lock) {
+            lock_.readLock();
+        }
+
+        ~ReadLockGuard() {
+            lock_.readUnlock();
+        }
+
+    private:
+        DistributedRwLock& lock_;
+    };
+
+    class WriteLockGuard : boost::noncopyable {
+    public:
+        explicit WriteLockGuard(DistributedRwLock& lock)
+            : lock_(lock) {
+            lock_.writeLock();
+        }
+
+        ~WriteLockGuard() {
+            lock_.writeUnlock();
+        }
+
+    private:
+        DistributedRwLock& lock_;
+    };
+
+}
+
+#define ReadLockGuard(x) error "Missing guard object name"
+#define WriteLockGuard(x) error "Missing guard object name"
+
+#endif
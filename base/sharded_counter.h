@@ -0,0 +1,131 @@
+#ifndef KAYCC_BASE_SHARDEDCOUNTER_H
+#define KAYCC_BASE_SHARDEDCOUNTER_H
+
+#include <boost/noncopyable.hpp>
+
+#include <atomic>
+#include <new>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*
+分片计数器，用于多个线程高频累加、偶尔读取的统计量（比如发送字节数）。
+一个AtomicInt64被所有线程同时fetch_add时，cache line会在CPU之间来回传递，线程越多越慢。
+这里把计数分散到多个各占一条cache line的槽位上，每个线程只改自己的槽位（relaxed），
+get()时把所有槽位加起来。读到的是近似的瞬时值，没有并发修改时是准确值。
+槽位的选择：
+    kPerThread  每个线程第一次使用时按顺序分配一个槽位，之后固定不变（默认）
+    kPerCpu     每次按当前所在的CPU选择槽位（sched_getcpu），线程数远多于CPU数时更好
+*/
+
+namespace kaycc {
+
+    class ShardedCounter : boost::noncopyable {
+    public:
+        enum ShardPolicy {
+            kPerThread,
+            kPerCpu,
+        };
+
+        // numShards为0时使用CPU个数，都会向上取整为2的幂
+        explicit ShardedCounter(ShardPolicy policy = kPerThread, int numShards = 0)
+            : policy_(policy),
+              numShards_(roundUpPowerOfTwo(numShards > 0 ? numShards : numCpus())),
+              slots_(NULL) {
+            void* mem = NULL;
+            if (::posix_memalign(&mem, kCacheLineSize, sizeof(Slot) * numShards_) != 0) {
+                throw std::bad_alloc();
+            }
+
+            slots_ = static_cast<Slot*>(mem);
+            for (int i = 0; i < numShards_; ++i) {
+                new (&slots_[i]) Slot;
+            }
+        }
+
+        ~ShardedCounter() {
+            for (int i = 0; i < numShards_; ++i) {
+                slots_[i].~Slot();
+            }
+            ::free(slots_);
+        }
+
+        void add(int64_t x) {
+            slots_[shardIndex()].value.fetch_add(x, std::memory_order_relaxed);
+        }
+
+        void increment() {
+            add(1);
+        }
+
+        // 合并所有槽位
+        int64_t get() const {
+            int64_t sum = 0;
+            for (int i = 0; i < numShards_; ++i) {
+                sum += slots_[i].value.load(std::memory_order_relaxed);
+            }
+            return sum;
+        }
+
+        // 与add并发时，reset期间的累加可能部分丢失
+        void reset() {
+            for (int i = 0; i < numShards_; ++i) {
+                slots_[i].value.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        int numShards() const {
+            return numShards_;
+        }
+
+    private:
+        static const size_t kCacheLineSize = 64;
+
+        struct Slot {
+            Slot() : value(0) {}
+
+            std::atomic<int64_t> value;
+            char pad[kCacheLineSize - sizeof(std::atomic<int64_t>)];
+        };
+
+        int shardIndex() const {
+            if (policy_ == kPerCpu) {
+                int cpu = ::sched_getcpu();
+                return (cpu < 0 ? 0 : cpu) & (numShards_ - 1);
+            }
+            return threadIndex() & (numShards_ - 1);
+        }
+
+        // 每个线程一个固定的编号，所有ShardedCounter共用
+        static int threadIndex() {
+            static std::atomic<int> nextIndex(0);
+            static __thread int t_index = -1;
+            if (__builtin_expect(t_index < 0, 0)) {
+                t_index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+            }
+            return t_index;
+        }
+
+        static int numCpus() {
+            long n = ::sysconf(_SC_NPROCESSORS_CONF);
+            return n > 0 ? static_cast<int>(n) : 1;
+        }
+
+        static int roundUpPowerOfTwo(int n) {
+            int p = 1;
+            while (p < n) {
+                p <<= 1;
+            }
+            return p;
+        }
+
+        const ShardPolicy policy_;
+        const int numShards_;
+        Slot* slots_;
+    };
+
+}
+
+#endif
@@ -0,0 +1,76 @@
+#include "strand.h"
+
+#include <boost/bind.hpp>
+
+using namespace kaycc;
+
+Strand::Strand(ThreadPool* pool)
+    : pool_(pool),
+      scheduled_(false) {
+
+}
+
+size_t Strand::pendingCount() const {
+    MutexLockGuard lock(mutex_);
+    return queue_.size();
+}
+
+void Strand::post(const TaskFunc& task) {
+    bool schedule = false;
+    {
+        MutexLockGuard lock(mutex_);
+        queue_.push_back(task);
+        if (!scheduled_) {
+            scheduled_ = true;
+            schedule = true;
+        }
+    }
+
+    // 在锁外提交，线程池没有线程时drain会在当前线程里直接执行
+    if (schedule) {
+        pool_->run(boost::bind(&Strand::drain, shared_from_this()));
+    }
+}
+
+bool Strand::tryPost(const TaskFunc& task) {
+    if (pool_->runsInline()) { //drain会在当前线程里直接执行，不能持有mutex_
+        post(task);
+        return true;
+    }
+
+    MutexLockGuard lock(mutex_);
+    if (!scheduled_) {
+        // 在锁内提交，失败时什么都没有改变；drain在工作线程里执行，会等这里放入task之后才拿到锁
+        if (!pool_->tryRun(boost::bind(&Strand::drain, shared_from_this()))) {
+            return false;
+        }
+        scheduled_ = true;
+    }
+    queue_.push_back(task);
+    return true;
+}
+
+void Strand::drain() {
+    for (;;) {
+        for (int i = 0; i < kMaxBatch; ++i) {
+            TaskFunc task;
+            {
+                MutexLockGuard lock(mutex_);
+                if (queue_.empty()) {
+                    scheduled_ = false;
+                    return;
+                }
+                task.swap(queue_.front());
+                queue_.pop_front();
+            }
+            task();
+        }
+
+        // 执行了kMaxBatch个任务还有剩余，让出线程，排到线程池队尾；
+        // 线程池满时不能在工作线程里阻塞等待，就继续在当前线程里执行。
+        // 线程池没有工作线程时tryRun会在这里直接调用drain，一层层递归下去，所以也继续循环
+        if (!pool_->runsInline() && pool_->tryRun(boost::bind(&Strand::drain, shared_from_this()))) {
+            return;
+        }
+    }
+}
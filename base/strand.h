@@ -0,0 +1,64 @@
+#ifndef KAYCC_BASE_STRAND_H
+#define KAYCC_BASE_STRAND_H
+
+#include "mutex.h"
+#include "threadpool.h"
+
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <deque>
+
+/*
+串行执行器（strand）。
+提交到同一个Strand的任务按提交顺序执行，并且任意时刻最多只有一个在执行，
+所以这些任务之间不需要再加锁；不同的Strand之间仍然可以在线程池的多个线程上并行。
+实现：Strand自己维护一个任务队列，有任务时只往线程池里放一个drain任务，
+drain依次执行队列里的任务，每次最多执行kMaxBatch个，之后如果还有剩余就重新排到线程池队尾，避免一个Strand长期占着线程
+（线程池没有工作线程或者已满时继续在当前线程里循环执行）。
+drain任务持有Strand的shared_ptr，所以Strand必须用create()创建。
+*/
+
+namespace kaycc {
+
+    class Strand : boost::noncopyable,
+                   public boost::enable_shared_from_this<Strand> {
+    public:
+        typedef ThreadPool::TaskFunc TaskFunc;
+
+        static boost::shared_ptr<Strand> create(ThreadPool* pool) {
+            return boost::shared_ptr<Strand>(new Strand(pool));
+        }
+
+        // 线程安全。线程池的队列有容量限制并且已满时会阻塞
+        void post(const TaskFunc& task);
+
+        // 线程安全，不阻塞，可以在IO线程里调用。需要把drain放入线程池、而线程池已满（或者已经stop）时
+        // 返回false，task不会进入队列，Strand的状态不变；已经安排了drain时总是成功
+        bool tryPost(const TaskFunc& task);
+
+        // 还没有执行的任务数
+        size_t pendingCount() const;
+
+        ThreadPool* pool() const {
+            return pool_;
+        }
+
+    private:
+        static const int kMaxBatch = 64;
+
+        explicit Strand(ThreadPool* pool);
+
+        void drain();
+
+        ThreadPool* pool_;
+        mutable MutexLock mutex_;
+        std::deque<TaskFunc> queue_;
+        bool scheduled_; //线程池里是否已经有（或者正在执行）这个Strand的drain任务
+    };
+
+}
+
+#endif
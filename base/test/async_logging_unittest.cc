@@ -0,0 +1,176 @@
+#include "../async_logging.h"
+#include "../log.h"
+#include "../log_file.h"
+#include "../thread.h"
+#include "../timestamp.h"
+
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <assert.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+
+// 1. LogFile按大小滚动
+// 2. 多线程通过LOG_INFO写入AsyncLogging，检查所有日志都落盘
+// 3. 后台写不过来（maxBuffers很小）时前端丢弃而不是阻塞，丢弃数 + 落盘数 == 写入数
+// 日志写在/tmp下的临时目录里，结束时删除
+
+const int kThreads = 4;
+const int kLinesPerThread = 50000;
+
+std::string g_dir;
+
+void logLines() {
+  for (int i = 0; i < kLinesPerThread; ++i) {
+    LOG_INFO << "async logging test line " << i << " padding padding padding padding" << std::endl;
+  }
+}
+
+// 统计目录下所有日志文件的行数和文件个数
+int countLines(int* files) {
+  int lines = 0;
+  *files = 0;
+  DIR* dir = ::opendir(g_dir.c_str());
+  assert(dir != NULL);
+  while (struct dirent* ent = ::readdir(dir)) {
+    if (ent->d_name[0] == '.') {
+      continue;
+    }
+    ++*files;
+    std::string path = g_dir + "/" + ent->d_name;
+    FILE* fp = ::fopen(path.c_str(), "r");
+    int c;
+    while ((c = ::getc(fp)) != EOF) {
+      if (c == '\n') {
+        ++lines;
+      }
+    }
+    ::fclose(fp);
+  }
+  ::closedir(dir);
+  return lines;
+}
+
+void removeLogs() {
+  DIR* dir = ::opendir(g_dir.c_str());
+  while (struct dirent* ent = ::readdir(dir)) {
+    if (ent->d_name[0] != '.') {
+      ::unlink((g_dir + "/" + ent->d_name).c_str());
+    }
+  }
+  ::closedir(dir);
+}
+
+double runWriters() {
+  boost::ptr_vector<kaycc::Thread> threads;
+  kaycc::Timestamp start(kaycc::Timestamp::now());
+  for (int i = 0; i < kThreads; ++i) {
+    threads.push_back(new kaycc::Thread(logLines));
+    threads.back().start();
+  }
+  for (int i = 0; i < kThreads; ++i) {
+    threads[i].join();
+  }
+  return kaycc::timeDifference(kaycc::Timestamp::now(), start);
+}
+
+void testRollAndComplete() {
+  const int64_t total = static_cast<int64_t>(kThreads) * kLinesPerThread;
+  int rollSize = 1024 * 1024;
+  {
+    kaycc::AsyncLogging log(g_dir + "/roll", rollSize, 1);
+    log.start();
+    kaycc::AsyncLogging::setAsLoggerOutput(&log);
+    double seconds = runWriters();
+    kaycc::AsyncLogging::setAsLoggerOutput(NULL);
+    log.stop();
+    printf("wrote %lld lines in %.3fs, %.0f ns/line, dropped %lld\n",
+           static_cast<long long>(total), seconds, seconds * 1e9 / static_cast<double>(total),
+           static_cast<long long>(log.droppedCount()));
+    assert(log.droppedCount() == 0);
+  }
+
+  int files = 0;
+  int lines = countLines(&files);
+  printf("%d lines in %d files\n", lines, files);
+  assert(lines == total);
+  removeLogs();
+}
+
+// 同一秒内不会重复滚动（文件名相同），所以这里隔一秒再写
+void testLogFileRoll() {
+  kaycc::LogFile file(g_dir + "/file", 1000);
+  char line[100];
+  memset(line, 'x', sizeof line);
+  line[sizeof line - 1] = '\n';
+  for (int i = 0; i < 20; ++i) {
+    file.append(line, sizeof line);
+  }
+  ::sleep(1);
+  file.append(line, sizeof line); //超过rollSize，换新文件
+  file.append(line, sizeof line);
+  file.flush();
+
+  int files = 0;
+  int lines = countLines(&files);
+  assert(lines == 22);
+  assert(files == 2);
+  assert(file.rollCount() == 2);
+  removeLogs();
+}
+
+void testDrop() {
+  const int64_t total = static_cast<int64_t>(kThreads) * kLinesPerThread;
+  int64_t dropped = 0;
+  {
+    // 只允许1块缓冲排队，前端写得足够快时必然丢弃
+    kaycc::AsyncLogging log(g_dir + "/drop", 1024 * 1024 * 1024, 1, 1);
+    log.start();
+    kaycc::AsyncLogging::setAsLoggerOutput(&log);
+    runWriters();
+    kaycc::AsyncLogging::setAsLoggerOutput(NULL);
+    log.stop();
+    dropped = log.droppedCount();
+  }
+
+  int files = 0;
+  int lines = countLines(&files);
+  // 后台线程会额外写几行“dropped N log messages”
+  int noteLines = lines - static_cast<int>(total - dropped);
+  printf("dropped %lld, wrote %d lines (%d drop notes)\n", static_cast<long long>(dropped), lines, noteLines);
+  assert(noteLines >= 0 && (noteLines > 0) == (dropped > 0));
+  removeLogs();
+}
+
+void testFlush() {
+  kaycc::AsyncLogging log(g_dir + "/flush", 1024 * 1024, 3);
+  log.start();
+  kaycc::AsyncLogging::setAsLoggerOutput(&log);
+  LOG_INFO << "flushed line" << std::endl;
+  log.flush(); //不用等flushInterval
+  int files = 0;
+  assert(countLines(&files) == 1);
+  kaycc::AsyncLogging::setAsLoggerOutput(NULL);
+  log.stop();
+  removeLogs();
+}
+
+int main() {
+  char tmpl[] = "/tmp/kaycc_async_logging_XXXXXX";
+  if (::mkdtemp(tmpl) == NULL) {
+    perror("mkdtemp");
+    return 1;
+  }
+  g_dir = tmpl;
+
+  testLogFileRoll();
+  testRollAndComplete();
+  testDrop();
+  testFlush();
+
+  ::rmdir(g_dir.c_str());
+  printf("done\n");
+}
@@ -0,0 +1,104 @@
+#include "../atomic.h"
+#include "../sharded_counter.h"
+#include "../thread.h"
+#include "../timestamp.h"
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <stdio.h>
+
+// 多线程同时累加一个计数器时的吞吐量：
+// seq_cst    AtomicInt64::increment
+// relaxed    AtomicInt64::incrementRelaxed
+// sharded    ShardedCounter::increment（按线程分片）
+// percpu     ShardedCounter::increment（按CPU分片）
+// 另外比较读计数：原来__sync_val_compare_and_swap实现的get()和现在的load
+
+const int kIterations = 5000000;
+
+kaycc::AtomicInt64 g_atomic;
+kaycc::ShardedCounter g_sharded(kaycc::ShardedCounter::kPerThread);
+kaycc::ShardedCounter g_perCpu(kaycc::ShardedCounter::kPerCpu);
+
+void incSeqCst() {
+  for (int i = 0; i < kIterations; ++i) {
+    g_atomic.increment();
+  }
+}
+
+void incRelaxed() {
+  for (int i = 0; i < kIterations; ++i) {
+    g_atomic.incrementRelaxed();
+  }
+}
+
+void incSharded() {
+  for (int i = 0; i < kIterations; ++i) {
+    g_sharded.increment();
+  }
+}
+
+void incPerCpu() {
+  for (int i = 0; i < kIterations; ++i) {
+    g_perCpu.increment();
+  }
+}
+
+volatile int64_t g_sink;
+int64_t g_plain;
+
+void readCas() {
+  for (int i = 0; i < kIterations; ++i) {
+    g_sink = __sync_val_compare_and_swap(&g_plain, 0, 0);
+  }
+}
+
+void readLoad() {
+  for (int i = 0; i < kIterations; ++i) {
+    g_sink = g_atomic.get();
+  }
+}
+
+// 返回每秒的操作数（所有线程合计）
+double bench(void (*func)(), int numThreads) {
+  boost::ptr_vector<kaycc::Thread> threads;
+  kaycc::Timestamp start(kaycc::Timestamp::now());
+  for (int i = 0; i < numThreads; ++i) {
+    threads.push_back(new kaycc::Thread(func));
+    threads.back().start();
+  }
+  for (int i = 0; i < numThreads; ++i) {
+    threads[i].join();
+  }
+  double seconds = kaycc::timeDifference(kaycc::Timestamp::now(), start);
+  return static_cast<double>(kIterations) * numThreads / seconds;
+}
+
+int main() {
+  const int threadCounts[] = {1, 2, 4, 8, 16};
+
+  printf("%-8s %14s %14s %14s %14s %14s %14s\n", "threads",
+         "seq_cst/s", "relaxed/s", "sharded/s", "percpu/s", "casRead/s", "loadRead/s");
+  for (size_t t = 0; t < sizeof(threadCounts) / sizeof(threadCounts[0]); ++t) {
+    int n = threadCounts[t];
+    g_atomic.set(0);
+    g_sharded.reset();
+    g_perCpu.reset();
+
+    double seqCst = bench(incSeqCst, n);
+    double relaxed = bench(incRelaxed, n);
+    double sharded = bench(incSharded, n);
+    double perCpu = bench(incPerCpu, n);
+    double casRead = bench(readCas, n);
+    double loadRead = bench(readLoad, n);
+
+    printf("%-8d %14.0f %14.0f %14.0f %14.0f %14.0f %14.0f\n", n,
+           seqCst, relaxed, sharded, perCpu, casRead, loadRead);
+
+    if (g_atomic.get() != 2LL * kIterations * n || g_sharded.get() != 1LL * kIterations * n
+        || g_perCpu.get() != 1LL * kIterations * n) {
+      printf("count mismatch\n");
+      return 1;
+    }
+  }
+}
@@ -0,0 +1,118 @@
+#include "../bounded_threadpool.h"
+#include "../atomic.h"
+#include "../count_down_latch.h"
+
+#include <boost/bind.hpp>
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+// 1. 多个线程同时提交，队列容量很小，所有任务都执行且只执行一次
+// 2. 队列满时tryRun返回false，run阻塞到有空位
+// 3. 没有工作线程时在调用线程里执行
+// 4. stop()之后run丢弃任务，tryRun返回false
+
+using namespace kaycc;
+
+AtomicInt32 g_count;
+
+void count() {
+    g_count.increment();
+}
+
+void submit(BoundedThreadPool* pool, int n) {
+    for (int i = 0; i < n; ++i) {
+        pool->run(count);
+    }
+}
+
+void testManyProducers() {
+    g_count.getAndSet(0);
+    BoundedThreadPool pool("Producers");
+    pool.setMaxQueueSize(4);
+    pool.start(3);
+
+    const int kProducers = 4;
+    const int kTasks = 50000;
+    boost::ptr_vector<Thread> producers;
+    for (int i = 0; i < kProducers; ++i) {
+        producers.push_back(new Thread(boost::bind(&submit, &pool, kTasks)));
+        producers.back().start();
+    }
+    for (int i = 0; i < kProducers; ++i) {
+        producers[i].join();
+    }
+
+    CountDownLatch latch(1);
+    pool.run(boost::bind(&CountDownLatch::countDown, &latch));
+    latch.wait();
+    pool.stop();
+    assert(g_count.get() == kProducers * kTasks);
+}
+
+void block(CountDownLatch* started, CountDownLatch* release) {
+    started->countDown();
+    release->wait();
+}
+
+void releaseLater(CountDownLatch* release) {
+    usleep(100 * 1000);
+    release->countDown();
+}
+
+void testFull() {
+    g_count.getAndSet(0);
+    BoundedThreadPool pool("Full");
+    pool.setMaxQueueSize(2);
+    pool.start(1);
+
+    CountDownLatch started(1);
+    CountDownLatch release(1);
+    pool.run(boost::bind(&block, &started, &release));
+    started.wait(); //唯一的工作线程被占住
+
+    assert(pool.tryRun(count));
+    assert(pool.tryRun(count));
+    assert(!pool.tryRun(count));
+    assert(pool.queueSize() == 2);
+
+    Thread releaser(boost::bind(&releaseLater, &release));
+    releaser.start();
+    pool.run(count); //阻塞到工作线程取走任务
+    releaser.join();
+
+    CountDownLatch latch(1);
+    pool.run(boost::bind(&CountDownLatch::countDown, &latch));
+    latch.wait();
+    assert(g_count.get() == 3);
+    pool.stop();
+}
+
+void testNoThreads() {
+    g_count.getAndSet(0);
+    BoundedThreadPool pool("Inline");
+    pool.start(0);
+    pool.run(count);
+    assert(pool.tryRun(count));
+    assert(g_count.get() == 2);
+    pool.stop();
+}
+
+void testAfterStop() {
+    g_count.getAndSet(0);
+    BoundedThreadPool pool("Stopped");
+    pool.start(2);
+    pool.stop();
+    pool.run(count); //记录错误日志，任务被丢弃
+    assert(!pool.tryRun(count));
+    assert(pool.queueSize() == 0);
+    assert(g_count.get() == 0);
+}
+
+int main() {
+    testManyProducers();
+    testFull();
+    testNoThreads();
+    testAfterStop();
+    printf("done\n");
+}
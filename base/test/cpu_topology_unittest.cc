@@ -0,0 +1,141 @@
+#include "../cpu_topology.h"
+#include "../count_down_latch.h"
+#include "../threadpool.h"
+
+#include <boost/bind.hpp>
+
+#include <string>
+#include <vector>
+
+#include <assert.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 1. parseCpuList
+// 2. 在临时目录里造一个sysfs：2个NUMA节点，每个节点2个物理核，每个核2个超线程，
+//    cpu0-3是各个核的第一个超线程，cpu4-7是第二个（和常见的x86服务器一样），检查拓扑和spread的结果
+// 3. 本机：绑定当前线程，ThreadPool的工作线程在指定的CPU上运行
+
+using namespace kaycc;
+
+void writeFile(const std::string& path, const std::string& content) {
+    FILE* fp = fopen(path.c_str(), "w");
+    assert(fp != NULL);
+    fputs(content.c_str(), fp);
+    fclose(fp);
+}
+
+void makeDir(const std::string& path) {
+    ::mkdir(path.c_str(), 0755);
+}
+
+std::string makeFakeSysfs() {
+    char root[] = "/tmp/cpu_topology_XXXXXX";
+    assert(mkdtemp(root) != NULL);
+    std::string dir(root);
+    makeDir(dir + "/cpu");
+    makeDir(dir + "/node");
+    writeFile(dir + "/cpu/online", "0-7\n");
+
+    for (int cpu = 0; cpu < 8; ++cpu) {
+        char buf[64];
+        snprintf(buf, sizeof buf, "/cpu/cpu%d", cpu);
+        std::string cpuDir = dir + buf;
+        makeDir(cpuDir);
+        makeDir(cpuDir + "/topology");
+        int core = cpu % 4;
+        snprintf(buf, sizeof buf, "%d\n", core / 2);
+        writeFile(cpuDir + "/topology/physical_package_id", buf);
+        snprintf(buf, sizeof buf, "%d\n", core % 2);
+        writeFile(cpuDir + "/topology/core_id", buf);
+    }
+
+    makeDir(dir + "/node/node0");
+    makeDir(dir + "/node/node1");
+    writeFile(dir + "/node/node0/cpulist", "0-1,4-5\n");
+    writeFile(dir + "/node/node1/cpulist", "2-3,6-7\n");
+    return dir;
+}
+
+void testParse() {
+    std::vector<int> cpus = CpuTopology::parseCpuList("0-3,8,10-11");
+    int expected[] = {0, 1, 2, 3, 8, 10, 11};
+    assert(cpus == std::vector<int>(expected, expected + 7));
+    assert(CpuTopology::parseCpuList("5") == std::vector<int>(1, 5));
+    assert(CpuTopology::parseCpuList("").empty());
+    assert(CpuTopology::parseCpuList("3-1").empty());
+    assert(CpuTopology::parseCpuList("a").empty());
+}
+
+void testFakeTopology() {
+    std::string root = makeFakeSysfs();
+    CpuTopology topology(root, false);
+    assert(topology.cpus().size() == 8);
+    assert(topology.numCores() == 4);
+    assert(topology.numNodes() == 2);
+    assert(topology.nodeOf(0) == 0 && topology.nodeOf(5) == 0);
+    assert(topology.nodeOf(2) == 1 && topology.nodeOf(7) == 1);
+    assert(topology.nodeOf(8) == -1);
+    assert(topology.cpus()[0].core == topology.cpus()[4].core);
+    assert(topology.cpus()[0].core != topology.cpus()[1].core);
+
+    // 先用4个物理核（节点交替），再用超线程，超过8个时循环
+    std::vector<int> spread = topology.spread(10);
+    int expected[] = {0, 2, 1, 3, 4, 6, 5, 7, 0, 2};
+    printf("spread:");
+    for (size_t i = 0; i < spread.size(); ++i) {
+        printf(" %d", spread[i]);
+    }
+    printf("\n");
+    assert(spread == std::vector<int>(expected, expected + 10));
+
+    std::string cmd = "rm -rf " + root;
+    int ret = system(cmd.c_str());
+    (void)ret;
+}
+
+void recordCpu(std::vector<int>* cpus, MutexLock* mutex, CountDownLatch* latch) {
+    {
+        MutexLockGuard lock(*mutex);
+        cpus->push_back(sched_getcpu());
+    }
+    latch->countDown();
+}
+
+void testLocalMachine() {
+    const CpuTopology& topology = CpuTopology::instance();
+    printf("local: %zu cpus, %d cores, %d nodes\n",
+           topology.cpus().size(), topology.numCores(), topology.numNodes());
+    assert(!topology.cpus().empty());
+
+    std::vector<int> spread = topology.spread(4);
+    assert(spread.size() == 4);
+    int cpu = spread[0];
+    assert(CpuTopology::bindCurrentThread(cpu));
+    assert(sched_getcpu() == cpu);
+
+    ThreadPool pool("PinnedPool");
+    pool.setCpuAffinity(std::vector<int>(1, cpu));
+    pool.start(2);
+    MutexLock mutex;
+    std::vector<int> cpus;
+    CountDownLatch latch(20);
+    for (int i = 0; i < 20; ++i) {
+        pool.run(boost::bind(&recordCpu, &cpus, &mutex, &latch));
+    }
+    latch.wait();
+    pool.stop();
+    for (size_t i = 0; i < cpus.size(); ++i) {
+        assert(cpus[i] == cpu);
+    }
+}
+
+int main() {
+    testParse();
+    testFakeTopology();
+    testLocalMachine();
+    printf("done\n");
+}
@@ -0,0 +1,114 @@
+#include "../int_hash_map.h"
+#include "../timestamp.h"
+
+#include <boost/shared_ptr.hpp>
+
+#include <map>
+#include <string>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// 1. 随机的插入、删除、查找，和std::map对比结果（包括删除时的backward shift）
+// 2. 值是shared_ptr时删除后不再持有引用
+// 3. 和std::map<std::string, ...>（原来TcpServer按连接名查找的方式）比较插入+查找+删除的耗时
+
+using namespace kaycc;
+
+void testRandom() {
+    IntHashMap<int> map;
+    std::map<uint64_t, int> ref;
+    srand(1);
+    for (int i = 0; i < 200000; ++i) {
+        uint64_t key = static_cast<uint64_t>(rand() % 5000) + 1;
+        int op = rand() % 3;
+        if (op == 0) {
+            bool inserted = map.insert(key, i);
+            assert(inserted == ref.insert(std::make_pair(key, i)).second);
+            (void)inserted;
+        } else if (op == 1) {
+            bool erased = map.erase(key);
+            assert(erased == (ref.erase(key) == 1));
+            (void)erased;
+        } else {
+            int* v = map.find(key);
+            std::map<uint64_t, int>::iterator it = ref.find(key);
+            assert((v == NULL) == (it == ref.end()));
+            assert(v == NULL || *v == it->second);
+        }
+        assert(map.size() == ref.size());
+    }
+
+    size_t count = 0;
+    map.forEach([&](uint64_t key, int value) {
+        assert(ref[key] == value);
+        ++count;
+    });
+    assert(count == ref.size());
+    printf("random: size %zu capacity %zu\n", map.size(), map.capacity());
+}
+
+void testSharedPtr() {
+    boost::shared_ptr<int> p(new int(1));
+    IntHashMap<boost::shared_ptr<int> > map;
+    for (uint64_t key = 1; key <= 100; ++key) {
+        map.insert(key, p);
+    }
+    assert(p.use_count() == 101);
+    for (uint64_t key = 1; key <= 50; ++key) {
+        map.erase(key);
+    }
+    assert(p.use_count() == 51);
+
+    IntHashMap<boost::shared_ptr<int> > other;
+    other.swap(map);
+    assert(map.empty() && other.size() == 50);
+    other.clear();
+    assert(p.use_count() == 1);
+}
+
+// 模拟连接表：一直保持kLive个连接，每次新连接插入、查找，最老的连接删除
+const int kLive = 10000;
+const int kOps = 1000000;
+
+double benchIntHashMap() {
+    IntHashMap<int> map;
+    Timestamp start(Timestamp::now());
+    for (uint64_t id = 1; id <= kOps; ++id) {
+        map.insert(id, 1);
+        assert(map.find(id) != NULL);
+        if (id > kLive) {
+            map.erase(id - kLive);
+        }
+    }
+    return timeDifference(Timestamp::now(), start);
+}
+
+double benchStringMap() {
+    std::map<std::string, int> map;
+    Timestamp start(Timestamp::now());
+    for (int id = 1; id <= kOps; ++id) {
+        char buf[64];
+        snprintf(buf, sizeof buf, "EchoServer-0.0.0.0:2000#%d", id);
+        std::string name(buf);
+        map[name] = 1;
+        assert(map.find(name) != map.end());
+        if (id > kLive) {
+            snprintf(buf, sizeof buf, "EchoServer-0.0.0.0:2000#%d", id - kLive);
+            map.erase(buf);
+        }
+    }
+    return timeDifference(Timestamp::now(), start);
+}
+
+int main() {
+    testRandom();
+    testSharedPtr();
+
+    double a = benchIntHashMap();
+    double b = benchStringMap();
+    printf("IntHashMap<uint64_t>      %.1f ns/op\n", a * 1e9 / kOps);
+    printf("std::map<std::string>     %.1f ns/op (including snprintf)\n", b * 1e9 / kOps);
+    printf("done\n");
+}
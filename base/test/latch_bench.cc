@@ -0,0 +1,103 @@
+#include "../count_down_latch.h"
+#include "../latch.h"
+#include "../thread.h"
+#include "../threadpool.h"
+#include "../timestamp.h"
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <pthread.h>
+#include <stdio.h>
+
+// CountDownLatch（MutexLock+Condition）与futex实现的Latch/Barrier对比：
+// 1. 没有等待者时countDown的开销
+// 2. fan-out/join：每轮往线程池投n个任务，各countDown一次，主线程wait
+// 3. 屏障：n个线程反复集合，与pthread_barrier_t比较
+
+const int kCountDowns = 10000000;
+const int kRounds = 20000;
+const int kBarrierRounds = 100000;
+
+template <typename LatchType>
+double benchCountDown() {
+  LatchType latch(kCountDowns);
+  kaycc::Timestamp start(kaycc::Timestamp::now());
+  for (int i = 0; i < kCountDowns; ++i) {
+    latch.countDown();
+  }
+  latch.wait();
+  return kCountDowns / kaycc::timeDifference(kaycc::Timestamp::now(), start);
+}
+
+template <typename LatchType>
+void countDownTask(LatchType* latch) {
+  latch->countDown();
+}
+
+template <typename LatchType>
+double benchFanOut(kaycc::ThreadPool& pool, int n) {
+  kaycc::Timestamp start(kaycc::Timestamp::now());
+  for (int r = 0; r < kRounds; ++r) {
+    LatchType latch(n);
+    for (int i = 0; i < n; ++i) {
+      pool.run(boost::bind(&countDownTask<LatchType>, &latch));
+    }
+    latch.wait();
+  }
+  return kRounds / kaycc::timeDifference(kaycc::Timestamp::now(), start);
+}
+
+kaycc::Barrier* g_barrier = NULL;
+pthread_barrier_t g_pthreadBarrier;
+
+void barrierThread() {
+  for (int i = 0; i < kBarrierRounds; ++i) {
+    g_barrier->arriveAndWait();
+  }
+}
+
+void pthreadBarrierThread() {
+  for (int i = 0; i < kBarrierRounds; ++i) {
+    pthread_barrier_wait(&g_pthreadBarrier);
+  }
+}
+
+double benchBarrier(void (*func)(), int n) {
+  boost::ptr_vector<kaycc::Thread> threads;
+  kaycc::Timestamp start(kaycc::Timestamp::now());
+  for (int i = 0; i < n; ++i) {
+    threads.push_back(new kaycc::Thread(func));
+    threads.back().start();
+  }
+  for (int i = 0; i < n; ++i) {
+    threads[i].join();
+  }
+  return kBarrierRounds / kaycc::timeDifference(kaycc::Timestamp::now(), start);
+}
+
+int main() {
+  printf("uncontended countDown/s  CountDownLatch %.0f  Latch %.0f\n",
+         benchCountDown<kaycc::CountDownLatch>(), benchCountDown<kaycc::Latch>());
+
+  const int threadCounts[] = {1, 2, 4, 8};
+  printf("\n%-8s %16s %16s %16s %16s\n", "threads", "fanOutCDL/s", "fanOutLatch/s", "pthreadBarrier/s", "barrier/s");
+  for (size_t t = 0; t < sizeof(threadCounts) / sizeof(threadCounts[0]); ++t) {
+    int n = threadCounts[t];
+
+    kaycc::ThreadPool pool("latch_bench");
+    pool.start(n);
+    double fanOutCdl = benchFanOut<kaycc::CountDownLatch>(pool, n);
+    double fanOutLatch = benchFanOut<kaycc::Latch>(pool, n);
+    pool.stop();
+
+    pthread_barrier_init(&g_pthreadBarrier, NULL, n);
+    double pthreadBarrier = benchBarrier(pthreadBarrierThread, n);
+    pthread_barrier_destroy(&g_pthreadBarrier);
+
+    kaycc::Barrier barrier(n);
+    g_barrier = &barrier;
+    double futexBarrier = benchBarrier(barrierThread, n);
+
+    printf("%-8d %16.0f %16.0f %16.0f %16.0f\n", n, fanOutCdl, fanOutLatch, pthreadBarrier, futexBarrier);
+  }
+}
@@ -0,0 +1,128 @@
+#include "../latch.h"
+#include "../atomic.h"
+#include "../thread.h"
+#include "../timestamp.h"
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+// 1. Barrier重复使用多轮：每轮恰好一个线程返回true，下一轮开始时上一轮的线程都已经到达
+// 2. OneShotEvent：超时返回false；set之前、等待过程中set都返回true，之后的wait立即返回
+// 3. Latch：计数已经为0时wait立即返回；多个线程一起等，计数减到0时全部放行
+
+using namespace kaycc;
+
+const int kThreads = 4;
+const int kRounds = 1000;
+
+Barrier g_barrier(kThreads);
+AtomicInt32 g_arrived;        //所有线程到达的总次数
+AtomicInt32 g_winners[kRounds]; //每轮返回true的线程数
+
+void barrierWorker() {
+    for (int round = 0; round < kRounds; ++round) {
+        g_arrived.increment();
+        if (g_barrier.arriveAndWait()) {
+            g_winners[round].increment();
+        }
+        // 放行时本轮所有线程都已经到达，下一轮还没有人能通过
+        assert(g_arrived.get() >= (round + 1) * kThreads);
+        assert(g_arrived.get() <= (round + 2) * kThreads);
+    }
+}
+
+void testBarrier() {
+    boost::ptr_vector<Thread> threads;
+    for (int i = 0; i < kThreads; ++i) {
+        threads.push_back(new Thread(&barrierWorker));
+        threads.back().start();
+    }
+    for (int i = 0; i < kThreads; ++i) {
+        threads[i].join();
+    }
+    for (int round = 0; round < kRounds; ++round) {
+        assert(g_winners[round].get() == 1);
+    }
+
+    Barrier single(1); //只有一个线程时每次都是最后一个到达
+    assert(single.arriveAndWait());
+    assert(single.arriveAndWait());
+}
+
+void setLater(OneShotEvent* event, int ms) {
+    usleep(ms * 1000);
+    event->set();
+}
+
+void testOneShotEvent() {
+    OneShotEvent timeout;
+    Timestamp start(Timestamp::monotonicNow());
+    assert(!timeout.waitForSeconds(0.05));
+    double elapsed = timeDifference(Timestamp::monotonicNow(), start);
+    assert(elapsed >= 0.05);
+    assert(!timeout.isSet());
+
+    OneShotEvent before;
+    before.set();
+    assert(before.isSet());
+    assert(before.waitForSeconds(0.0));
+    before.wait();
+
+    OneShotEvent during;
+    Thread setter(boost::bind(&setLater, &during, 50));
+    setter.start();
+    start = Timestamp::monotonicNow();
+    assert(during.waitForSeconds(10.0));
+    assert(timeDifference(Timestamp::monotonicNow(), start) < 5.0);
+    setter.join();
+    assert(during.isSet());
+    during.wait();
+    assert(during.waitForSeconds(0.0));
+}
+
+void waitLatch(Latch* latch, AtomicInt32* released) {
+    latch->wait();
+    released->increment();
+}
+
+void testLatch() {
+    Latch zero(0);
+    assert(zero.tryWait());
+    zero.wait();
+
+    Latch done(1);
+    done.countDown();
+    assert(done.getCount() == 0);
+    done.wait();
+
+    Latch latch(2);
+    AtomicInt32 released;
+    boost::ptr_vector<Thread> waiters;
+    for (int i = 0; i < kThreads; ++i) {
+        waiters.push_back(new Thread(boost::bind(&waitLatch, &latch, &released)));
+        waiters.back().start();
+    }
+    usleep(50 * 1000);
+    assert(released.get() == 0);
+    latch.countDown();
+    usleep(50 * 1000);
+    assert(released.get() == 0); //还差一次
+    assert(!latch.tryWait());
+    latch.countDown();
+    for (int i = 0; i < kThreads; ++i) {
+        waiters[i].join();
+    }
+    assert(released.get() == kThreads);
+    assert(latch.tryWait());
+}
+
+int main() {
+    testBarrier();
+    testOneShotEvent();
+    testLatch();
+    printf("done\n");
+}
@@ -0,0 +1,126 @@
+#include "../adaptive_mutex.h"
+#include "../lock_profiler.h"
+#include "../mutex.h"
+#include "../rwlock.h"
+#include "../thread.h"
+#include "../timestamp.h"
+
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <pthread.h>
+#include <stdio.h>
+
+// 多线程抢同一把锁、临界区很短时的吞吐量：
+// mutex      MutexLock
+// adaptive   AdaptiveMutex
+// rwRead     pthread_rwlock读锁（读多写少，每1000次读一次写）
+// distRead   DistributedRwLock读锁（同上）
+// 最后打开LockProfiler再跑一遍MutexLock，打印竞争报告
+
+const int kIterations = 1000000;
+const int kWriteEvery = 1000;
+
+kaycc::MutexLock g_mutex;
+kaycc::AdaptiveMutex g_adaptive;
+pthread_rwlock_t g_rwlock = PTHREAD_RWLOCK_INITIALIZER;
+kaycc::DistributedRwLock g_distLock;
+
+int64_t g_counter = 0;
+int64_t g_table[16]; //模拟路由表，写者修改所有项，读者检查它们一致
+
+volatile bool g_inconsistent = false;
+
+void lockMutex() {
+  for (int i = 0; i < kIterations; ++i) {
+    kaycc::MutexLockGuard lock(g_mutex);
+    ++g_counter;
+  }
+}
+
+void lockAdaptive() {
+  for (int i = 0; i < kIterations; ++i) {
+    kaycc::AdaptiveMutexGuard lock(g_adaptive);
+    ++g_counter;
+  }
+}
+
+void checkTable() {
+  for (int j = 1; j < 16; ++j) {
+    if (g_table[j] != g_table[0]) {
+      g_inconsistent = true;
+    }
+  }
+}
+
+void updateTable() {
+  for (int j = 0; j < 16; ++j) {
+    ++g_table[j];
+  }
+}
+
+void readPthreadRwlock() {
+  for (int i = 0; i < kIterations; ++i) {
+    if (i % kWriteEvery == 0) {
+      pthread_rwlock_wrlock(&g_rwlock);
+      updateTable();
+      pthread_rwlock_unlock(&g_rwlock);
+    } else {
+      pthread_rwlock_rdlock(&g_rwlock);
+      checkTable();
+      pthread_rwlock_unlock(&g_rwlock);
+    }
+  }
+}
+
+void readDistLock() {
+  for (int i = 0; i < kIterations; ++i) {
+    if (i % kWriteEvery == 0) {
+      kaycc::WriteLockGuard lock(g_distLock);
+      updateTable();
+    } else {
+      kaycc::ReadLockGuard lock(g_distLock);
+      checkTable();
+    }
+  }
+}
+
+// 返回每秒的加锁次数（所有线程合计）
+double bench(void (*func)(), int numThreads) {
+  boost::ptr_vector<kaycc::Thread> threads;
+  kaycc::Timestamp start(kaycc::Timestamp::now());
+  for (int i = 0; i < numThreads; ++i) {
+    threads.push_back(new kaycc::Thread(func));
+    threads.back().start();
+  }
+  for (int i = 0; i < numThreads; ++i) {
+    threads[i].join();
+  }
+  double seconds = kaycc::timeDifference(kaycc::Timestamp::now(), start);
+  return static_cast<double>(kIterations) * numThreads / seconds;
+}
+
+int main() {
+  const int threadCounts[] = {1, 2, 4, 8};
+
+  printf("%-8s %14s %14s %14s %14s\n", "threads", "mutex/s", "adaptive/s", "rwRead/s", "distRead/s");
+  for (size_t t = 0; t < sizeof(threadCounts) / sizeof(threadCounts[0]); ++t) {
+    int n = threadCounts[t];
+    g_counter = 0;
+
+    double mutex = bench(lockMutex, n);
+    double adaptive = bench(lockAdaptive, n);
+    double rwRead = bench(readPthreadRwlock, n);
+    double distRead = bench(readDistLock, n);
+
+    printf("%-8d %14.0f %14.0f %14.0f %14.0f\n", n, mutex, adaptive, rwRead, distRead);
+
+    if (g_counter != 2LL * kIterations * n || g_inconsistent) {
+      printf("lock is broken\n");
+      return 1;
+    }
+  }
+
+  g_mutex.setName("lock_bench:g_mutex");
+  kaycc::LockProfiler::setEnabled(true);
+  bench(lockMutex, 4);
+  printf("\n%s", kaycc::LockProfiler::report().c_str());
+}
@@ -0,0 +1,141 @@
+#include "../adaptive_mutex.h"
+#include "../atomic.h"
+#include "../lock_profiler.h"
+#include "../mutex.h"
+#include "../rwlock.h"
+#include "../thread.h"
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <vector>
+
+#include <assert.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+
+// 1. AdaptiveMutex：多个线程对同一个普通变量做非原子的加法，并检查临界区里同时只有一个线程
+// 2. DistributedRwLock：写者持锁时没有读者也没有别的写者，读者看到的表总是一致的
+// 3. LockProfiler：同一把锁在不同位置加锁时分别统计
+
+using namespace kaycc;
+
+const int kThreads = 4;
+const int kIterations = 200000;
+
+AdaptiveMutex g_adaptive;
+int64_t g_counter = 0;     // @GuardedBy g_adaptive
+AtomicInt32 g_inside;
+
+void adaptiveWorker() {
+    for (int i = 0; i < kIterations; ++i) {
+        AdaptiveMutexGuard lock(g_adaptive);
+        assert(g_inside.incrementAndGet() == 1);
+        int64_t value = g_counter;
+        if (i % 64 == 0) {
+            sched_yield(); //持锁时让出CPU，让其他线程走到futex休眠的路径
+        }
+        g_counter = value + 1;
+        g_inside.decrement();
+    }
+}
+
+void testAdaptiveMutex() {
+    boost::ptr_vector<Thread> threads;
+    for (int i = 0; i < kThreads; ++i) {
+        threads.push_back(new Thread(&adaptiveWorker));
+        threads.back().start();
+    }
+    for (int i = 0; i < kThreads; ++i) {
+        threads[i].join();
+    }
+    assert(g_counter == static_cast<int64_t>(kThreads) * kIterations);
+    assert(g_adaptive.tryLock());
+    assert(!g_adaptive.tryLock());
+    g_adaptive.unlock();
+}
+
+DistributedRwLock g_rwlock;
+const int kTableSize = 16;
+int64_t g_table[kTableSize]; // @GuardedBy g_rwlock
+AtomicInt32 g_readers;
+AtomicInt32 g_writers;
+
+void reader() {
+    for (int i = 0; i < kIterations; ++i) {
+        ReadLockGuard lock(g_rwlock);
+        g_readers.increment();
+        assert(g_writers.get() == 0);
+        for (int j = 1; j < kTableSize; ++j) {
+            assert(g_table[j] == g_table[0]);
+        }
+        g_readers.decrement();
+    }
+}
+
+void writer(int rounds) {
+    for (int i = 0; i < rounds; ++i) {
+        WriteLockGuard lock(g_rwlock);
+        assert(g_writers.incrementAndGet() == 1);
+        assert(g_readers.get() == 0);
+        for (int j = 0; j < kTableSize; ++j) {
+            ++g_table[j];
+            if (j == kTableSize / 2) {
+                sched_yield(); //写到一半让出CPU，读者这时不能进入
+            }
+        }
+        g_writers.decrement();
+    }
+}
+
+void testDistributedRwLock() {
+    const int kWriteRounds = 2000;
+    boost::ptr_vector<Thread> threads;
+    for (int i = 0; i < kThreads; ++i) {
+        threads.push_back(new Thread(&reader));
+        threads.back().start();
+    }
+    for (int i = 0; i < 2; ++i) {
+        threads.push_back(new Thread(boost::bind(&writer, kWriteRounds)));
+        threads.back().start();
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+    for (int j = 0; j < kTableSize; ++j) {
+        assert(g_table[j] == 2 * kWriteRounds);
+    }
+}
+
+void testProfilerSites() {
+    LockProfiler::setEnabled(true);
+    MutexLock mutex;
+    mutex.setName("LockUnittest");
+    for (int i = 0; i < 3; ++i) {
+        MutexLockGuard lock(mutex);
+    }
+    {
+        MutexLockGuard lock(mutex);
+    }
+    LockProfiler::setEnabled(false);
+
+    std::vector<LockProfiler::Snapshot> stats = LockProfiler::snapshot();
+    std::vector<int64_t> counts;
+    for (size_t i = 0; i < stats.size(); ++i) {
+        if (stats[i].name == "LockUnittest" && stats[i].acquisitions > 0) {
+            assert(strstr(stats[i].site.c_str(), "lock_unittest.cc:") != NULL);
+            counts.push_back(stats[i].acquisitions);
+        }
+    }
+    assert(counts.size() == 2);
+    assert((counts[0] == 3 && counts[1] == 1) || (counts[0] == 1 && counts[1] == 3));
+    printf("%s", LockProfiler::report().c_str());
+}
+
+int main() {
+    testAdaptiveMutex();
+    testDistributedRwLock();
+    testProfilerSites();
+    printf("done\n");
+}
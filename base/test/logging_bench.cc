@@ -0,0 +1,153 @@
+#include "../async_logging.h"
+#include "../binary_logging.h"
+#include "../log.h"
+#include "../thread.h"
+#include "../timestamp.h"
+
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <assert.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+
+// 每条日志在调用线程上花费的时间（纳秒）：
+// text     LOG_INFO  -> AsyncLogging（ostream格式化 + 拷贝进共享缓冲）
+// binary   BLOG_INFO -> BinaryLogging（只拷贝参数的原始字节进线程自己的环形缓冲，后台线程格式化）
+// 两种都是同样的一条消息：一个字符串、两个整数、一个浮点数。
+// 另外检查二进制日志格式化出来的文本是否正确。
+
+const int kLinesPerThread = 200000;
+
+std::string g_dir;
+std::string g_connName("127.0.0.1:2007#42");
+
+void textLines() {
+  for (int i = 0; i < kLinesPerThread; ++i) {
+    LOG_INFO << "conn " << g_connName << " recv " << i << " bytes, total " << i * 3
+             << " in " << 0.125 * i << " ms" << std::endl;
+  }
+}
+
+void binaryLines() {
+  for (int i = 0; i < kLinesPerThread; ++i) {
+    BLOG_INFO("conn %s recv %d bytes, total %lld in %g ms", g_connName, i, static_cast<long long>(i) * 3, 0.125 * i);
+  }
+}
+
+double runThreads(void (*func)(), int numThreads) {
+  boost::ptr_vector<kaycc::Thread> threads;
+  kaycc::Timestamp start(kaycc::Timestamp::now());
+  for (int i = 0; i < numThreads; ++i) {
+    threads.push_back(new kaycc::Thread(func));
+    threads.back().start();
+  }
+  for (int i = 0; i < numThreads; ++i) {
+    threads[i].join();
+  }
+  double seconds = kaycc::timeDifference(kaycc::Timestamp::now(), start);
+  // 每个线程上每条日志的平均耗时
+  return seconds * 1e9 / kLinesPerThread;
+}
+
+// 读出目录下所有日志文件的内容，然后删除
+std::string readAndRemoveLogs() {
+  std::string content;
+  DIR* dir = ::opendir(g_dir.c_str());
+  while (struct dirent* ent = ::readdir(dir)) {
+    if (ent->d_name[0] == '.') {
+      continue;
+    }
+    std::string path = g_dir + "/" + ent->d_name;
+    FILE* fp = ::fopen(path.c_str(), "r");
+    char buf[65536];
+    size_t n;
+    while ((n = ::fread(buf, 1, sizeof buf, fp)) > 0) {
+      content.append(buf, n);
+    }
+    ::fclose(fp);
+    ::unlink(path.c_str());
+  }
+  ::closedir(dir);
+  return content;
+}
+
+size_t countLines(const std::string& s) {
+  size_t n = 0;
+  for (size_t i = 0; i < s.size(); ++i) {
+    if (s[i] == '\n') {
+      ++n;
+    }
+  }
+  return n;
+}
+
+void testBinaryFormat() {
+  kaycc::BinaryLogging log(g_dir + "/format", 1024 * 1024 * 1024);
+  log.start();
+  int value = 42;
+  BLOG_INFO("x=%d s=%s d=%.2f p=%5.1f%% u=%lu hex=%x str=%s", value, "abc", 3.14159, 99.5,
+            static_cast<unsigned long>(7), 255, std::string("std"));
+  BLOG_WARN("no args");
+  BLOG_INFO("missing %d %d", 1);
+  log.flush();
+  log.stop();
+
+  std::string content = readAndRemoveLogs();
+  printf("%s", content.c_str());
+  assert(content.find("x=42 s=abc d=3.14 p= 99.5% u=7 hex=ff str=std\n") != std::string::npos);
+  assert(content.find("WARN  logging_bench.cc:") != std::string::npos);
+  assert(content.find("no args\n") != std::string::npos);
+  assert(content.find("missing 1 <missing>\n") != std::string::npos);
+}
+
+int main(int argc, char* argv[]) {
+  char tmpl[] = "/tmp/kaycc_logging_bench_XXXXXX";
+  if (::mkdtemp(tmpl) == NULL) {
+    perror("mkdtemp");
+    return 1;
+  }
+  g_dir = tmpl;
+
+  testBinaryFormat();
+
+  int maxThreads = argc > 1 ? atoi(argv[1]) : 4;
+  printf("\n%-8s %14s %14s %12s %12s\n", "threads", "text(ns)", "binary(ns)", "textDrop", "binaryDrop");
+  for (int n = 1; n <= maxThreads; n *= 2) {
+    const size_t total = static_cast<size_t>(n) * kLinesPerThread;
+
+    double textNs = 0;
+    int64_t textDropped = 0;
+    {
+      kaycc::AsyncLogging log(g_dir + "/text", 1024 * 1024 * 1024);
+      log.start();
+      kaycc::AsyncLogging::setAsLoggerOutput(&log);
+      textNs = runThreads(textLines, n);
+      kaycc::AsyncLogging::setAsLoggerOutput(NULL);
+      log.stop();
+      textDropped = log.droppedCount();
+    }
+    std::string text = readAndRemoveLogs();
+    assert(countLines(text) >= total - static_cast<size_t>(textDropped));
+
+    double binaryNs = 0;
+    int64_t binaryDropped = 0;
+    {
+      int64_t droppedBefore = kaycc::BinaryLogging::droppedCount();
+      kaycc::BinaryLogging log(g_dir + "/binary", 1024 * 1024 * 1024);
+      log.start();
+      binaryNs = runThreads(binaryLines, n);
+      log.stop();
+      binaryDropped = kaycc::BinaryLogging::droppedCount() - droppedBefore;
+    }
+    std::string binary = readAndRemoveLogs();
+    assert(countLines(binary) == total - static_cast<size_t>(binaryDropped));
+
+    printf("%-8d %14.1f %14.1f %12lld %12lld\n", n, textNs, binaryNs,
+           static_cast<long long>(textDropped), static_cast<long long>(binaryDropped));
+  }
+
+  ::rmdir(g_dir.c_str());
+}
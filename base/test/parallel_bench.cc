@@ -0,0 +1,94 @@
+#include "../parallel.h"
+#include "../timestamp.h"
+
+#include <boost/bind.hpp>
+#include <math.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <vector>
+
+// parallelFor/parallelReduce从1个核到N个核的扩展性
+// 模拟对一批候选向量打分：每个候选是kDim维的float向量，与query做点积
+
+const size_t kDim = 128;
+const size_t kCandidates = 200000;
+const int kRounds = 5;
+
+std::vector<float> g_query(kDim);
+std::vector<float> g_candidates(kDim * kCandidates);
+std::vector<float> g_scores(kCandidates);
+
+float dot(size_t index) {
+  const float* v = &g_candidates[index * kDim];
+  float sum = 0;
+  for (size_t d = 0; d < kDim; ++d) {
+    sum += v[d] * g_query[d];
+  }
+  return sum;
+}
+
+void scoreRange(size_t begin, size_t end) {
+  for (size_t i = begin; i < end; ++i) {
+    g_scores[i] = dot(i);
+  }
+}
+
+double sumRange(size_t begin, size_t end) {
+  double sum = 0;
+  for (size_t i = begin; i < end; ++i) {
+    sum += sqrt(static_cast<double>(dot(i)) * dot(i));
+  }
+  return sum;
+}
+
+double add(double a, double b) {
+  return a + b;
+}
+
+int main() {
+  for (size_t d = 0; d < kDim; ++d) {
+    g_query[d] = static_cast<float>(d % 7) - 3.0f;
+  }
+  for (size_t i = 0; i < g_candidates.size(); ++i) {
+    g_candidates[i] = static_cast<float>(i % 13) * 0.25f;
+  }
+
+  long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  printf("cpus=%ld candidates=%zu dim=%zu\n", ncpu, kCandidates, kDim);
+  printf("%-8s %14s %14s %14s\n", "cores", "for(ms)", "reduce(ms)", "speedup");
+
+  // 1, 2, 4, ...，最后一项是全部核数
+  std::vector<long> coreCounts;
+  for (long cores = 1; cores < ncpu; cores *= 2) {
+    coreCounts.push_back(cores);
+  }
+  coreCounts.push_back(ncpu);
+
+  double base = 0;
+  for (size_t c = 0; c < coreCounts.size(); ++c) {
+    long cores = coreCounts[c];
+    // 调用线程也参与计算，所以线程池里只需要cores - 1个线程
+    kaycc::ThreadPool pool("parallel");
+    pool.start(static_cast<int>(cores - 1));
+
+    kaycc::Timestamp start(kaycc::Timestamp::now());
+    for (int r = 0; r < kRounds; ++r) {
+      kaycc::parallelFor(pool, 0, kCandidates, scoreRange);
+    }
+    double forMs = kaycc::timeDifference(kaycc::Timestamp::now(), start) * 1000 / kRounds;
+
+    start = kaycc::Timestamp::now();
+    double total = 0;
+    for (int r = 0; r < kRounds; ++r) {
+      total = kaycc::parallelReduce(pool, 0, kCandidates, 0.0, sumRange, add);
+    }
+    double reduceMs = kaycc::timeDifference(kaycc::Timestamp::now(), start) * 1000 / kRounds;
+
+    if (cores == 1) {
+      base = forMs + reduceMs;
+    }
+    printf("%-8ld %14.2f %14.2f %14.2f   (sum=%.0f)\n", cores, forMs, reduceMs, base / (forMs + reduceMs), total);
+
+    pool.stop();
+  }
+}
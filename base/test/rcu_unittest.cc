@@ -0,0 +1,107 @@
+#include "../rcu.h"
+#include "../mutex.h"
+#include "../thread.h"
+#include "../timestamp.h"
+
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/shared_ptr.hpp>
+#include <assert.h>
+#include <stdio.h>
+
+// 读者不停读RcuCell里的“路由表”，写者不停发布新版本并retire旧版本。
+// 旧版本析构时把magic改掉，读者如果读到已经释放的版本就会发现。
+// 最后和MutexLock保护的shared_ptr比较读的吞吐量。
+
+const int kMagic = 0x5a5a5a5a;
+const int kReaders = 4;
+const int kReads = 2000000;
+const int kUpdates = 2000;
+
+struct Table {
+  explicit Table(int v) : magic(kMagic), version(v) {
+    for (int i = 0; i < 8; ++i) {
+      routes[i] = v;
+    }
+  }
+
+  ~Table() {
+    magic = 0;
+  }
+
+  volatile int magic;
+  int version;
+  int routes[8];
+};
+
+kaycc::RcuCell<Table> g_table(new Table(0));
+volatile bool g_stop = false;
+
+kaycc::MutexLock g_mutex;
+boost::shared_ptr<Table> g_sharedTable(new Table(0));
+
+void rcuReader() {
+  kaycc::rcu::registerThread();
+  int lastVersion = 0;
+  for (int i = 0; i < kReads; ++i) {
+    const Table* t = g_table.get();
+    assert(t->magic == kMagic);
+    assert(t->version >= lastVersion);
+    for (int j = 0; j < 8; ++j) {
+      assert(t->routes[j] == t->version);
+    }
+    lastVersion = t->version;
+
+    if (i % 64 == 0) {
+      kaycc::rcu::quiescentState();
+    }
+  }
+  // 线程退出时自动注销
+}
+
+void rcuWriter() {
+  for (int v = 1; v <= kUpdates; ++v) {
+    g_table.update(new Table(v));
+  }
+  g_table.updateSync(new Table(kUpdates + 1));
+}
+
+void mutexReader() {
+  for (int i = 0; i < kReads; ++i) {
+    boost::shared_ptr<Table> t;
+    {
+      kaycc::MutexLockGuard lock(g_mutex);
+      t = g_sharedTable;
+    }
+    assert(t->magic == kMagic);
+  }
+}
+
+double runReaders(void (*reader)(), void (*writer)()) {
+  boost::ptr_vector<kaycc::Thread> threads;
+  kaycc::Timestamp start(kaycc::Timestamp::now());
+  for (int i = 0; i < kReaders; ++i) {
+    threads.push_back(new kaycc::Thread(reader));
+    threads.back().start();
+  }
+  if (writer) {
+    threads.push_back(new kaycc::Thread(writer));
+    threads.back().start();
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+  return static_cast<double>(kReads) * kReaders / kaycc::timeDifference(kaycc::Timestamp::now(), start);
+}
+
+int main() {
+  double rcuReads = runReaders(rcuReader, rcuWriter);
+
+  // 读者都已退出，剩下的旧版本都可以回收
+  kaycc::rcu::reclaim();
+  assert(kaycc::rcu::pendingCount() == 0);
+  assert(g_table.get()->version == kUpdates + 1);
+
+  double mutexReads = runReaders(mutexReader, NULL);
+
+  printf("readers=%d  rcu %.0f reads/s  mutex+shared_ptr %.0f reads/s\n", kReaders, rcuReads, mutexReads);
+}
@@ -0,0 +1,154 @@
+#include "../strand.h"
+#include "../atomic.h"
+#include "../count_down_latch.h"
+#include "../thread.h"
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <vector>
+
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+// 1. 多个线程同时往多个Strand提交带序号的任务：同一个Strand的任务不会并发执行，
+//    每个提交线程的任务按提交顺序执行，所有任务都执行了
+// 2. 没有工作线程的线程池：任务在提交线程里执行，任务里再提交大量任务也不会递归
+// 3. tryPost：线程池已满时返回false，任务不进入队列；drain已经安排时总是成功
+
+using namespace kaycc;
+
+const int kStrands = 8;
+const int kProducers = 4;
+const int kTasksPerProducer = 20000;
+
+struct Checker {
+    Checker()
+        : last(kProducers, -1),
+          executed(0) {
+    }
+
+    AtomicInt32 inside;     //正在执行的任务数，必须不超过1
+    std::vector<int> last;  //每个提交线程最后执行的序号，只在Strand里访问
+    int executed;           //只在Strand里访问
+};
+
+void check(Checker* checker, int producer, int seq) {
+    assert(checker->inside.incrementAndGet() == 1);
+    assert(checker->last[producer] == seq - 1);
+    checker->last[producer] = seq;
+    ++checker->executed;
+    checker->inside.decrement();
+}
+
+void produce(std::vector<boost::shared_ptr<Strand> >* strands, Checker* checkers, int producer) {
+    for (int seq = 0; seq < kTasksPerProducer; ++seq) {
+        for (int i = 0; i < kStrands; ++i) {
+            (*strands)[i]->post(boost::bind(&check, &checkers[i], producer, seq));
+        }
+    }
+}
+
+void testOrdering() {
+    ThreadPool pool("StrandPool");
+    pool.setMaxQueueSize(16);
+    pool.start(4);
+
+    std::vector<boost::shared_ptr<Strand> > strands;
+    Checker checkers[kStrands];
+    for (int i = 0; i < kStrands; ++i) {
+        strands.push_back(Strand::create(&pool));
+    }
+
+    boost::ptr_vector<Thread> producers;
+    for (int i = 0; i < kProducers; ++i) {
+        producers.push_back(new Thread(boost::bind(&produce, &strands, checkers, i)));
+        producers.back().start();
+    }
+    for (int i = 0; i < kProducers; ++i) {
+        producers[i].join();
+    }
+
+    for (int i = 0; i < kStrands; ++i) { //每个Strand最后一个任务执行完，前面的也都执行完了
+        CountDownLatch latch(1);
+        strands[i]->post(boost::bind(&CountDownLatch::countDown, &latch));
+        latch.wait();
+        assert(checkers[i].executed == kProducers * kTasksPerProducer);
+        for (int p = 0; p < kProducers; ++p) {
+            assert(checkers[i].last[p] == kTasksPerProducer - 1);
+        }
+    }
+    pool.stop();
+}
+
+void postMany(Strand* strand, int* count, int n) {
+    for (int i = 0; i < n; ++i) {
+        strand->post(boost::bind(&postMany, strand, count, 0));
+    }
+    ++*count;
+}
+
+void testInline() {
+    ThreadPool pool("InlinePool");
+    pool.start(0);
+    boost::shared_ptr<Strand> strand = Strand::create(&pool);
+
+    // drain每kMaxBatch个任务让出一次，没有工作线程时要在循环里继续，而不是递归
+    const int kTasks = 1000000;
+    int count = 0;
+    strand->post(boost::bind(&postMany, strand.get(), &count, kTasks));
+    assert(count == kTasks + 1);
+    assert(strand->pendingCount() == 0);
+    assert(strand->tryPost(boost::bind(&postMany, strand.get(), &count, 0)));
+    assert(count == kTasks + 2);
+}
+
+void block(CountDownLatch* started, CountDownLatch* release) {
+    started->countDown();
+    release->wait();
+}
+
+void increment(AtomicInt32* count) {
+    count->increment();
+}
+
+void testTryPost() {
+    ThreadPool pool("FullPool");
+    pool.setMaxQueueSize(1);
+    pool.start(1);
+
+    CountDownLatch started(1);
+    CountDownLatch release(1);
+    pool.run(boost::bind(&block, &started, &release));
+    started.wait();
+
+    AtomicInt32 count;
+    boost::shared_ptr<Strand> a = Strand::create(&pool);
+    boost::shared_ptr<Strand> b = Strand::create(&pool);
+    assert(a->tryPost(boost::bind(&increment, &count))); //a的drain占了唯一的空位
+    assert(a->tryPost(boost::bind(&increment, &count))); //a的drain已经在排队
+    assert(!b->tryPost(boost::bind(&increment, &count)));
+    assert(b->pendingCount() == 0);
+    assert(a->pendingCount() == 2);
+
+    release.countDown();
+    CountDownLatch latch(1);
+    pool.run(boost::bind(&CountDownLatch::countDown, &latch));
+    latch.wait();
+    assert(count.get() == 2);
+
+    assert(b->tryPost(boost::bind(&increment, &count))); //有空位了
+    CountDownLatch latch2(1);
+    b->post(boost::bind(&CountDownLatch::countDown, &latch2));
+    latch2.wait();
+    assert(count.get() == 3);
+    pool.stop();
+}
+
+int main() {
+    testOrdering();
+    testInline();
+    testTryPost();
+    printf("done\n");
+}
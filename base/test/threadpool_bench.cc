@@ -0,0 +1,122 @@
+#include "../threadpool.h"
+#include "../work_stealing_threadpool.h"
+#include "../bounded_threadpool.h"
+#include "../atomic.h"
+#include "../count_down_latch.h"
+#include "../timestamp.h"
+
+#include <boost/bind.hpp>
+#include <stdio.h>
+
+// ThreadPool与WorkStealingThreadPool的吞吐量对比
+// external: 主线程提交所有任务
+// nested:   主线程只提交少量根任务，每个任务在工作线程内再提交子任务
+// bounded:  同external，三种线程池的队列容量都限制为kQueueSize
+
+const int kTasks = 200000;
+const int kFanout = 8;
+const int kQueueSize = 4096;
+
+kaycc::AtomicInt32 g_remaining;
+kaycc::CountDownLatch* g_done = NULL;
+
+void spin(int work) {
+  volatile int x = 0;
+  for (int i = 0; i < work; ++i) {
+    x = x + i;
+  }
+}
+
+void finishOne() {
+  if (g_remaining.decrementAndGet() == 0) {
+    g_done->countDown();
+  }
+}
+
+void leafTask(int work) {
+  spin(work);
+  finishOne();
+}
+
+template <typename Pool>
+void nestedTask(Pool* pool, int depth, int work) {
+  spin(work);
+  if (depth > 0) {
+    for (int i = 0; i < kFanout; ++i) {
+      pool->run(boost::bind(&nestedTask<Pool>, pool, depth - 1, work));
+    }
+  }
+  finishOne();
+}
+
+template <typename Pool>
+double benchExternal(int threads, int work, int maxQueueSize = 0) {
+  Pool pool("bench");
+  pool.setMaxQueueSize(maxQueueSize);
+  pool.start(threads);
+
+  kaycc::CountDownLatch done(1);
+  g_done = &done;
+  g_remaining.getAndSet(kTasks);
+
+  kaycc::Timestamp start(kaycc::Timestamp::now());
+  for (int i = 0; i < kTasks; ++i) {
+    pool.run(boost::bind(leafTask, work));
+  }
+  done.wait();
+  double seconds = kaycc::timeDifference(kaycc::Timestamp::now(), start);
+
+  pool.stop();
+  return kTasks / seconds;
+}
+
+template <typename Pool>
+double benchNested(int threads, int work) {
+  Pool pool("bench");
+  pool.start(threads);
+
+  // 每个根任务生成 1 + 8 + 64 + 512 + 4096 个任务
+  const int kDepth = 4;
+  const int kRoots = 32;
+  int perRoot = 0;
+  for (int d = 0, n = 1; d <= kDepth; ++d, n *= kFanout) {
+    perRoot += n;
+  }
+
+  kaycc::CountDownLatch done(1);
+  g_done = &done;
+  g_remaining.getAndSet(kRoots * perRoot);
+
+  kaycc::Timestamp start(kaycc::Timestamp::now());
+  for (int i = 0; i < kRoots; ++i) {
+    pool.run(boost::bind(&nestedTask<Pool>, &pool, kDepth, work));
+  }
+  done.wait();
+  double seconds = kaycc::timeDifference(kaycc::Timestamp::now(), start);
+
+  pool.stop();
+  return kRoots * perRoot / seconds;
+}
+
+int main() {
+  const int threadCounts[] = {1, 4, 8, 16, 32};
+  const int works[] = {0, 100, 1000, 10000};
+
+  printf("%-8s %-8s %-8s %16s %16s %16s\n", "mode", "threads", "work", "ThreadPool/s", "WorkStealing/s", "Bounded/s");
+  for (size_t w = 0; w < sizeof(works) / sizeof(works[0]); ++w) {
+    for (size_t t = 0; t < sizeof(threadCounts) / sizeof(threadCounts[0]); ++t) {
+      int threads = threadCounts[t];
+      int work = works[w];
+      printf("%-8s %-8d %-8d %16.0f %16.0f %16s\n", "external", threads, work,
+             benchExternal<kaycc::ThreadPool>(threads, work),
+             benchExternal<kaycc::WorkStealingThreadPool>(threads, work), "-");
+      printf("%-8s %-8d %-8d %16.0f %16.0f %16s\n", "nested", threads, work,
+             benchNested<kaycc::ThreadPool>(threads, work),
+             benchNested<kaycc::WorkStealingThreadPool>(threads, work), "-");
+      printf("%-8s %-8d %-8d %16.0f %16.0f %16.0f\n", "bounded", threads, work,
+             benchExternal<kaycc::ThreadPool>(threads, work, kQueueSize),
+             benchExternal<kaycc::WorkStealingThreadPool>(threads, work, kQueueSize),
+             benchExternal<kaycc::BoundedThreadPool>(threads, work, kQueueSize));
+    }
+  }
+}
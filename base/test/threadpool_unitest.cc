@@ -1,8 +1,10 @@
 #include "../threadpool.h"
+#include "../atomic.h"
 #include "../count_down_latch.h"
 #include "../current_thread.h"
 
 #include <boost/bind.hpp>
+#include <assert.h>
 #include <stdio.h>
 #include <unistd.h>  // usleep
 #include <iostream>
@@ -40,9 +42,243 @@ void test(int maxSize) {
   pool.stop();
 }
 
+int square(int x) {
+  return x * x;
+}
+
+std::string describe(const int& x) {
+  char buf[32];
+  snprintf(buf, sizeof buf, "result %d", x);
+  return buf;
+}
+
+void testSubmit() {
+  std::cout << "Test ThreadPool submit/runBatch" << std::endl;
+  kaycc::ThreadPool pool("SubmitThreadPool");
+  pool.setMaxQueueSize(4);
+  pool.start(3);
+
+  kaycc::Future<int> f = pool.submit(boost::bind(square, 12));
+  assert(f.get() == 144);
+
+  kaycc::Future<std::string> s = f.then(describe);
+  std::cout << s.get() << std::endl;
+
+  std::vector<kaycc::ThreadPool::TaskFunc> tasks;
+  for (int i = 0; i < 20; ++i) {
+    tasks.push_back(print);
+  }
+  pool.runBatch(tasks);
+
+  pool.submit(print).wait();
+  pool.stop();
+}
+
+void blockOn(kaycc::CountDownLatch* started, kaycc::CountDownLatch* release) {
+  started->countDown();
+  release->wait();
+}
+
+void releaseLater(kaycc::CountDownLatch* release) {
+  usleep(100*1000);
+  release->countDown();
+}
+
+// stop()时还在排队的任务被丢弃，它们的Future变为broken，串联的Future也是
+void testFutureOnStop() {
+  std::cout << "Test Future on stop" << std::endl;
+  kaycc::ThreadPool pool("StopThreadPool");
+  pool.start(1);
+
+  kaycc::CountDownLatch started(1);
+  kaycc::CountDownLatch release(1);
+  pool.run(boost::bind(blockOn, &started, &release));
+  started.wait(); //唯一的线程被占住，后面的任务都在排队
+
+  kaycc::Future<int> f = pool.submit(boost::bind(square, 3));
+  kaycc::Future<std::string> s = f.then(describe);
+  kaycc::Future<void> v = pool.submit(print);
+
+  // 超时按截止时间计算，不会提前返回
+  kaycc::Timestamp begin(kaycc::Timestamp::monotonicNow());
+  assert(!f.waitForSeconds(0.05));
+  assert(kaycc::timeDifference(kaycc::Timestamp::monotonicNow(), begin) >= 0.05);
+
+  kaycc::Thread releaser(boost::bind(releaseLater, &release));
+  releaser.start();
+  pool.stop(); //等待被占住的线程执行完，队列里的任务被丢弃
+  releaser.join();
+
+  assert(f.waitForSeconds(1.0));
+  assert(f.broken() && !f.ready());
+  assert(s.broken());
+  assert(v.broken());
+  bool thrown = false;
+  try {
+    f.get();
+  } catch (const kaycc::BrokenPromise&) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  // stop之后提交的任务也被丢弃
+  assert(!pool.tryRun(print));
+  assert(pool.submit(boost::bind(square, 4)).broken());
+}
+
+void recordTid(int* tid, kaycc::CountDownLatch* latch) {
+  *tid = kaycc::currentthread::tid();
+  latch->countDown();
+}
+
+void storeTid(kaycc::AtomicInt32* tid) {
+  tid->getAndSet(kaycc::currentthread::tid());
+}
+
+// 弹性模式可以从0个线程开始，任务不在调用线程里执行
+void testElasticFromZero() {
+  std::cout << "Test elastic ThreadPool with min threads = 0" << std::endl;
+  kaycc::ThreadPool pool("ElasticZero");
+  pool.setMaxThreads(2);
+  pool.setKeepAlive(0.05);
+  pool.start(0);
+  assert(pool.numThreads() == 0);
+
+  for (int round = 0; round < 2; ++round) {
+    int tid = 0;
+    kaycc::CountDownLatch latch(1);
+    pool.run(boost::bind(recordTid, &tid, &latch));
+    latch.wait();
+    assert(tid != kaycc::currentthread::tid());
+    assert(pool.numThreads() >= 1);
+
+    usleep(200*1000); //空闲超过keepAlive，线程全部退休，下一轮重新创建
+    assert(pool.numThreads() == 0);
+  }
+  pool.stop();
+}
+
+// 唯一的线程卡在长任务里，之后没有新的提交，排队的任务也要在新线程里执行
+void testStuckWorker() {
+  std::cout << "Test elastic ThreadPool with a stuck worker" << std::endl;
+  kaycc::ThreadPool pool("ElasticStuck");
+  pool.setMaxThreads(2);
+  pool.setSpawnThreshold(0.01);
+  pool.start(1);
+
+  kaycc::CountDownLatch started(1);
+  kaycc::CountDownLatch release(1);
+  pool.run(boost::bind(blockOn, &started, &release));
+  started.wait();
+
+  kaycc::AtomicInt32 tid;
+  pool.run(boost::bind(storeTid, &tid));
+  kaycc::Timestamp begin(kaycc::Timestamp::monotonicNow());
+  while (tid.get() == 0 && kaycc::timeDifference(kaycc::Timestamp::monotonicNow(), begin) < 1.0) {
+    usleep(1000);
+  }
+  assert(tid.get() != 0); //没有等到长任务结束
+  assert(pool.numThreads() == 2);
+
+  release.countDown();
+  pool.stop();
+}
+
+kaycc::MutexLock g_laneMutex;
+std::vector<int> g_laneOrder; // @GuardedBy g_laneMutex
+
+void recordLane(int lane) {
+  kaycc::MutexLockGuard lock(g_laneMutex);
+  g_laneOrder.push_back(lane);
+}
+
+void onExpired(kaycc::AtomicInt32* expiredLane, const kaycc::ThreadPool::TaskFunc&, int lane) {
+  expiredLane->getAndSet(lane + 1);
+}
+
+// 通道按权重平滑加权轮询出队；过期的任务交给回调；排队时间计入直方图
+void testLanes() {
+  std::cout << "Test ThreadPool lanes" << std::endl;
+  kaycc::ThreadPool pool("LaneThreadPool");
+  std::vector<int> weights;
+  weights.push_back(1);
+  weights.push_back(3);
+  pool.setLaneWeights(weights);
+  kaycc::AtomicInt32 expiredLane;
+  pool.setExpiredTaskCallback(boost::bind(onExpired, &expiredLane, _1, _2));
+  pool.start(1);
+
+  // 1. 权重{1, 3}时每4个任务的出队顺序是1, 0, 1, 1
+  {
+    kaycc::CountDownLatch started(1);
+    kaycc::CountDownLatch release(1);
+    pool.run(boost::bind(blockOn, &started, &release));
+    started.wait();
+    for (int i = 0; i < 4; ++i) {
+      pool.run(boost::bind(recordLane, 0), 0);
+    }
+    std::vector<kaycc::ThreadPool::TaskFunc> tasks(12, boost::bind(recordLane, 1));
+    pool.runBatch(tasks, 1);
+    usleep(20*1000); //排队约20ms
+    release.countDown();
+
+    kaycc::CountDownLatch latch(1);
+    pool.run(boost::bind(&kaycc::CountDownLatch::countDown, &latch));
+    latch.wait();
+
+    int expected[] = {1, 0, 1, 1};
+    kaycc::MutexLockGuard lock(g_laneMutex);
+    assert(g_laneOrder.size() == 16);
+    for (size_t i = 0; i < g_laneOrder.size(); ++i) {
+      assert(g_laneOrder[i] == expected[i % 4]);
+    }
+  }
+
+  // 2. 直方图：通道1的12个任务都排队了20ms以上，在[2^14, 2^15)微秒或者更大的桶里
+  {
+    kaycc::ThreadPool::LaneStats stats = pool.laneStats(1);
+    assert(stats.executed == 12);
+    int64_t total = 0;
+    int64_t slow = 0;
+    for (size_t i = 0; i < stats.waitHistogram.size(); ++i) {
+      total += stats.waitHistogram[i];
+      if (i >= 15) {
+        slow += stats.waitHistogram[i];
+      }
+    }
+    assert(total == stats.executed);
+    assert(slow == 12);
+  }
+
+  // 3. 截止时间：排队超过10ms的任务不执行，队列随之变空时也要立即交给回调
+  {
+    kaycc::CountDownLatch started(1);
+    kaycc::CountDownLatch release(1);
+    pool.run(boost::bind(blockOn, &started, &release));
+    started.wait();
+    pool.run(boost::bind(recordLane, 1), 1, 0.01);
+    usleep(30*1000);
+    release.countDown();
+
+    kaycc::Timestamp begin(kaycc::Timestamp::monotonicNow());
+    while (expiredLane.get() == 0 && kaycc::timeDifference(kaycc::Timestamp::monotonicNow(), begin) < 1.0) {
+      usleep(1000);
+    }
+    assert(expiredLane.get() == 2); //lane 1
+    assert(pool.laneStats(1).expired == 1);
+    assert(pool.laneStats(1).executed == 12);
+  }
+  pool.stop();
+}
+
 int main() {
   test(0);
   test(1);
+  testSubmit();
+  testFutureOnStop();
+  testElasticFromZero();
+  testStuckWorker();
+  testLanes();
  // test(5);
  // test(10);
   //test(50);
@@ -0,0 +1,172 @@
+#include "../work_stealing_threadpool.h"
+#include "../atomic.h"
+#include "../count_down_latch.h"
+#include "../thread.h"
+
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+// 1. 工作线程内递归提交任务，所有任务都执行且只执行一次
+// 2. setMaxQueueSize：外部线程提交时队列满了会阻塞，工作线程内提交不受限制
+// 3. 还有任务排队时stop()：正常返回，阻塞在提交上的外部线程被放行，没执行的任务随线程池析构
+
+using namespace kaycc;
+
+WorkStealingThreadPool* g_pool = NULL;
+AtomicInt32 g_executed;
+
+void count() {
+    g_executed.increment();
+}
+
+const int kDepth = 14;
+CountDownLatch* g_treeDone = NULL;
+AtomicInt32 g_treeRemaining;
+
+// 每个任务提交两个子任务，共2^(kDepth+1)-1个
+void tree(int depth) {
+    g_executed.increment();
+    if (depth < kDepth) {
+        g_pool->run(boost::bind(&tree, depth + 1));
+        g_pool->run(boost::bind(&tree, depth + 1));
+    }
+    if (g_treeRemaining.decrementAndGet() == 0) {
+        g_treeDone->countDown();
+    }
+}
+
+void testNested() {
+    g_executed.getAndSet(0);
+    WorkStealingThreadPool pool("Nested");
+    pool.setMaxQueueSize(8); //工作线程内提交不受限制，否则会死锁
+    pool.start(4);
+    g_pool = &pool;
+
+    const int kTotal = (1 << (kDepth + 1)) - 1;
+    g_treeRemaining.getAndSet(kTotal);
+    CountDownLatch done(1);
+    g_treeDone = &done;
+    pool.run(boost::bind(&tree, 0));
+    done.wait();
+    pool.stop();
+    assert(g_executed.get() == kTotal);
+    assert(pool.queueSize() == 0);
+}
+
+const int kNested = 32;
+
+// 两个工作线程都进来之后再各自提交kNested个任务，这时没有线程能取走它们
+void blockAndSubmit(CountDownLatch* inside, CountDownLatch* submitted, CountDownLatch* release) {
+    inside->countDown();
+    inside->wait();
+    for (int i = 0; i < kNested; ++i) {
+        g_pool->run(count);
+    }
+    submitted->countDown();
+    release->wait();
+}
+
+void submitOne(WorkStealingThreadPool* pool, AtomicInt32* returned) {
+    pool->run(count);
+    returned->increment();
+}
+
+void testBounded() {
+    g_executed.getAndSet(0);
+    const int kMaxQueueSize = 4;
+    WorkStealingThreadPool pool("Bounded");
+    pool.setMaxQueueSize(kMaxQueueSize);
+    pool.start(2);
+    g_pool = &pool;
+
+    CountDownLatch inside(2);
+    CountDownLatch submitted(2);
+    CountDownLatch release(1);
+    pool.run(boost::bind(&blockAndSubmit, &inside, &submitted, &release));
+    pool.run(boost::bind(&blockAndSubmit, &inside, &submitted, &release));
+    submitted.wait();
+    assert(pool.queueSize() == 2 * kNested); //超过了容量，工作线程没有被阻塞
+
+    AtomicInt32 returned;
+    Thread submitter(boost::bind(&submitOne, &pool, &returned));
+    submitter.start();
+    usleep(100 * 1000);
+    assert(returned.get() == 0); //外部提交者要等到有空位
+    assert(pool.queueSize() == 2 * kNested);
+
+    release.countDown();
+    submitter.join();
+    assert(returned.get() == 1);
+
+    while (g_executed.get() < 2 * kNested + 1) {
+        usleep(1000);
+    }
+    pool.stop();
+    assert(g_executed.get() == 2 * kNested + 1);
+}
+
+void block(CountDownLatch* started, CountDownLatch* release) {
+    started->countDown();
+    release->wait();
+}
+
+void track(const boost::shared_ptr<int>&) {
+    g_executed.increment();
+}
+
+void releaseLater(CountDownLatch* release) {
+    usleep(100 * 1000);
+    release->countDown();
+}
+
+void submitTracked(WorkStealingThreadPool* pool, boost::shared_ptr<int> tracker, AtomicInt32* returned) {
+    pool->run(boost::bind(&track, tracker));
+    returned->increment();
+}
+
+void testStopWithQueuedTasks() {
+    g_executed.getAndSet(0);
+    const int kQueued = 4;
+    boost::shared_ptr<int> tracker(new int(0));
+    AtomicInt32 returned;
+    {
+        WorkStealingThreadPool pool("Stop");
+        pool.setMaxQueueSize(kQueued);
+        pool.start(1);
+
+        CountDownLatch started(1);
+        CountDownLatch release(1);
+        pool.run(boost::bind(&block, &started, &release));
+        started.wait();
+        for (int i = 0; i < kQueued; ++i) {
+            pool.run(boost::bind(&track, tracker));
+        }
+        assert(pool.queueSize() == kQueued);
+
+        Thread submitter(boost::bind(&submitTracked, &pool, tracker, &returned));
+        submitter.start();
+        Thread releaser(boost::bind(&releaseLater, &release));
+        releaser.start();
+        usleep(20 * 1000);
+        assert(returned.get() == 0);
+
+        pool.stop(); //唯一的工作线程执行完当前任务后退出，排队的任务不再执行
+        submitter.join();
+        releaser.join();
+        assert(returned.get() == 1);
+        assert(g_executed.get() < kQueued + 1);
+        assert(tracker.use_count() > 1);
+    }
+    assert(tracker.use_count() == 1); //没执行的任务随线程池一起析构
+}
+
+int main() {
+    testNested();
+    testBounded();
+    testStopWithQueuedTasks();
+    printf("done\n");
+}
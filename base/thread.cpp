@@ -55,10 +55,10 @@ namespace detail {
 		ThreadFunc func_;
 		std::string name_;
 		pid_t * tid_;
-		CountDownLatch *latch_;
+		Latch *latch_;
 
 		ThreadData(const ThreadFunc &func, const std::string &name, 
-				pid_t *tid, CountDownLatch *latch)
+				pid_t *tid, Latch *latch)
 			: func_(func),
 			  name_(name),
 			  tid_(tid),
@@ -142,8 +142,8 @@ Thread::Thread(ThreadFunc&& func, const std::string& n)
 	: started_(false),
 	  joined_(false),
 	  pthreadId_(0),
-	  tid(0),
-	  func(std::move(func)),
+	  tid_(0),
+	  func_(std::move(func)),
 	  name_(n),
 	  latch_(1) {
 		  setDefaultName();
@@ -2,7 +2,7 @@
 #define KAYCC_BASE_THREAD_H
 
 #include "atomic.h"
-#include "count_down_latch.h"
+#include "latch.h"
 
 #include <boost/function.hpp>
 #include <boost/noncopyable.hpp>
@@ -52,7 +52,7 @@ namespace kaycc {
 			pid_t tid_;
 			ThreadFunc func_;
 			std::string name_;
-			CountDownLatch latch_;
+			Latch latch_;
 
 			static AtomicInt32 numCreated_;
 	};
@@ -1,8 +1,11 @@
 #include "threadpool.h"
 
 #include <boost/bind.hpp>
+#include <algorithm>
 #include <assert.h>
 #include <stdio.h>
+#include "cpu_topology.h"
+#include "current_thread.h"
 #include "log.h"
 
 using namespace kaycc;
@@ -11,9 +14,24 @@ ThreadPool::ThreadPool(const std::string& name)
     : mutex_(),
       notEmpty_(mutex_), 
       notFull_(mutex_),
+      monitorCond_(mutex_),
       name_(name),
+      queuedTasks_(0),
       maxQueueSize_(0),
-      running_(false) {
+      running_(false),
+      lowWaterMark_(0),
+      saturated_(false),
+      peakQueueSize_(0),
+      minThreads_(0),
+      maxThreads_(0),
+      spawnThreshold_(0.01),
+      keepAlive_(60.0),
+      liveThreads_(0),
+      idleThreads_(0),
+      nextThreadId_(0),
+      pinned_(false) {
+    lanes_.push_back(new Lane(1));
+    mutex_.setName("ThreadPool:" + name_);
 
 }
 
@@ -26,20 +44,30 @@ ThreadPool::~ThreadPool() {
 void ThreadPool::start(int numThreads) {
     assert(threads_.empty());
     running_ = true;
-    threads_.reserve(numThreads);
+    minThreads_ = numThreads;
+    threads_.reserve(std::max(numThreads, maxThreads_));
+    if (pinned_ && cpus_.empty()) {
+        cpus_ = CpuTopology::instance().spread(std::max(numThreads, maxThreads_));
+    }
+    cpuThreads_.assign(cpus_.size(), 0);
 
     //numThreads个线程可以看作numThreads个消费者
     for (int i = 0; i < numThreads; ++i) {
-        char id[32];
-        snprintf(id, sizeof(id), "%d", i+1);
+        int id = 0;
+        int cpuSlot = -1;
+        {
+            MutexLockGuard lock(mutex_);
+            reserveThread(&id, &cpuSlot);
+        }
+        startThread(id, cpuSlot);
+    }
 
-        //runInThread是线程池里的线程回调函数，可看作线程处理函数，该回调在线处理函数中调用
-        threads_.push_back(new kaycc::Thread(
-            boost::bind(&ThreadPool::runInThread, this), name_ + id));
-        threads_[i].start();
+    if (isElastic()) {
+        monitor_.reset(new kaycc::Thread(boost::bind(&ThreadPool::monitorInThread, this), name_ + "Monitor"));
+        monitor_->start();
     }
 
-    if (numThreads == 0 && threadInitCallback_) { //如果线程池里的线程为0，若设置了threadInitCallback_，就调用threadInitCallback_
+    if (runsInline() && threadInitCallback_) { //如果线程池里的线程为0，若设置了threadInitCallback_，就调用threadInitCallback_
         threadInitCallback_();
     }
 }
@@ -48,97 +76,437 @@ void ThreadPool::start(int numThreads) {
 void ThreadPool::stop() {
     {
         MutexLockGuard lock(mutex_);
-        running_ = false; //running_置为false
+        running_ = false; //running_置为false，之后不会再创建新线程
         notEmpty_.notifyAll();//通知takeTask，如果此时有线程等待，就从队列里取走一个任务，执行完毕后，退出线程
+        notFull_.notifyAll(); //在队列满时等待的run()返回，任务被丢弃
+        monitorCond_.notifyAll();
+    }
+
+    if (monitor_) { //先停监视线程，之后不会再有新线程加入threads_
+        monitor_->join();
+        monitor_.reset();
     }
 
-    //等待线程退出
+    //等待线程退出，已经退休但还没回收的线程也在threads_里
     for_each(threads_.begin(), threads_.end(),
         boost::bind(&kaycc::Thread::join, _1)); //_1为占位，这里调用时传kayc::Thread对象
+
+    // 还在排队的任务不再执行，在锁外销毁，submit返回的Future随之变为broken（get()抛出BrokenPromise）
+    std::vector<QueuedTask> dropped;
+    {
+        MutexLockGuard lock(mutex_);
+        for (size_t i = 0; i < lanes_.size(); ++i) {
+            std::deque<QueuedTask>& tasks = lanes_[i].tasks;
+            dropped.insert(dropped.end(), tasks.begin(), tasks.end());
+            tasks.clear();
+        }
+        queuedTasks_ = 0;
+    }
+
+    if (!dropped.empty()) {
+        LOG_WARN << "ThreadPool " << name_ << " stopped, " << dropped.size() << " queued tasks discarded" << std::endl;
+    }
+}
+
+// 必须持有mutex_。先占住线程数、编号和CPU，再在锁外startThread
+void ThreadPool::reserveThread(int* id, int* cpuSlot) {
+    mutex_.assertLockByThisThread();
+    *id = ++nextThreadId_;
+    ++liveThreads_;
+
+    // 用线程最少的CPU，退休线程空出来的CPU优先给新线程
+    *cpuSlot = -1;
+    if (!cpus_.empty()) {
+        *cpuSlot = static_cast<int>(std::min_element(cpuThreads_.begin(), cpuThreads_.end()) - cpuThreads_.begin());
+        ++cpuThreads_[*cpuSlot];
+    }
+}
+
+// 不能持有mutex_：Thread::start要等新线程跑起来才返回。只在start和监视线程里调用
+void ThreadPool::startThread(int id, int cpuSlot) {
+    char name[32];
+    snprintf(name, sizeof(name), "%d", id);
+
+    //runInThread是线程池里的线程回调函数，可看作线程处理函数，该回调在线处理函数中调用
+    threads_.push_back(new kaycc::Thread(
+        boost::bind(&ThreadPool::runInThread, this, cpuSlot), name_ + name));
+    threads_.back().start();
+}
+
+// 必须持有mutex_。弹性模式下，没有空闲线程并且队头任务已经等待超过spawnThreshold_时需要增加一个线程，
+// 一个线程都没有时（start(0)，或者都已经退休）不用等
+bool ThreadPool::needMoreThreads(Timestamp now) const {
+    mutex_.assertLockByThisThread();
+    if (!isElastic() || !running_ || idleThreads_ > 0 || liveThreads_ >= maxThreads_ || queuedTasks_ == 0) {
+        return false;
+    }
+    return liveThreads_ == 0 || timeDifference(now, oldestEnqueueTime()) >= spawnThreshold_;
+}
+
+// 弹性模式下的监视线程，创建和回收线程都在这里做，并且不持有mutex_，提交任务和取任务的线程只唤醒它。
+// 所有线程都卡在长任务里、又没有新的提交时，也要增加线程，所以队列不空时每spawnThreshold_秒检查一次；
+// 队列为空时在monitorCond_上休眠，不占用CPU
+void ThreadPool::monitorInThread() {
+    bool spawned = false;
+    for (;;) {
+        std::vector<pid_t> retired;
+        bool spawn = false;
+        int id = 0;
+        int cpuSlot = -1;
+        {
+            MutexLockGuard lock(mutex_);
+            if (spawned && running_) { //给新线程一点时间取走任务，再看是不是还不够
+                monitorCond_.waitForSeconds(spawnThreshold_);
+            }
+            while (running_ && retiredTids_.empty() && !needMoreThreads(Timestamp::monotonicNow())) {
+                if (queuedTasks_ == 0) {
+                    monitorCond_.wait();
+                } else {
+                    monitorCond_.waitForSeconds(spawnThreshold_);
+                }
+            }
+            if (!running_) { //剩下的线程（包括已经退休的）由stop回收
+                return;
+            }
+
+            retired.swap(retiredTids_);
+            spawn = needMoreThreads(Timestamp::monotonicNow());
+            if (spawn) {
+                reserveThread(&id, &cpuSlot);
+            }
+        }
+
+        joinRetiredThreads(retired);
+        if (spawn) {
+            startThread(id, cpuSlot);
+        }
+        spawned = spawn;
+    }
+}
+
+// 回收已经退休的线程，不持有mutex_
+void ThreadPool::joinRetiredThreads(const std::vector<pid_t>& tids) {
+    for (size_t i = 0; i < tids.size(); ++i) {
+        for (boost::ptr_vector<kaycc::Thread>::iterator it = threads_.begin(); it != threads_.end(); ++it) {
+            if (it->tid() == tids[i]) {
+                it->join();
+                threads_.erase(it);
+                break;
+            }
+        }
+    }
 }
 
 size_t ThreadPool::queueSize() const {
     MutexLockGuard lock(mutex_);
-    return queue_.size();
+    return queuedTasks_;
 }
 
-void ThreadPool::run(const TaskFunc& task) {
-    if (threads_.empty()) { //如果线程池没有线程，那么直接执行任务，也就是说假设没有消费者，那么生产者直接消费产品. 
-        task();             //而不把任务加入任务队列
-    } else {//如果线程池有线程,加锁，如果队列已满，则挂起等待
-        MutexLockGuard lock(mutex_);
-        while (isFull()) { 
-            notFull_.wait();
+void ThreadPool::setLaneWeights(const std::vector<int>& weights) {
+    assert(!weights.empty());
+    assert(!running_);
+    lanes_.clear();
+    for (size_t i = 0; i < weights.size(); ++i) {
+        assert(weights[i] > 0);
+        lanes_.push_back(new Lane(weights[i]));
+    }
+}
+
+ThreadPool::LaneStats ThreadPool::laneStats(int lane) const {
+    MutexLockGuard lock(mutex_);
+    const Lane& l = lanes_[lane];
+    LaneStats stats;
+    stats.queued = l.tasks.size();
+    stats.executed = l.executed;
+    stats.expired = l.expired;
+    stats.waitHistogram.assign(l.waitHistogram, l.waitHistogram + kHistogramBuckets);
+    return stats;
+}
+
+size_t ThreadPool::peakQueueSize() const {
+    MutexLockGuard lock(mutex_);
+    return peakQueueSize_;
+}
+
+size_t ThreadPool::numThreads() const {
+    MutexLockGuard lock(mutex_);
+    return static_cast<size_t>(liveThreads_);
+}
+
+// 必须持有mutex_，调用方负责通知notEmpty_。task的内容被移到队列里
+void ThreadPool::pushTask(int lane, TaskFunc& task, Timestamp now, double timeoutSeconds) {
+    assert(lane >= 0 && static_cast<size_t>(lane) < lanes_.size());
+    std::deque<QueuedTask>& tasks = lanes_[lane].tasks;
+    tasks.push_back(QueuedTask());
+    QueuedTask& queued = tasks.back();
+    queued.task.swap(task);
+    queued.enqueueTime = now;
+    queued.deadline = timeoutSeconds > 0 ? addTime(now, timeoutSeconds) : Timestamp::invalid();
+    peakQueueSize_ = std::max(peakQueueSize_, ++queuedTasks_);
+    if (isElastic() && (queuedTasks_ == 1 || needMoreThreads(now))) { //只唤醒监视线程，不在这里创建线程
+        monitorCond_.notify();
+    }
+}
+
+// 必须持有mutex_并且有任务。平滑加权轮询（smooth weighted round-robin）：
+// 每次给所有非空通道的current加上各自的weight，选current最大的，再给它减去这些通道weight的总和，
+// 这样权重为{5, 1}时出队顺序是交错的，而不是先连续出5个
+int ThreadPool::pickLane() {
+    int best = -1;
+    int total = 0;
+    for (size_t i = 0; i < lanes_.size(); ++i) {
+        Lane& l = lanes_[i];
+        if (l.tasks.empty()) {
+            continue;
+        }
+
+        l.current += l.weight;
+        total += l.weight;
+        if (best < 0 || l.current > lanes_[best].current) {
+            best = static_cast<int>(i);
+        }
+    }
+
+    assert(best >= 0);
+    lanes_[best].current -= total;
+    return best;
+}
+
+// 必须持有mutex_
+Timestamp ThreadPool::oldestEnqueueTime() const {
+    Timestamp oldest;
+    for (size_t i = 0; i < lanes_.size(); ++i) {
+        const std::deque<QueuedTask>& tasks = lanes_[i].tasks;
+        if (!tasks.empty() && (!oldest.valid() || tasks.front().enqueueTime < oldest)) {
+            oldest = tasks.front().enqueueTime;
         }
+    }
+    return oldest;
+}
+
+// 排队时间按2的幂分桶：0号桶是小于1微秒，i号桶是[2^(i-1), 2^i)微秒，最后一个桶包含更长的
+int ThreadPool::histogramBucket(int64_t waitUs) {
+    if (waitUs <= 0) {
+        return 0;
+    }
+    int bucket = 64 - __builtin_clzll(static_cast<unsigned long long>(waitUs));
+    return std::min(bucket, kHistogramBuckets - 1);
+}
 
-        //wait返回后，队列就不是满的，此时在把任务加入队列，并通知notEmpty_，可以取任务执行了
-        assert(!isFull()); 
-        queue_.push_back(task);
-        notEmpty_.notify();
+void ThreadPool::run(const TaskFunc& task, int lane, double timeoutSeconds) {
+    if (runsInline()) { //如果线程池没有线程，那么直接执行任务，也就是说假设没有消费者，那么生产者直接消费产品. 
+        task();             //而不把任务加入任务队列
+    } else {//如果线程池有线程，拷贝一份（在锁外）放入队列
+        TaskFunc copy(task);
+        enqueue(copy, lane, timeoutSeconds);
     }
 
 }
 
 #if __cplusplus >= 201103L
-void ThreadPool::run(TaskFunc&& task) {
-    if (threads_.empty()) {
+void ThreadPool::run(TaskFunc&& task, int lane, double timeoutSeconds) {
+    if (runsInline()) {
         task();
     } else {
-        MutexLockGuard lock(mutex_);
-        while (isFull()) {
-            notFull_.wait();
-        }
-
-        assert(!isFull());
-        queue_.push_back(std::move(task));
-        notEmpty_.notify();
+        enqueue(task, lane, timeoutSeconds); //直接移到队列里，不拷贝
     }
 }
 #endif
 
-ThreadPool::TaskFunc ThreadPool::takeTask() {
+// 加锁，如果队列已满，则挂起等待。task的内容被移到队列里
+void ThreadPool::enqueue(TaskFunc& task, int lane, double timeoutSeconds) {
+    Timestamp now(Timestamp::monotonicNow()); //在锁外取时间
+    MutexLockGuard lock(mutex_);
+    while (isFull() && running_) { 
+        notFull_.wait();
+    }
+
+    if (!running_) { //已经stop，没有线程会再取任务
+        LOG_ERROR << "ThreadPool " << name_ << " run() after stop(), task dropped" << std::endl;
+        return;
+    }
+
+    //wait返回后，队列就不是满的，此时在把任务加入队列，并通知notEmpty_，可以取任务执行了
+    assert(!isFull()); 
+    pushTask(lane, task, now, timeoutSeconds);
+    notEmpty_.notify();
+}
+
+bool ThreadPool::tryRun(const TaskFunc& task, int lane, double timeoutSeconds) {
+    if (runsInline()) {
+        task();
+        return true;
+    }
+
+    Timestamp now(Timestamp::monotonicNow());
+    MutexLockGuard lock(mutex_);
+    if (!running_) {
+        return false;
+    }
+
+    if (isFull()) {
+        saturated_ = true;
+        rejected_.increment();
+        return false;
+    }
+
+    TaskFunc copy(task);
+    pushTask(lane, copy, now, timeoutSeconds);
+    notEmpty_.notify();
+    return true;
+}
+
+void ThreadPool::runBatch(const std::vector<TaskFunc>& tasks, int lane, double timeoutSeconds) {
+    if (runsInline()) {
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            tasks[i]();
+        }
+        return;
+    }
+
+    Timestamp now(Timestamp::monotonicNow());
     MutexLockGuard lock(mutex_);
+    size_t i = 0;
+    while (i < tasks.size()) {
+        while (isFull() && running_) {
+            notEmpty_.notifyAll(); //已经放入的任务还没有通知过，先唤醒工作线程去取，否则会一直等下去
+            notFull_.wait();
+        }
+
+        if (!running_) {
+            LOG_ERROR << "ThreadPool " << name_ << " runBatch() after stop(), "
+                      << tasks.size() - i << " tasks dropped" << std::endl;
+            return;
+        }
 
-    while (queue_.empty() && running_) { //使用while防止惊群效应，如在多处理器系统中，pthread_cond_signal 可能会唤醒多个等待条件的线程，这也是一种spurious wakeup。
-        notEmpty_.wait(); //如果队列为空，就挂起等待
+        while (i < tasks.size() && !isFull()) {
+            TaskFunc copy(tasks[i++]);
+            pushTask(lane, copy, now, timeoutSeconds);
+        }
     }
+    notEmpty_.notifyAll();
+}
+
+// 返回false表示当前线程应该退休（弹性模式下空闲超过keepAlive_）
+bool ThreadPool::takeTask(TaskFunc* task, int cpuSlot) {
+    bool drained = false;
+    std::vector<ExpiredTask> expired; //已经过了截止时间的任务，在锁外处理
+    {
+        MutexLockGuard lock(mutex_);
+
+        for (;;) {
+            if (queuedTasks_ == 0 && !expired.empty()) { //先在锁外交付已经过期的任务，再回来等待
+                break;
+            }
+
+            while (queuedTasks_ == 0 && running_) { //使用while防止惊群效应，如在多处理器系统中，pthread_cond_signal 可能会唤醒多个等待条件的线程，这也是一种spurious wakeup。
+                ++idleThreads_;
+                if (isElastic() && liveThreads_ > minThreads_) {
+                    // 多出来的线程最多空闲keepAlive_秒
+                    bool timeout = notEmpty_.waitForSeconds(keepAlive_);
+                    --idleThreads_;
+                    if (timeout && queuedTasks_ == 0 && running_ && liveThreads_ > minThreads_) {
+                        --liveThreads_;
+                        retiredTids_.push_back(currentthread::tid());
+                        if (cpuSlot >= 0) {
+                            --cpuThreads_[cpuSlot];
+                        }
+                        monitorCond_.notify(); //由监视线程join
+                        return false;
+                    }
+                } else {
+                    notEmpty_.wait(); //如果队列为空，就挂起等待
+                    --idleThreads_;
+                }
+            }
+
+            if (queuedTasks_ == 0) { //线程池已经stop，或者有过期的任务要交付
+                break;
+            }
 
-    TaskFunc task;
-    if (!queue_.empty()) {
-        task = queue_.front();
-        queue_.pop_front();
+            int lane = pickLane();
+            Lane& l = lanes_[lane];
+            QueuedTask& front = l.tasks.front();
+            Timestamp now(Timestamp::monotonicNow());
 
-        if (maxQueueSize_ > 0) { //如果队列的最大容量大于0，notFull就通知，如果有新的任务，就加入队列
-            notFull_.notify();
+            if (maxQueueSize_ > 0) { //如果队列的最大容量大于0，notFull就通知，如果有新的任务，就加入队列
+                notFull_.notify();
+            }
+
+            if (front.deadline.valid() && front.deadline < now) { //过期的任务不执行，继续取下一个
+                ExpiredTask e;
+                e.task.swap(front.task);
+                e.lane = lane;
+                expired.push_back(e);
+                ++l.expired;
+                l.tasks.pop_front();
+                --queuedTasks_;
+                continue;
+            }
+
+            ++l.waitHistogram[histogramBucket(now.microSecondsSinceEpoch() - front.enqueueTime.microSecondsSinceEpoch())];
+            ++l.executed;
+            task->swap(front.task);
+            l.tasks.pop_front();
+            --queuedTasks_;
+
+            // 剩下的任务也已经等了很久，说明线程不够用
+            if (needMoreThreads(now)) {
+                monitorCond_.notify();
+            }
+            break;
+        }
+
+        if (saturated_ && queuedTasks_ <= lowWaterMark_) { //tryRun被拒绝过，现在降到了低水位
+            saturated_ = false;
+            drained = true;
         }
     }
 
-    return task;
+    // 以下回调都在锁外调用，回调里可能会再提交任务
+    if (expiredTaskCallback_) {
+        for (size_t i = 0; i < expired.size(); ++i) {
+            expiredTaskCallback_(expired[i].task, expired[i].lane);
+        }
+    }
+
+    if (drained && lowWaterMarkCallback_) {
+        lowWaterMarkCallback_();
+    }
+
+    return true;
 }
 
 bool ThreadPool::isFull() const {
     mutex_.assertLockByThisThread(); //锁已经被当前线程（调用ThreadPool的线程）锁住程锁住
-    return maxQueueSize_ > 0 && queue_.size() >= maxQueueSize_;
+    return maxQueueSize_ > 0 && queuedTasks_ >= maxQueueSize_;
 }
 
-void ThreadPool::runInThread() {
+void ThreadPool::runInThread(int cpuSlot) {
     try {
+        if (cpuSlot >= 0) {
+            CpuTopology::bindCurrentThread(cpus_[cpuSlot]);
+        }
 
         if (threadInitCallback_) {
             threadInitCallback_();
         }
 
         while (running_) {
-            TaskFunc task(takeTask());
+            TaskFunc task;
+            if (!takeTask(&task, cpuSlot)) { //退休，线程对象由监视线程或者stop回收
+                break;
+            }
+
             if (task) { //执行任务，消费产品
                 task();
             }
         }
     } catch (std::exception& ex) {
-        LOG << "exception caught in ThreadPool " << name_ << " ,reason: " << ex.what() << std::endl;
+        LOG_ERROR << "exception caught in ThreadPool " << name_ << " ,reason: " << ex.what() << std::endl;
         abort();
     } catch (...) {
-        LOG << "unknown exception caught in ThreadPool " << name_ << std::endl;
+        LOG_ERROR << "unknown exception caught in ThreadPool " << name_ << std::endl;
         throw;
     }
 
@@ -1,15 +1,21 @@
 #ifndef KAYCC_BASE_THREADPOOL_H
 #define KAYCC_BASE_THREADPOOL_H
 
+#include "atomic.h"
 #include "condition.h"
+#include "future.h"
 #include "mutex.h"
 #include "thread.h"
+#include "timestamp.h"
 
 #include <boost/function.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/scoped_ptr.hpp>
 
+#include <algorithm>
 #include <deque>
+#include <vector>
 
 namespace kaycc {
     class ThreadPool : boost::noncopyable {
@@ -24,7 +30,43 @@ namespace kaycc {
             threadInitCallback_ = cb;
         }
 
+        // tryRun被拒绝过之后，队列长度降到lowWaterMark以下时在工作线程里调用一次cb，
+        // 用于通知提交方可以继续提交了（见net/taskoffloader.h）
+        void setLowWaterMarkCallback(const TaskFunc& cb, size_t lowWaterMark) {
+            lowWaterMarkCallback_ = cb;
+            lowWaterMark_ = lowWaterMark;
+        }
+
+        // 弹性模式：start(numThreads)的numThreads是最少线程数（可以是0），最多maxThreads个线程。
+        // 没有空闲线程、并且队头任务已经等待超过spawnThreshold秒时增加线程，一个线程都没有时立即增加；
+        // 创建和回收线程都由一个监视线程来做，提交任务的线程只负责唤醒它，所以tryRun不会阻塞在创建线程上。
+        // 多出来的线程空闲超过keepAlive秒后退出。都必须在start之前设置
+        void setMaxThreads(int maxThreads) { maxThreads_ = maxThreads; }
+        void setSpawnThreshold(double seconds) { spawnThreshold_ = seconds; }
+        void setKeepAlive(double seconds) { keepAlive_ = seconds; }
+
+        // 优先级通道：weights[i]是第i个通道的权重，出队时按权重加权轮询，通道0是默认通道。
+        // 例如{1, 8}时，通道1的任务出队机会是通道0的8倍，但通道0不会饿死。必须在start之前设置
+        void setLaneWeights(const std::vector<int>& weights);
+
+        // 设置了截止时间的任务过期后不再执行，交给这个回调（在工作线程里调用）；没有设置就直接丢弃
+        typedef boost::function<void (const TaskFunc&, int lane)> ExpiredTaskCallback;
+        void setExpiredTaskCallback(const ExpiredTaskCallback& cb) {
+            expiredTaskCallback_ = cb;
+        }
+
+        // 把工作线程绑定到CPU上，新线程用cpus里当前线程最少的位置（相同时取靠前的），
+        // 所以第i个创建的线程用cpus[i % cpus.size()]，弹性模式下退休线程的CPU留给下一个新线程；cpus为空时按CpuTopology::spread
+        // 分散到不同的物理核和NUMA节点上。不调用时不绑定。必须在start之前设置
+        void setCpuAffinity(const std::vector<int>& cpus = std::vector<int>()) {
+            pinned_ = true;
+            cpus_ = cpus;
+        }
+
         void start(int numThreads);
+
+        // 等待工作线程退出，还在排队的任务被丢弃（submit返回的Future变为broken），
+        // 之后提交的任务也被丢弃
         void stop();
 
         const std::string& name() const {
@@ -33,30 +75,141 @@ namespace kaycc {
 
         size_t queueSize() const;
 
-        void run(const TaskFunc& f);
+        // 当前的工作线程数，弹性模式下会变化
+        size_t numThreads() const;
+
+        // start(0)并且不是弹性模式时没有工作线程，提交的任务在调用线程里直接执行
+        bool runsInline() const { return minThreads_ == 0 && !isElastic(); }
+
+        // 队列长度的历史最大值
+        size_t peakQueueSize() const;
+
+        // tryRun被拒绝的次数
+        int64_t rejectedCount() const {
+            return rejected_.get();
+        }
+
+        static const int kHistogramBuckets = 32;
+
+        struct LaneStats {
+            size_t queued;       //正在排队的任务数
+            int64_t executed;    //已经取出执行的任务数
+            int64_t expired;     //过期未执行的任务数
+            // 排队时间直方图：[0]是小于1微秒，[i]是[2^(i-1), 2^i)微秒
+            std::vector<int64_t> waitHistogram;
+        };
+
+        LaneStats laneStats(int lane) const;
+
+        int numLanes() const {
+            return static_cast<int>(lanes_.size());
+        }
+
+        // lane为通道下标；timeoutSeconds > 0时，任务排队超过这个时间还没开始执行就过期
+        void run(const TaskFunc& f, int lane = 0, double timeoutSeconds = 0.0);
     #if __cplusplus >= 201103L
-        void run(TaskFunc&& f);
+        void run(TaskFunc&& f, int lane = 0, double timeoutSeconds = 0.0);
     #endif
 
+        // 不阻塞的提交，队列满或者已经stop时直接返回false（任务不会执行），可以在IO线程里调用
+        bool tryRun(const TaskFunc& f, int lane = 0, double timeoutSeconds = 0.0);
+
+        // 提交一个有返回值的任务，通过返回的Future取结果或者串联后续操作；
+        // 任务没有执行就被丢弃时（stop()），Future变为broken
+        template <typename F>
+        Future<typename boost::result_of<F()>::type> submit(F f) {
+            typedef typename boost::result_of<F()>::type R;
+            Promise<R> promise;
+            run(detail::RunTask<R, F>(promise, f));
+            return promise.getFuture();
+        }
+
+        // 批量提交，只加一次锁、只广播一次；有容量限制时，队列满了会先唤醒工作线程再等待。
+        // 所有任务放入同一个lane，截止时间都从提交时开始算
+        void runBatch(const std::vector<TaskFunc>& tasks, int lane = 0, double timeoutSeconds = 0.0);
+
     private:
+        // 队列里的任务，记录入队时间（单调时钟）用于计算排队时间
+        struct QueuedTask {
+            TaskFunc task;
+            Timestamp enqueueTime;
+            Timestamp deadline; //无效表示没有截止时间
+        };
+
+        struct Lane : boost::noncopyable {
+            explicit Lane(int w)
+                : weight(w),
+                  current(0),
+                  executed(0),
+                  expired(0) {
+                std::fill(waitHistogram, waitHistogram + kHistogramBuckets, 0);
+            }
+
+            std::deque<QueuedTask> tasks;
+            int weight;
+            int current; //加权轮询的当前值
+            int64_t executed;
+            int64_t expired;
+            int64_t waitHistogram[kHistogramBuckets];
+        };
+
+        struct ExpiredTask {
+            TaskFunc task;
+            int lane;
+        };
+
         bool isFull() const;
-        void runInThread();
-        TaskFunc takeTask();
+        bool isElastic() const { return maxThreads_ > minThreads_; }
+        void runInThread(int cpuSlot);
+        bool takeTask(TaskFunc* task, int cpuSlot);
+        void enqueue(TaskFunc& task, int lane, double timeoutSeconds);
+        void pushTask(int lane, TaskFunc& task, Timestamp now, double timeoutSeconds);
+        int pickLane();
+        Timestamp oldestEnqueueTime() const;
+        static int histogramBucket(int64_t waitUs);
+        void reserveThread(int* id, int* cpuSlot);
+        void startThread(int id, int cpuSlot);
+        bool needMoreThreads(Timestamp now) const;
+        void monitorInThread();
+        void joinRetiredThreads(const std::vector<pid_t>& tids);
 
     private:
         mutable MutexLock mutex_;
         Condition notEmpty_; //条件变量，队列没有空，就通知拿任务
         Condition notFull_; //条件变量，队列没雨满，就通知可以放入任务
+        Condition monitorCond_; //弹性模式下唤醒监视线程：队列里有任务了、需要增加线程或者有线程退休
 
         std::string name_;
 
         TaskFunc threadInitCallback_; //线程回调函数执行前的初始化回调函数
-        boost::ptr_vector<kaycc::Thread> threads_;
-        std::deque<TaskFunc> queue_;
+        boost::ptr_vector<kaycc::Thread> threads_; //只在start、stop和监视线程里访问
+        boost::ptr_vector<Lane> lanes_;
+        size_t queuedTasks_;                //所有通道的任务总数
+        ExpiredTaskCallback expiredTaskCallback_;
 
         size_t maxQueueSize_;
         bool running_;
 
+        TaskFunc lowWaterMarkCallback_;
+        size_t lowWaterMark_;
+        bool saturated_;       //tryRun被拒绝后置为true，直到队列降到低水位
+        size_t peakQueueSize_;
+        AtomicInt64 rejected_;
+
+        int minThreads_;
+        int maxThreads_;
+        double spawnThreshold_;
+        double keepAlive_;
+        int liveThreads_;              //正在运行的线程数
+        int idleThreads_;              //在takeTask里等待的线程数
+        int nextThreadId_;             //线程名的编号
+        std::vector<pid_t> retiredTids_; //已经退休、还没有回收的线程
+        boost::scoped_ptr<kaycc::Thread> monitor_; //弹性模式下的监视线程
+
+        bool pinned_;
+        std::vector<int> cpus_;
+        std::vector<int> cpuThreads_;  //绑定在cpus_[i]上正在运行的线程数
+
     };
 }
 
@@ -1,6 +1,7 @@
 #include "timestamp.h"
 
 #include <sys/time.h>
+#include <time.h> //clock_gettime
 #include <stdio.h> //snprintf
 
 #ifndef __STDC_FORMAT_MACROS
@@ -40,4 +41,12 @@ Timestamp Timestamp::now() {
     int64_t seconds = tv.tv_sec;
 
     return Timestamp(seconds * kMicroSecondsPerSecond + tv.tv_usec);//返回自1970 01 01 开始的微秒数的一个新对象
-}
\ No newline at end of file
+}
+
+Timestamp Timestamp::monotonicNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    int64_t seconds = ts.tv_sec;
+
+    return Timestamp(seconds * kMicroSecondsPerSecond + ts.tv_nsec / 1000);
+}
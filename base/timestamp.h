@@ -40,6 +40,11 @@ namespace kaycc {
         }
 
         static Timestamp now();
+
+        // 单调时钟（CLOCK_MONOTONIC），表示系统启动以来的微秒数，不受修改系统时间的影响，
+        // 只能与其他单调时钟的时间戳比较，不能当作epoch时间使用
+        static Timestamp monotonicNow();
+
         static Timestamp invalid() {
             return Timestamp();
         }
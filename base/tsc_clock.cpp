@@ -0,0 +1,99 @@
+#include "tsc_clock.h"
+
+#include <atomic>
+
+#include <pthread.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h> //__rdtsc
+#define KAYCC_HAVE_TSC 1
+#endif
+
+using namespace kaycc;
+
+namespace {
+    pthread_once_t g_calibrateOnce = PTHREAD_ONCE_INIT;
+    std::atomic<bool> g_calibrated(false); //校准完成后为true，之后不用再经过pthread_once
+
+    bool g_tscAvailable = false;
+    uint64_t g_baseTsc = 0;     //校准时的TSC值
+    int64_t g_baseNs = 0;       //校准时的CLOCK_MONOTONIC（纳秒）
+    double g_nsPerTick = 0.0;   //每个TSC周期的纳秒数
+
+    const int64_t kNanoSecondsPerSecond = 1000000000;
+    const int64_t kCalibrateNs = 10 * 1000 * 1000; //校准时长10ms
+
+    int64_t monotonicNanoSeconds() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * kNanoSecondsPerSecond + ts.tv_nsec;
+    }
+
+#ifdef KAYCC_HAVE_TSC
+    // CPUID.80000007H:EDX[8]为1表示invariant TSC
+    bool hasInvariantTsc() {
+        unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+        if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 || eax < 0x80000007) {
+            return false;
+        }
+
+        __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+        return (edx & (1u << 8)) != 0;
+    }
+#endif
+}
+
+void TscClock::calibrate() {
+#ifdef KAYCC_HAVE_TSC
+    if (!hasInvariantTsc()) {
+        return;
+    }
+
+    // 忙等kCalibrateNs，用两次(tsc, monotonic)的差值算出TSC的频率
+    uint64_t tsc0 = __rdtsc();
+    int64_t ns0 = monotonicNanoSeconds();
+    int64_t ns1 = ns0;
+    while (ns1 - ns0 < kCalibrateNs) {
+        ns1 = monotonicNanoSeconds();
+    }
+    uint64_t tsc1 = __rdtsc();
+
+    if (tsc1 <= tsc0) {
+        return;
+    }
+
+    g_nsPerTick = static_cast<double>(ns1 - ns0) / static_cast<double>(tsc1 - tsc0);
+    g_baseTsc = tsc1;
+    g_baseNs = ns1;
+    g_tscAvailable = true;
+#endif
+}
+
+bool TscClock::available() {
+    if (!g_calibrated.load(std::memory_order_acquire)) {
+        pthread_once(&g_calibrateOnce, &TscClock::calibrate);
+        g_calibrated.store(true, std::memory_order_release);
+    }
+    return g_tscAvailable;
+}
+
+int64_t TscClock::nowNanoSeconds() {
+#ifdef KAYCC_HAVE_TSC
+    if (available()) {
+        uint64_t ticks = __rdtsc() - g_baseTsc;
+        return g_baseNs + static_cast<int64_t>(static_cast<double>(ticks) * g_nsPerTick);
+    }
+#endif
+
+    return monotonicNanoSeconds();
+}
+
+Timestamp TscClock::now() {
+    return Timestamp(nowNanoSeconds() / 1000);
+}
+
+double TscClock::ticksPerNanoSecond() {
+    return available() ? 1.0 / g_nsPerTick : 0.0;
+}
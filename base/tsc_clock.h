@@ -0,0 +1,39 @@
+#ifndef KAYCC_BASE_TSCCLOCK_H
+#define KAYCC_BASE_TSCCLOCK_H
+
+#include "timestamp.h"
+
+#include <boost/noncopyable.hpp>
+#include <stdint.h>
+
+/*
+基于TSC(Time Stamp Counter)的单调时钟，用于高频打点计时。
+rdtsc只是读一个CPU寄存器，比clock_gettime的vDSO调用还要便宜。
+第一次使用时用CLOCK_MONOTONIC校准TSC的频率，之后的时间由TSC的差值换算得到，
+与Timestamp::monotonicNow()使用同一个时间基准，可以互相比较。
+只有在x86上并且CPU支持invariant TSC（频率不随变频、休眠变化）时才使用TSC，否则退化为clock_gettime。
+*/
+
+namespace kaycc {
+
+    class TscClock : boost::noncopyable {
+    public:
+        // 是否使用TSC，为false时now()等价于Timestamp::monotonicNow()
+        static bool available();
+
+        // 当前的单调时间（微秒）
+        static Timestamp now();
+
+        // 当前的单调时间（纳秒）
+        static int64_t nowNanoSeconds();
+
+        // 每纳秒的TSC周期数，不可用时返回0
+        static double ticksPerNanoSecond();
+
+    private:
+        static void calibrate();
+    };
+
+}
+
+#endif
@@ -0,0 +1,207 @@
+#include "work_stealing_threadpool.h"
+
+#include <boost/bind.hpp>
+#include <assert.h>
+#include <stdio.h>
+#include "log.h"
+
+using namespace kaycc;
+
+namespace {
+    // 当前线程所属的线程池以及它在线程池中的队列下标，用于判断任务是否是工作线程内提交的
+    __thread WorkStealingThreadPool* t_currentPool = NULL;
+    __thread size_t t_queueIndex = 0;
+}
+
+WorkStealingThreadPool::WorkStealingThreadPool(const std::string& name)
+    : mutex_(),
+      notEmpty_(mutex_),
+      notFull_(mutex_),
+      name_(name),
+      maxQueueSize_(0),
+      running_(false) {
+
+}
+
+WorkStealingThreadPool::~WorkStealingThreadPool() {
+    if (running_) {
+        stop();
+    }
+}
+
+void WorkStealingThreadPool::start(int numThreads) {
+    assert(threads_.empty());
+    running_ = true;
+    threads_.reserve(numThreads);
+    queues_.reserve(numThreads);
+
+    // 先创建好所有队列，线程启动后可能马上就会去窃取其他队列
+    for (int i = 0; i < numThreads; ++i) {
+        queues_.push_back(new WorkQueue);
+    }
+
+    for (int i = 0; i < numThreads; ++i) {
+        char id[32];
+        snprintf(id, sizeof(id), "%d", i+1);
+
+        threads_.push_back(new kaycc::Thread(
+            boost::bind(&WorkStealingThreadPool::runInThread, this, static_cast<size_t>(i)), name_ + id));
+        threads_[i].start();
+    }
+
+    if (numThreads == 0 && threadInitCallback_) {
+        threadInitCallback_();
+    }
+}
+
+void WorkStealingThreadPool::stop() {
+    {
+        MutexLockGuard lock(mutex_);
+        running_ = false;
+        notEmpty_.notifyAll();
+        notFull_.notifyAll();
+    }
+
+    for_each(threads_.begin(), threads_.end(),
+        boost::bind(&kaycc::Thread::join, _1));
+}
+
+size_t WorkStealingThreadPool::queueSize() const {
+    return static_cast<size_t>(pendingTasks_.get());
+}
+
+void WorkStealingThreadPool::run(const TaskFunc& task) {
+    if (threads_.empty()) { //没有工作线程，直接在调用线程执行
+        task();
+        return;
+    }
+
+    TaskFunc copy(task);
+    submit(copy);
+}
+
+#if __cplusplus >= 201103L
+void WorkStealingThreadPool::run(TaskFunc&& task) {
+    if (threads_.empty()) {
+        task();
+        return;
+    }
+
+    submit(task);
+}
+#endif
+
+void WorkStealingThreadPool::submit(TaskFunc& task) {
+    if (t_currentPool == this) {
+        // 工作线程内提交的任务放到自己的队列，不受maxQueueSize_限制，但也占用名额
+        if (maxQueueSize_ > 0) {
+            occupiedSlots_.increment();
+        }
+        push(t_queueIndex, task);
+
+    } else {
+        if (maxQueueSize_ > 0) {
+            // 有容量限制时，在锁内占用一个名额，保证任务总数不超过maxQueueSize_
+            MutexLockGuard lock(mutex_);
+            while (static_cast<size_t>(occupiedSlots_.get()) >= maxQueueSize_ && running_) {
+                notFull_.wait();
+            }
+            occupiedSlots_.increment();
+        }
+
+        size_t index = static_cast<size_t>(nextQueue_.getAndAdd(1)) % queues_.size();
+        push(index, task);
+    }
+
+    // pendingTasks_先增加，再检查idleThreads_，与runInThread里的顺序相反，
+    // 两边都是全内存屏障，保证至少有一方能看到对方的修改，不会丢失唤醒
+    if (idleThreads_.get() > 0) {
+        wakeupIdleThread();
+    }
+}
+
+// pendingTasks_在队列的锁里增加，窃取者在同一把锁里取走任务后才会减少它
+void WorkStealingThreadPool::push(size_t index, TaskFunc& task) {
+    WorkQueue& queue = queues_[index];
+    MutexLockGuard lock(queue.mutex);
+    queue.tasks.push_back(TaskFunc());
+    queue.tasks.back().swap(task);
+    pendingTasks_.increment();
+}
+
+void WorkStealingThreadPool::wakeupIdleThread() {
+    MutexLockGuard lock(mutex_);
+    notEmpty_.notify();
+}
+
+// 先从自己队列的尾部取，再按顺序从其他队列的头部窃取
+bool WorkStealingThreadPool::takeTask(size_t index, TaskFunc* task) {
+    bool found = false;
+    {
+        WorkQueue& queue = queues_[index];
+        MutexLockGuard lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task->swap(queue.tasks.back());
+            queue.tasks.pop_back();
+            pendingTasks_.decrement();
+            found = true;
+        }
+    }
+
+    // 没有待处理的任务时不必逐个去加锁检查其他队列
+    for (size_t i = 1; !found && i < queues_.size() && pendingTasks_.get() > 0; ++i) {
+        WorkQueue& victim = queues_[(index + i) % queues_.size()];
+        MutexLockGuard lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task->swap(victim.tasks.front());
+            victim.tasks.pop_front();
+            pendingTasks_.decrement();
+            found = true;
+        }
+    }
+
+    if (found && maxQueueSize_ > 0) {
+        int32_t before = occupiedSlots_.getAndAdd(-1);
+        if (static_cast<size_t>(before) >= maxQueueSize_) { //之前是满的，通知等待的提交者
+            MutexLockGuard lock(mutex_);
+            notFull_.notify();
+        }
+    }
+
+    return found;
+}
+
+void WorkStealingThreadPool::runInThread(size_t index) {
+    try {
+        t_currentPool = this;
+        t_queueIndex = index;
+
+        if (threadInitCallback_) {
+            threadInitCallback_();
+        }
+
+        while (running_) {
+            TaskFunc task;
+            if (takeTask(index, &task)) {
+                task();
+                continue;
+            }
+
+            // 所有队列都为空，休眠等待
+            MutexLockGuard lock(mutex_);
+            idleThreads_.increment();
+            while (running_ && pendingTasks_.get() == 0) {
+                notEmpty_.wait();
+            }
+            idleThreads_.decrement();
+        }
+    } catch (std::exception& ex) {
+        LOG_ERROR << "exception caught in WorkStealingThreadPool " << name_ << " ,reason: " << ex.what() << std::endl;
+        abort();
+    } catch (...) {
+        LOG_ERROR << "unknown exception caught in WorkStealingThreadPool " << name_ << std::endl;
+        throw;
+    }
+
+    t_currentPool = NULL;
+}
@@ -0,0 +1,92 @@
+#ifndef KAYCC_BASE_WORKSTEALINGTHREADPOOL_H
+#define KAYCC_BASE_WORKSTEALINGTHREADPOOL_H
+
+#include "atomic.h"
+#include "condition.h"
+#include "mutex.h"
+#include "thread.h"
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <deque>
+
+/*
+工作窃取线程池，接口与ThreadPool一致。
+ThreadPool所有线程共用一个队列和一把锁，线程多、任务短时，锁竞争会成为瓶颈。
+这里每个工作线程有自己的队列（各自一把锁）：
+1.工作线程内提交的任务放到自己队列的尾部，并从尾部取任务（LIFO，缓存友好）；
+2.外部线程提交的任务按round-robin分散到各个队列；
+3.自己的队列为空时，从其他线程队列的头部窃取任务；
+4.所有队列都为空时，线程在mutex_/notEmpty_上休眠，只有存在空闲线程时提交者才会去加锁唤醒。
+*/
+
+namespace kaycc {
+    class WorkStealingThreadPool : boost::noncopyable {
+    public:
+        typedef boost::function<void ()> TaskFunc;
+
+        explicit WorkStealingThreadPool(const std::string& name = "WorkStealingThreadPool");
+        ~WorkStealingThreadPool();
+
+        // 限制所有队列中的任务总数，外部线程提交时如果已满就阻塞等待；
+        // 工作线程内提交的任务不受限制，否则所有工作线程都可能阻塞在提交上，造成死锁
+        void setMaxQueueSize(int maxSize) { maxQueueSize_ = maxSize; }
+        void setThreadInitCallback(const TaskFunc& cb) {
+            threadInitCallback_ = cb;
+        }
+
+        void start(int numThreads);
+        void stop();
+
+        const std::string& name() const {
+            return name_;
+        }
+
+        size_t queueSize() const;
+
+        void run(const TaskFunc& f);
+    #if __cplusplus >= 201103L
+        void run(TaskFunc&& f);
+    #endif
+
+    private:
+        // 每个工作线程的任务队列
+        struct WorkQueue : boost::noncopyable {
+            MutexLock mutex;
+            std::deque<TaskFunc> tasks;
+        };
+
+        void runInThread(size_t index);
+        // 提交任务，task的内容被移走
+        void submit(TaskFunc& task);
+        bool takeTask(size_t index, TaskFunc* task);
+        void push(size_t index, TaskFunc& task);
+        void wakeupIdleThread();
+
+    private:
+        mutable MutexLock mutex_; //只用于线程休眠和提交者等待
+        Condition notEmpty_;
+        Condition notFull_;
+
+        std::string name_;
+
+        TaskFunc threadInitCallback_;
+        boost::ptr_vector<kaycc::Thread> threads_;
+        boost::ptr_vector<WorkQueue> queues_;
+
+        size_t maxQueueSize_;
+        bool running_;
+
+        // 所有队列中的任务数，在各个队列的锁里随入队、出队修改，和队列的内容一致（不会为负，
+        // 也不会在队列都为空时大于0），工作线程用它判断是否要窃取、是否休眠
+        AtomicInt32 pendingTasks_;
+        // 有容量限制时已经占用的名额：外部提交者在mutex_里先占用再入队，任务被取走时释放
+        AtomicInt32 occupiedSlots_;
+        AtomicInt32 idleThreads_;  //正在休眠的线程数
+        AtomicInt32 nextQueue_;    //外部提交时round-robin选择队列
+    };
+}
+
+#endif
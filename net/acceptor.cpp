@@ -15,6 +15,18 @@
 using namespace kaycc;
 using namespace kaycc::net;
 
+namespace {
+    bool isWildcardAddr(const InetAddress& addr) {
+        const struct sockaddr* sa = addr.getSockAddr();
+        if (sa->sa_family == AF_INET) {
+            const struct sockaddr_in* sin = reinterpret_cast<const struct sockaddr_in*>(sa);
+            return sin->sin_addr.s_addr == htonl(INADDR_ANY);
+        } else {
+            const struct sockaddr_in6* sin6 = reinterpret_cast<const struct sockaddr_in6*>(sa);
+            return IN6_IS_ADDR_UNSPECIFIED(&sin6->sin6_addr);
+        }
+    }
+}
 
 
 Acceptor::Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reuseport)
@@ -22,7 +34,9 @@ Acceptor::Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reusepor
       acceptSocket_(sockets::createNonblockingOrDie(listenAddr.family())),
       acceptChannel_(loop, acceptSocket_.fd()),
       listenning_(false),
-      idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)) { //返回一个文件描述符，成功返回大于等于0的数，出错返回-1
+      idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)), //返回一个文件描述符，成功返回大于等于0的数，出错返回-1
+      acceptBatch_(kDefaultAcceptBatch),
+      localAddrFixed_(!isWildcardAddr(listenAddr)) {
 
     assert(idleFd_ >= 0);
 
@@ -32,9 +46,16 @@ Acceptor::Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reusepor
     // 端口复用
     acceptSocket_.setReusePort(reuseport);
 
+    // 已连接套接字会继承监听套接字的选项
+    acceptSocket_.setKeepAlive(true);
+
     // 绑定地址 
     acceptSocket_.bindAddress(listenAddr);
 
+    if (localAddrFixed_) {
+        localAddr_ = InetAddress(sockets::getLocalAddr(acceptSocket_.fd())); //端口为0时这里得到实际的端口
+    }
+
     // 设置读事件的回调函数
     acceptChannel_.setReadCallback(boost::bind(&Acceptor::handleRead, this));
 
@@ -66,22 +87,38 @@ void Acceptor::listen() {
 
 void Acceptor::handleRead() {
     loop_->assertInLoopThread();
-    InetAddress peerAddr;
-
-    // 接受一个连接
-    int connfd = acceptSocket_.accept(&peerAddr);
-    if (connfd > 0) {
-         // 调用新连接到来回调函数 
-        if (newConnectionCallback_) {
-            newConnectionCallback_(connfd, peerAddr);
-        } else {
-            sockets::close(connfd);
+
+    // 一次读事件尽量多accept几个，突发大量连接时减少poll的次数
+    for (int i = 0; i < acceptBatch_; ++i) {
+        InetAddress peerAddr;
+
+        // 接受一个连接
+        int connfd = acceptSocket_.accept(&peerAddr);
+        if (connfd >= 0) {
+             // 调用新连接到来回调函数 
+            if (newConnectionCallback_) {
+                if (localAddrFixed_) {
+                    newConnectionCallback_(connfd, peerAddr, localAddr_);
+                } else {
+                    newConnectionCallback_(connfd, peerAddr, InetAddress(sockets::getLocalAddr(connfd)));
+                }
+            } else {
+                sockets::close(connfd);
+            }
+            continue;
         }
 
-    } else {
-        LOG << "in Acceptor::handleRead failed." << connfd << std::endl;
+        int savedErrno = errno;
+        if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK) { //队列已经空了
+            break;
+        }
+        if (savedErrno == ECONNABORTED || savedErrno == EINTR || savedErrno == EPROTO) { //这个连接没了，继续下一个
+            continue;
+        }
+
+        LOG_ERROR << "in Acceptor::handleRead failed." << connfd << " errno " << savedErrno << std::endl;
         // 发生文件描述符不够用的情况 
-        if (errno == EMFILE) {
+        if (savedErrno == EMFILE) {
             // 关闭预留的文件描述符
             ::close(idleFd_);
 
@@ -95,7 +132,7 @@ void Acceptor::handleRead() {
             //再次打开一个文件，占用文件描述符，等待下一次的EMFILE错误
             idleFd_ = ::open("/dev/null", O_RDONLY| O_CLOEXEC);
         }
-
+        break;
     }
 
-}
\ No newline at end of file
+}
@@ -19,6 +19,7 @@ Accpetor的作用如下：
 #include <boost/noncopyable.hpp>
 
 #include "channel.h"
+#include "inetaddress.h"
 #include "socket.h"
 
 
@@ -26,13 +27,16 @@ namespace kaycc {
 namespace net {
 
     class EventLoop;
-    class InetAddress;
 
     class Acceptor : boost::noncopyable {
     public:
-          // 新连接到来的回调函数 
+          // 新连接到来的回调函数，参数是已连接套接字、对端地址、本端地址
         typedef boost::function<void (int sockfd, 
-                                      const InetAddress&)> NewConnectionCallback;
+                                      const InetAddress& peerAddr,
+                                      const InetAddress& localAddr)> NewConnectionCallback;
+
+        // 每次读事件最多accept多少个连接
+        static const int kDefaultAcceptBatch = 32;
 
         Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reuseport);
         ~Acceptor();
@@ -42,6 +46,11 @@ namespace net {
             newConnectionCallback_ = cb;
         }
 
+        // 所属的EventLoop
+        EventLoop* getLoop() const {
+            return loop_;
+        }
+
         // 是否正在监听
         bool listenning() const {
             return listenning_;
@@ -50,6 +59,19 @@ namespace net {
         //监听
         void listen();
 
+        // 每次读事件最多accept的连接数，到达这个数或者队列已空（EAGAIN）就返回，
+        // 剩下的连接下一轮poll再处理，避免一直accept饿死其他事件
+        void setAcceptBatch(int batch) {
+            assert(batch > 0);
+            acceptBatch_ = batch;
+        }
+
+        // 已连接套接字的TCP_NODELAY。设置在监听套接字上，accept出来的连接会继承（SO_KEEPALIVE也一样），
+        // 不用每个连接再调用setsockopt
+        void setTcpNoDelay(bool on) {
+            acceptSocket_.setTcpNoDelay(on);
+        }
+
     private:
         // 处理读事件，acceptChannel_的读事件回调函数 
         void handleRead();
@@ -71,6 +93,12 @@ namespace net {
 
         // 预留的空闲文件描述符，用于备用 
         int idleFd_;
+
+        int acceptBatch_;
+
+        // 绑定的是具体地址（不是INADDR_ANY/in6addr_any）时，所有连接的本端地址都是它，不用每次getsockname
+        bool localAddrFixed_;
+        InetAddress localAddr_;
  
     };
 
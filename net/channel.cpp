@@ -79,7 +79,7 @@ void Channel::handleEventWithGuard(Timestamp receiveTime) {
     }
 
     if (revents_ & POLLNVAL) {
-        LOG << "fd = " << fd_ << " Channel::handleEvent POLLNVAL" << std::endl;
+        LOG_WARN << "fd = " << fd_ << " Channel::handleEvent POLLNVAL" << std::endl;
     }
 
     //POLLERR，仅用于内核设置传出参数revents，表示设备发生错误
@@ -21,12 +21,12 @@ Connector::Connector(EventLoop* loop, const InetAddress& serverAddr)
       state_(kDisconnected),
       retryDelayMs_(kInitRetryDelayMs) {
 
-    LOG << "ctor[" << this << "] Connector" << std::endl;
+    LOG_DEBUG << "ctor[" << this << "] Connector" << std::endl;
 
 }
 
 Connector::~Connector() {
-    LOG << "dtor[" << this << "] Connector" << std::endl;
+    LOG_DEBUG << "dtor[" << this << "] Connector" << std::endl;
     assert(!channel_);
 }
 
@@ -43,7 +43,7 @@ void Connector::startInLoop() {
     if (connect_) { //调用前必须connect_为true，start()函数中会这么做  
         connect();
     } else {
-        LOG << "do not connect" << std::endl;
+        LOG_DEBUG << "do not connect" << std::endl;
     }
 }
 
@@ -102,12 +102,12 @@ void Connector::connect() {
         case EBADF:  //错误的文件编号
         case EFAULT: //坏地址
         case ENOTSOCK: //在非socket上执行socket操作
-            LOG << "connect error in Connector::startInLoop " << savedErrno << std::endl;
+            LOG_ERROR << "connect error in Connector::startInLoop " << savedErrno << std::endl;
             sockets::close(sockfd);
             break;
 
         default:
-            LOG << "Unexpected error in Connector::startInLoop " << savedErrno << std::endl;
+            LOG_ERROR << "Unexpected error in Connector::startInLoop " << savedErrno << std::endl;
             sockets::close(sockfd);
             break;
     }
@@ -164,7 +164,7 @@ void Connector::resetChannel() {
 
 // 处理写事件
 void Connector::handleWrite() {
-    LOG << "Connector::handleWrite " << state_ << std::endl;
+    LOG_TRACE << "Connector::handleWrite " << state_ << std::endl;
 
     // 如果状态是正在连接
     if (state_ == kConnecting) {
@@ -172,12 +172,12 @@ void Connector::handleWrite() {
         int sockfd = removeAndResetChannel();
         int err = sockets::getSocketError(sockfd);
         if (err) {
-            LOG << "Connector::handleWrite - SO_ERROR = " << err << std::endl;
+            LOG_WARN << "Connector::handleWrite - SO_ERROR = " << err << std::endl;
             retry(sockfd);
 
         // 发生了自己对自己的连接，重连 
         } else if (sockets::isSelfConnect(sockfd)) {
-            LOG << "Connector::handleWrite - Self connect" << std::endl;
+            LOG_WARN << "Connector::handleWrite - Self connect" << std::endl;
             retry(sockfd);
 
         } else {
@@ -200,7 +200,7 @@ void Connector::handleWrite() {
 
 // 处理错误
 void Connector::handleError() {
-    LOG << "Connector::handleError state=" << state_ << std::endl;
+    LOG_ERROR << "Connector::handleError state=" << state_ << std::endl;
 
     // 如果是正在连接 
     if (state_ == kConnecting) {
@@ -209,7 +209,7 @@ void Connector::handleError() {
 
         // 获取错误码
         int err = sockets::getSocketError(sockfd);
-        LOG << "SO_ERROR = " << err << std::endl;
+        LOG_TRACE << "SO_ERROR = " << err << std::endl;
         retry(sockfd);
     }
 
@@ -221,8 +221,8 @@ void Connector::retry(int sockfd) {
     setState(kDisconnected);
 
     if (connect_) {
-        LOG << "Connector::retry - Retry connecting to " << serverAddr_.toIpPort()
-            << " in " << retryDelayMs_ << " milliseconds.";
+        LOG_INFO << "Connector::retry - Retry connecting to " << serverAddr_.toIpPort()
+            << " in " << retryDelayMs_ << " milliseconds." << std::endl;
 
         // 指定时间之后重试 
         loop_->runAfter(retryDelayMs_/1000.0, 
@@ -232,7 +232,7 @@ void Connector::retry(int sockfd) {
         retryDelayMs_ = std::min(retryDelayMs_ * 2, kMaxRetryDelayMs);
 
     } else {
-        LOG << "do not connect" << std::endl;
+        LOG_DEBUG << "do not connect" << std::endl;
     }
 
 }
@@ -1,6 +1,7 @@
 #include "eventloop.h"
 
 #include "../base/mutex.h"
+#include "../base/rcu.h"
 #include "channel.h"
 #include "poller.h"
 #include "socketsops.h"
@@ -9,6 +10,7 @@
 #include <boost/bind.hpp>
 
 #include <signal.h>
+#include <stdlib.h>
 #include <sys/eventfd.h>
 #include <unistd.h>
 
@@ -34,7 +36,7 @@ namespace {
     int createEventfd() {
         int evtfd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
         if (evtfd < 0) {
-            LOG << "eventfd failed." << std::endl;
+            LOG_ERROR << "eventfd failed." << std::endl;
             abort();
         }
 
@@ -67,13 +69,16 @@ EventLoop::EventLoop()
       iteration_(0),
       threadId_(currentthread::tid()),
       poller_(Poller::newDefaultPoller(this)),
-      timerQueue_(new TimerQueue(this)),
+      timerQueue_(new TimerQueue(this, !::getenv("KAYCC_PRECISE_TIMER"))),
       wakeupFd_(createEventfd()),
       wakeupChannel_(new Channel(this, wakeupFd_)),
-      currentActiveChannel_(NULL) {
-        LOG << "EventLoop created " << this << " in thread " << threadId_ << std::endl;
+      currentActiveChannel_(NULL),
+      connectionCount_(0),
+      pendingCount_(0),
+      recentLatencyUsX8_(0) {
+        LOG_DEBUG << "EventLoop created " << this << " in thread " << threadId_ << std::endl;
         if (t_loopInThisThread) {
-            LOG << "another event loop " << t_loopInThisThread << " exists in this thread " << threadId_ << std::endl; 
+            LOG_ERROR << "another event loop " << t_loopInThisThread << " exists in this thread " << threadId_ << std::endl; 
 
         } else {
             t_loopInThisThread = this;
@@ -87,10 +92,13 @@ EventLoop::EventLoop()
         // 启用读功能 
         wakeupChannel_->enableReading();
 
+        // 所有EventLoop的pendingFunctors_锁合并统计
+        mutex_.setName("EventLoop::pendingFunctors");
+
 }
 
 EventLoop::~EventLoop() {
-    LOG << "EventLoop " << this << " of thread " << threadId_
+    LOG_DEBUG << "EventLoop " << this << " of thread " << threadId_
         << " destructs in thread " << currentthread::tid() << std::endl;
 
     wakeupChannel_->disableAll();
@@ -106,18 +114,37 @@ void EventLoop::loop() {
     looping_ = true;
     quit_ = false;
 
-    LOG << "EventLoop " << this << " start looping" << std::endl;
+    LOG_DEBUG << "EventLoop " << this << " start looping" << std::endl;
+
+    // IO线程都是RCU读者：poll期间离线，其余时间在线，每次循环相当于一次静止状态
+    bool rcuRegistered = !rcu::isRegistered();
+    if (rcuRegistered) {
+        rcu::registerThread();
+    }
 
+    // 上一次循环结束的时间，用来计算轮询的超时时间和本次循环的处理时间
+    Timestamp iterationEnd(Timestamp::monotonicNow());
     while (!quit_) {
         // 清理已激活事件通道的队列
         activeChannels_.clear();
         // 开始轮询  
-        pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+        rcu::threadOffline();
+        if (timerQueue_->usingTimerfd()) {
+            pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+        } else {
+            // 不使用timerfd时，直接以最早的定时器超时时间作为轮询的超时时间
+            pollReturnTime_ = poller_->pollPrecise(pollTimeoutUs(iterationEnd), &activeChannels_);
+        }
+        rcu::threadOnline();
+        // 每次循环开始处理时取一次单调时间，定时器的到期判断用它
+        cachedMonotonicNow_ = Timestamp::monotonicNow();
         // 记录循环的次数
         ++iteration_;
 
         //调式
-        printActiveChannels();
+        if (Logger::logLevel() <= Logger::TRACE) {
+            printActiveChannels();
+        }
 
         eventHandling_ = true;
 
@@ -133,11 +160,30 @@ void EventLoop::loop() {
         currentActiveChannel_ = NULL;
         eventHandling_ = false;
 
+        if (!timerQueue_->usingTimerfd()) {
+            handleExpiredTimers();
+        }
+
         // 执行投递回调函数
         doPendingFunctors();
+
+        // 有写者retire的旧版本时顺便回收，拿不到锁就留给下一次
+        rcu::reclaimIfPending();
+
+        // 本次循环的处理时间，按1/8的权重计入滑动平均。保存的是平均值的8倍，
+        // 否则(busyUs - latency) / 8会把小于8微秒的差截掉，平均值停在离真实值最多7微秒的地方
+        iterationEnd = Timestamp::monotonicNow();
+        int64_t busyUs = iterationEnd.microSecondsSinceEpoch()
+                         - cachedMonotonicNow_.microSecondsSinceEpoch();
+        int64_t latencyX8 = recentLatencyUsX8_.load(std::memory_order_relaxed);
+        recentLatencyUsX8_.store(latencyX8 - latencyX8 / 8 + busyUs, std::memory_order_relaxed);
     }
 
-    LOG << "EventLoop " << this << " stop looping" << std::endl;
+    if (rcuRegistered) {
+        rcu::unregisterThread();
+    }
+
+    LOG_DEBUG << "EventLoop " << this << " stop looping" << std::endl;
     looping_ = false;
 
 }
@@ -173,6 +219,7 @@ void EventLoop::queueInLoop(const Functor& cb) {
     {
         MutexLockGuard lock(mutex_);
         pendingFunctors_.push_back(cb);
+        pendingCount_.store(pendingFunctors_.size(), std::memory_order_relaxed);
     }
 
     if (!isInLoopThread() || callingPendingFunctors_) {
@@ -187,20 +234,21 @@ size_t EventLoop::queueSize() const {
 }
 
 // 添加定时器事件：在某个时间点执行
-TimerId EventLoop::runAt(const Timestamp& time, const TimerCallback& cb) {
-    return timerQueue_->addTimer(cb, time, 0.0);
+// time是墙上时间，转换为单调时间后加入定时器队列，之后修改系统时间不会影响它
+TimerId EventLoop::runAt(const Timestamp& time, const TimerCallback& cb, double slack) {
+    return timerQueue_->addTimer(cb, toMonotonic(time), 0.0, slack);
 }
 
 // 在delay秒之后调用回调函数 
-TimerId EventLoop::runAfter(double delay, const TimerCallback& cb) {
-    Timestamp time(addTime(Timestamp::now(), delay));
-    return runAt(time, cb);
+TimerId EventLoop::runAfter(double delay, const TimerCallback& cb, double slack) {
+    Timestamp time(addTime(Timestamp::monotonicNow(), delay));
+    return timerQueue_->addTimer(cb, time, 0.0, slack);
 }
 
 // 每隔interval妙调用一次回调函数
-TimerId EventLoop::runEvery(double interval, const TimerCallback& cb) {
-    Timestamp time(addTime(Timestamp::now(), interval));
-    return timerQueue_->addTimer(cb, time, interval);
+TimerId EventLoop::runEvery(double interval, const TimerCallback& cb, double slack) {
+    Timestamp time(addTime(Timestamp::monotonicNow(), interval));
+    return timerQueue_->addTimer(cb, time, interval, slack);
 }
 
 #if _cplusplus >= 201103L
@@ -217,6 +265,7 @@ void EventLoop::queueInLoop(const Functor&& cb) {
     {
         MutexLockGuard lock(mutex_);
         pendingFunctors_.push_back(std::move(cb));
+        pendingCount_.store(pendingFunctors_.size(), std::memory_order_relaxed);
     }
 
     if (!isInLoopThread() || callingPendingFunctors_) {
@@ -225,26 +274,40 @@ void EventLoop::queueInLoop(const Functor&& cb) {
 
 }
 
-TimerId EventLoop::runAt(const Timestamp& time, const TimerCallback&& cb) {
-    return timerQueue_->addTimer(std::move(cb), time, 0.0);
+TimerId EventLoop::runAt(const Timestamp& time, const TimerCallback&& cb, double slack) {
+    return timerQueue_->addTimer(std::move(cb), toMonotonic(time), 0.0, slack);
 }
 
-TimerId EventLoop::runAfter(double delay, const TimerCallback&& cb) {
-    Timestamp time(addTime(Timestamp::now(), delay));
-    return runAt(time, std::move(cb));
+TimerId EventLoop::runAfter(double delay, const TimerCallback&& cb, double slack) {
+    Timestamp time(addTime(Timestamp::monotonicNow(), delay));
+    return timerQueue_->addTimer(std::move(cb), time, 0.0, slack);
 }
 
-TimerId EventLoop::runEvery(double interval, const TimerCallback&& cb) {
-    Timestamp time(addTime(Timestamp::now(), interval));
-    return timerQueue_->addTimer(std::move(cb), time, interval);
+TimerId EventLoop::runEvery(double interval, const TimerCallback&& cb, double slack) {
+    Timestamp time(addTime(Timestamp::monotonicNow(), interval));
+    return timerQueue_->addTimer(std::move(cb), time, interval, slack);
 }
 #endif
 
+// 墙上时间转换为单调时间
+Timestamp EventLoop::toMonotonic(const Timestamp& time) {
+    int64_t delta = time.microSecondsSinceEpoch() - Timestamp::now().microSecondsSinceEpoch();
+    return Timestamp(Timestamp::monotonicNow().microSecondsSinceEpoch() + delta);
+}
+
 // 取消一个计时器
 void EventLoop::cancel(TimerId timerId) {
     return timerQueue_->cancel(timerId);
 }
 
+int64_t EventLoop::timerWakeups() const {
+    return timerQueue_->wakeups();
+}
+
+double EventLoop::timerWakeupsPerSecond() const {
+    return timerQueue_->wakeupsPerSecond();
+}
+
 // 更新事件通道
 void EventLoop::updateChannel(Channel* channel) {
     assert(channel->ownerLoop()  == this);
@@ -273,7 +336,7 @@ bool EventLoop::hasChannel(Channel* channel) {
 
 // 如果创建Reactor的线程和运行Reactor的线程不同就退出进程  
 void EventLoop::abortNotInLoopThread() {
-    LOG << "EventLoop::abortNotInLoopThread - EventLoop " << this 
+    LOG_ERROR << "EventLoop::abortNotInLoopThread - EventLoop " << this 
         << " was created in threadId_ =" << threadId_
         << ", current thread id =" << currentthread::tid() << std::endl;
     abort();
@@ -287,7 +350,7 @@ void EventLoop::wakeup() {
     uint64_t one = 1;
     ssize_t n = sockets::write(wakeupFd_, &one, sizeof(one));
     if (n != sizeof(one)) {
-        LOG << "EventLoop::wakeup() writes " << n << " bytes instead of 8" << std::endl;
+        LOG_ERROR << "EventLoop::wakeup() writes " << n << " bytes instead of 8" << std::endl;
     }
 
 }
@@ -303,7 +366,36 @@ void EventLoop::handleRead() {
     uint64_t one = 1;
     ssize_t n = sockets::read(wakeupFd_, &one, sizeof(one));
     if (n != sizeof(one)) {
-        LOG << "EventLoop::handleRead() reads " << n << " bytes instead of 8" << std::endl;
+        LOG_ERROR << "EventLoop::handleRead() reads " << n << " bytes instead of 8" << std::endl;
+    }
+}
+
+// 精确定时器模式下的轮询超时时间（微秒）：到最早的定时器到期为止，最长kPollTimeMs。
+// now是上一次循环结束的时间，之后到轮询之间没有其他工作
+int64_t EventLoop::pollTimeoutUs(Timestamp now) const {
+    const int64_t kMaxTimeoutUs = static_cast<int64_t>(kPollTimeMs) * 1000;
+    Timestamp earliest = timerQueue_->earliestExpiration();
+    if (!earliest.valid()) {
+        return kMaxTimeoutUs;
+    }
+
+    int64_t timeoutUs = earliest.microSecondsSinceEpoch() - now.microSecondsSinceEpoch();
+    if (timeoutUs < 0) {
+        timeoutUs = 0;
+    }
+
+    return timeoutUs < kMaxTimeoutUs ? timeoutUs : kMaxTimeoutUs;
+}
+
+// 精确定时器模式下，每次轮询返回后执行已到期的定时器。
+// 用轮询返回时的缓存时间，处理事件期间才到期的定时器使下一次轮询的超时为0，在下一次循环里执行
+void EventLoop::handleExpiredTimers() {
+    Timestamp earliest = timerQueue_->earliestExpiration();
+    if (earliest.valid()) {
+        Timestamp now(cachedMonotonicNow_);
+        if (!(now < earliest)) {
+            timerQueue_->handleExpired(now);
+        }
     }
 }
 
@@ -318,6 +410,7 @@ void EventLoop::doPendingFunctors() {
         // 这样就不会因为长期锁住pendingFunctors_而造成阻塞了  
         MutexLockGuard lock(mutex_);
         functors.swap(pendingFunctors_);
+        pendingCount_.store(0, std::memory_order_relaxed);
     }
 
     for (size_t i = 0; i < functors.size(); ++i) {
@@ -333,7 +426,7 @@ void EventLoop::printActiveChannels() const {
     for (ChannelList::const_iterator it = activeChannels_.begin();
         it != activeChannels_.end(); ++it) {
         const Channel* ch = *it;
-        LOG << "{" << ch->reventsToString() << "}" << std::endl; 
+        LOG_TRACE << "{" << ch->reventsToString() << "}" << std::endl; 
     }
 
 }
@@ -1,6 +1,7 @@
 #ifndef KAYCC_NET_EVENTLOOP_H 
 #define KAYCC_NET_EVENTLOOP_H 
 
+#include <atomic>
 #include <vector>
 #include <boost/any.hpp>
 #include <boost/function.hpp>
@@ -41,6 +42,18 @@ namespace net {
             return pollReturnTime_;
         }
 
+        // 本次循环开始处理事件时的墙上时间，每次循环刷新一次，
+        // 只在loop线程中使用，可以接受循环粒度精度的调用者用它代替Timestamp::now()
+        Timestamp cachedNow() const {
+            return pollReturnTime_;
+        }
+
+        // 本次循环开始处理事件时的单调时间（Timestamp::monotonicNow()），每次循环刷新一次，
+        // 可以接受循环粒度精度的调用者才用它；runAfter/runEvery的计时起点仍然取当前时间，否则会提前到期
+        Timestamp cachedMonotonicNow() const {
+            return cachedMonotonicNow_;
+        }
+
         int64_t iteration() const {
             return iteration_;
         }
@@ -62,29 +75,67 @@ namespace net {
 
         size_t queueSize() const;
 
+        // 以下是给LoopSelector用的负载计数，任何线程都可以读，不加锁，读到的是近似值
+
+        // 这个loop上的TcpConnection个数（包括已经断开但还有人持有的）
+        int connectionCount() const {
+            return connectionCount_.load(std::memory_order_relaxed);
+        }
+
+        // 投递回调队列的长度，和queueSize()一样但不加锁
+        size_t pendingCount() const {
+            return pendingCount_.load(std::memory_order_relaxed);
+        }
+
+        // 最近每次循环处理事件（从poll返回到执行完投递的回调）所花时间的滑动平均，微秒
+        int64_t recentLatencyUs() const {
+            return recentLatencyUsX8_.load(std::memory_order_relaxed) / 8;
+        }
+
+        // internal usage，TcpConnection构造和析构时调用
+        void connectionCreated() {
+            connectionCount_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void connectionDestroyed() {
+            connectionCount_.fetch_sub(1, std::memory_order_relaxed);
+        }
+
     #if _cplusplus >= 201103L
         void runInLoop(const Functor&& cb);
         void queueInLoop(const Functor&& cb);
     #endif
 
+        // slack为允许定时器延迟触发的时间（秒），默认为0，即不延迟。
+        // 设置了slack的定时器的超时时间会向上对齐到slack的整数倍，相近的定时器会被合并到同一次唤醒中触发，
+        // 适合大量心跳之类对精度不敏感的周期定时器
+
+        // 定时器内部使用单调时钟，修改系统时间不会影响runAfter/runEvery
+
         // 在指定的时间调用回调函数
-        TimerId runAt(const Timestamp& time, const TimerCallback& cb);
+        TimerId runAt(const Timestamp& time, const TimerCallback& cb, double slack = 0.0);
 
         // 在delay秒之后调用回调函数 
-        TimerId runAfter(double delay, const TimerCallback& cb);
+        TimerId runAfter(double delay, const TimerCallback& cb, double slack = 0.0);
 
         // 每隔interval秒调用一次回调函数
-        TimerId runEvery(double interval, const TimerCallback& cb);
+        TimerId runEvery(double interval, const TimerCallback& cb, double slack = 0.0);
 
     #if _cplusplus >= 201103L
-        TimerId runAt(const Timestamp& time, const TimerCallback&& cb);
-        TimerId runAfter(double delay, const TimerCallback&& cb);
-        TimerId runEvery(double interval, const TimerCallback&& cb);
+        TimerId runAt(const Timestamp& time, const TimerCallback&& cb, double slack = 0.0);
+        TimerId runAfter(double delay, const TimerCallback&& cb, double slack = 0.0);
+        TimerId runEvery(double interval, const TimerCallback&& cb, double slack = 0.0);
     #endif
 
         // 取消一个计时器
         void cancel(TimerId timerId);
 
+        // 因定时器到期而唤醒的总次数
+        int64_t timerWakeups() const;
+
+        // 最近约1秒内每秒的定时器唤醒次数
+        double timerWakeupsPerSecond() const;
+
         // internal usage 内部使用
         void wakeup();
 
@@ -142,8 +193,14 @@ namespace net {
         // 执行投递的回调函数 
         void doPendingFunctors();
 
+        // 不使用timerfd时（设置了环境变量KAYCC_PRECISE_TIMER），计算轮询的超时时间并处理到期的定时器
+        int64_t pollTimeoutUs(Timestamp now) const;
+        void handleExpiredTimers();
+
         void printActiveChannels() const; // DEBUG
 
+        static Timestamp toMonotonic(const Timestamp& time);
+
         typedef std::vector<Channel*> ChannelList;
 
         // 是否正在循环中 
@@ -166,6 +223,9 @@ namespace net {
          // 轮询返回的时间
         Timestamp pollReturnTime_;
 
+        // 轮询返回时的单调时间
+        Timestamp cachedMonotonicNow_;
+
         // 轮询器 
         boost::scoped_ptr<Poller> poller_;
 
@@ -194,6 +254,11 @@ namespace net {
         // 投递的回调函数列表
         std::vector<Functor> pendingFunctors_; // @GuardedBy mutex_
 
+        // 负载计数
+        std::atomic<int> connectionCount_;
+        std::atomic<size_t> pendingCount_;   // 在mutex_里更新，可以不加锁读
+        std::atomic<int64_t> recentLatencyUsX8_; // recentLatencyUs()的8倍
+
     };
 
 }
@@ -1,6 +1,7 @@
 #include "eventloopthread.h"
 
 #include "eventloop.h"
+#include "../base/cpu_topology.h"
 
 #include <boost/bind.hpp>
 
@@ -11,9 +12,9 @@ EventLoopThread::EventLoopThread(const ThreadInitCallback& cb, const std::string
     : loop_(NULL), 
       exiting_(false),
       thread_(boost::bind(&EventLoopThread::threadFunc, this), name), //绑定线程运行函数  
-      mutex_(),
-      cond_(mutex_),
-      callback_(cb) {
+      loopStarted_(),
+      callback_(cb),
+      cpu_(-1) {
 
 }
 
@@ -34,19 +35,18 @@ EventLoop* EventLoopThread::startLoop() {
     assert(!thread_.started());
     thread_.start();
 
-    {
-        // 等待线程启动完毕 
-        MutexLockGuard lock(mutex_);
-        while (loop_ == NULL) {
-            cond_.wait();
-        }
-    }
+    // 等待线程启动完毕 
+    loopStarted_.wait();
 
     return loop_;
 }
 
 // 线程函数：用于执行EVentLoop的循环
 void EventLoopThread::threadFunc() {
+    if (cpu_ >= 0) {
+        CpuTopology::bindCurrentThread(cpu_);
+    }
+
     EventLoop loop;
 
     // 如果有初始化函数，就先调用初始化函数 
@@ -54,13 +54,10 @@ void EventLoopThread::threadFunc() {
         callback_(&loop);
     }
 
-    {
-        MutexLockGuard lock(mutex_);
-        loop_ = &loop;
+    loop_ = &loop;
 
-        // 通知startLoop线程已经启动完毕 
-        cond_.notify();
-    }
+    // 通知startLoop线程已经启动完毕，set带release语义，startLoop返回后一定能看到loop_
+    loopStarted_.set();
 
     // 事件循环
     loop.loop();
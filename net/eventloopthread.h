@@ -11,8 +11,7 @@
 （2）在该类线程函数中创建了一个EventLoop对象并调用EventLoop::loop 
 */
 
-#include "../base/condition.h"
-#include "../base/mutex.h"
+#include "../base/latch.h"
 #include "../base/thread.h"
 
 #include <boost/noncopyable.hpp>
@@ -30,6 +29,12 @@ namespace net {
         EventLoopThread(const ThreadInitCallback& cb = ThreadInitCallback(), const std::string& name = std::string());
         ~EventLoopThread();
 
+        // 把线程绑定到cpu（见CpuTopology::bindCurrentThread），在创建EventLoop之前绑定，
+        // EventLoop和Poller的内存也在cpu所在的NUMA节点上。必须在startLoop之前调用，cpu为-1时不绑定
+        void setCpuAffinity(int cpu) {
+            cpu_ = cpu;
+        }
+
         //启动成员thread_线程，该线程就成了I/O线程，内部调用thread_.start()
         EventLoop* startLoop();
 
@@ -44,14 +49,15 @@ namespace net {
 
         //基于对象，包含了一个thread类对象 
         Thread thread_;
-        MutexLock mutex_;
 
-        // 条件变量，用于exiting_变化的通知
-        Condition cond_;
+        // loop_设置好之后触发，startLoop在上面等待
+        OneShotEvent loopStarted_;
 
         //回调函数在EventLoop::loop事件循环之前被调用  
         ThreadInitCallback callback_;
 
+        int cpu_;
+
     };
 
 } //end net
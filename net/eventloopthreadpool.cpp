@@ -1,5 +1,6 @@
 #include "eventloopthreadpool.h"
 
+#include "../base/cpu_topology.h"
 #include "../base/types.h"
 #include "eventloop.h"
 #include "eventloopthread.h"
@@ -17,7 +18,8 @@ EventLoopThreadPool::EventLoopThreadPool(EventLoop* baseLoop, const std::string&
       name_(name),
       started_(false),
       numThreads_(0),
-      next_(0) {
+      next_(0),
+      pinned_(false) {
 
 }
 
@@ -32,12 +34,19 @@ void EventLoopThreadPool::start(const ThreadInitCallback& cb) {
 
     started_ = true;
 
+    if (pinned_ && cpus_.empty()) {
+        cpus_ = CpuTopology::instance().spread(numThreads_);
+    }
+
     // 创建指定数量的线程，并启动 
     for (int i = 0; i < numThreads_; ++i) {
         char buf[name_.size() + 32];
         snprintf(buf, sizeof(buf), "%s%d", name_.c_str(), i);
 
         EventLoopThread* t = new EventLoopThread(cb, buf); 
+        if (pinned_ && !cpus_.empty()) {
+            t->setCpuAffinity(cpus_[i % cpus_.size()]);
+        }
         threads_.push_back(t);
         loops_.push_back(t->startLoop());
     }
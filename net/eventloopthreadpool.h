@@ -24,6 +24,13 @@ namespace net {
             numThreads_ = numThreads;
         }
 
+        // 把IO线程绑定到CPU上，第i个线程用cpus[i % cpus.size()]；cpus为空时按CpuTopology::spread
+        // 把线程分散到不同的物理核和NUMA节点上。不调用时不绑定。必须在start之前调用
+        void setCpuAffinity(const std::vector<int>& cpus = std::vector<int>()) {
+            pinned_ = true;
+            cpus_ = cpus;
+        }
+
         // 启动线程池 
         void start(const ThreadInitCallback& cb = ThreadInitCallback());
 
@@ -57,6 +64,10 @@ namespace net {
         bool started_;
         int numThreads_;
         int next_;
+
+        // 是否绑定CPU，以及每个线程的CPU
+        bool pinned_;
+        std::vector<int> cpus_;
         boost::ptr_vector<EventLoopThread> threads_;
 
         // EventLoop对象列表
@@ -172,7 +172,7 @@ bool InetAddress::resolve(const std::string& hostname, InetAddress* out) {
         return true;
     } else {
         if (ret) {
-            LOG << "InetAddress::resolve failed: " << ret << std::endl;
+            LOG_ERROR << "InetAddress::resolve failed: " << ret << std::endl;
         }
 
         return false;
@@ -0,0 +1,116 @@
+#include "loopselector.h"
+
+#include "eventloop.h"
+
+#include <algorithm>
+
+#include <netinet/in.h>
+#include <stdio.h>
+
+using namespace kaycc;
+using namespace kaycc::net;
+
+namespace {
+    // FNV-1a
+    uint64_t hashBytes(const void* data, size_t len) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        uint64_t h = 14695981039346656037ULL;
+        for (size_t i = 0; i < len; ++i) {
+            h ^= p[i];
+            h *= 1099511628211ULL;
+        }
+
+        // FNV的低位分布不够好，再混合一次（murmur3的fmix64）
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    // 只用IP，不用端口，同一个客户端的多个连接落在同一个线程上
+    uint64_t hashPeerIp(const InetAddress& peerAddr) {
+        const struct sockaddr* sa = peerAddr.getSockAddr();
+        if (sa->sa_family == AF_INET) {
+            const struct sockaddr_in* sin = reinterpret_cast<const struct sockaddr_in*>(sa);
+            return hashBytes(&sin->sin_addr, sizeof sin->sin_addr);
+        } else {
+            const struct sockaddr_in6* sin6 = reinterpret_cast<const struct sockaddr_in6*>(sa);
+            return hashBytes(&sin6->sin6_addr, sizeof sin6->sin6_addr);
+        }
+    }
+}
+
+LoopSelector::~LoopSelector() {
+}
+
+EventLoop* RoundRobinSelector::select(const std::vector<EventLoop*>& loops, const InetAddress&) {
+    if (next_ >= loops.size()) {
+        next_ = 0;
+    }
+    return loops[next_++];
+}
+
+EventLoop* LeastLoadSelector::select(const std::vector<EventLoop*>& loops, const InetAddress&) {
+    size_t n = loops.size();
+    if (next_ >= n) {
+        next_ = 0;
+    }
+
+    size_t best = next_;
+    int64_t bestLoad = load(loops[best]);
+    for (size_t i = 1; i < n && bestLoad > 0; ++i) {
+        size_t index = (next_ + i) % n;
+        int64_t l = load(loops[index]);
+        if (l < bestLoad) {
+            best = index;
+            bestLoad = l;
+        }
+    }
+
+    next_ = best + 1;
+    return loops[best];
+}
+
+int64_t LeastConnectionsSelector::load(const EventLoop* loop) const {
+    return loop->connectionCount();
+}
+
+int64_t LeastPendingSelector::load(const EventLoop* loop) const {
+    return static_cast<int64_t>(loop->pendingCount());
+}
+
+int64_t LowestLatencySelector::load(const EventLoop* loop) const {
+    return loop->recentLatencyUs();
+}
+
+void ConsistentHashSelector::buildRing(const std::vector<EventLoop*>& loops) {
+    loops_ = loops;
+    ring_.clear();
+    ring_.reserve(loops.size() * virtualNodes_);
+    for (size_t i = 0; i < loops.size(); ++i) {
+        for (int v = 0; v < virtualNodes_; ++v) {
+            // 虚拟节点按下标命名，不用指针，重启之后同样的配置得到同样的环
+            char key[32];
+            int len = snprintf(key, sizeof key, "%zu-%d", i, v);
+            ring_.push_back(std::make_pair(hashBytes(key, len), i));
+        }
+    }
+    std::sort(ring_.begin(), ring_.end());
+}
+
+EventLoop* ConsistentHashSelector::select(const std::vector<EventLoop*>& loops, const InetAddress& peerAddr) {
+    if (loops != loops_) {
+        buildRing(loops);
+    }
+
+    // 顺时针找第一个不小于h的虚拟节点，超过最后一个时回到开头
+    uint64_t h = hashPeerIp(peerAddr);
+    std::vector<std::pair<uint64_t, size_t> >::const_iterator it =
+        std::lower_bound(ring_.begin(), ring_.end(), std::make_pair(h, static_cast<size_t>(0)));
+    if (it == ring_.end()) {
+        it = ring_.begin();
+    }
+    return loops[it->second];
+}
@@ -0,0 +1,101 @@
+#ifndef KAYCC_NET_LOOPSELECTOR_H
+#define KAYCC_NET_LOOPSELECTOR_H
+
+/*
+LoopSelector决定TcpServer把新连接交给哪个IO线程（EventLoop）。
+默认（不设置）是EventLoopThreadPool::getNextLoop()的轮询。
+连接的开销差别很大时，轮询会让各个线程负载不均，可以换成按负载选择：
+    RoundRobinSelector          轮询
+    LeastConnectionsSelector    连接数最少
+    LeastPendingSelector        投递回调队列最短
+    LowestLatencySelector       最近每次循环处理时间最短
+    ConsistentHashSelector      按对端IP一致性哈希，同一个客户端总是落在同一个线程上（会话亲和）
+负载数据来自EventLoop的connectionCount()/pendingCount()/recentLatencyUs()，都是无锁读的近似值。
+select在accept所在的线程里调用（kReusePortPerLoop模式下由内核分配，不使用LoopSelector）。
+*/
+
+#include "inetaddress.h"
+
+#include <boost/noncopyable.hpp>
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+namespace kaycc {
+namespace net {
+
+    class EventLoop;
+
+    class LoopSelector : boost::noncopyable {
+    public:
+        virtual ~LoopSelector();
+
+        // loops非空，TcpServer启动后就不再变化
+        virtual EventLoop* select(const std::vector<EventLoop*>& loops, const InetAddress& peerAddr) = 0;
+    };
+
+    class RoundRobinSelector : public LoopSelector {
+    public:
+        RoundRobinSelector()
+            : next_(0) {
+        }
+
+        virtual EventLoop* select(const std::vector<EventLoop*>& loops, const InetAddress& peerAddr);
+
+    private:
+        size_t next_;
+    };
+
+    // 按某个负载指标选最小的，相同时从上一次选中的下一个开始轮询，避免负载相同时总是选第一个
+    class LeastLoadSelector : public LoopSelector {
+    public:
+        LeastLoadSelector()
+            : next_(0) {
+        }
+
+        virtual EventLoop* select(const std::vector<EventLoop*>& loops, const InetAddress& peerAddr);
+
+    protected:
+        virtual int64_t load(const EventLoop* loop) const = 0;
+
+    private:
+        size_t next_;
+    };
+
+    class LeastConnectionsSelector : public LeastLoadSelector {
+    protected:
+        virtual int64_t load(const EventLoop* loop) const;
+    };
+
+    class LeastPendingSelector : public LeastLoadSelector {
+    protected:
+        virtual int64_t load(const EventLoop* loop) const;
+    };
+
+    class LowestLatencySelector : public LeastLoadSelector {
+    protected:
+        virtual int64_t load(const EventLoop* loop) const;
+    };
+
+    // 哈希环上每个loop有virtualNodes个虚拟节点，loop个数变化时只有约1/N的客户端换线程
+    class ConsistentHashSelector : public LoopSelector {
+    public:
+        explicit ConsistentHashSelector(int virtualNodes = 160)
+            : virtualNodes_(virtualNodes) {
+        }
+
+        virtual EventLoop* select(const std::vector<EventLoop*>& loops, const InetAddress& peerAddr);
+
+    private:
+        void buildRing(const std::vector<EventLoop*>& loops);
+
+        const int virtualNodes_;
+        std::vector<EventLoop*> loops_;                // 建环时的loops，变化时重建
+        std::vector<std::pair<uint64_t, size_t> > ring_; // (哈希值, loops下标)，按哈希值排序
+    };
+
+} //end net
+}
+
+#endif
@@ -23,6 +23,11 @@ bool Poller::hasChannel(Channel* channel) const {
     return it != channels_.end() && it->second == channel;
 }
 
+Timestamp Poller::pollPrecise(int64_t timeoutUs, ChannelList* activeChannels) {
+    int64_t timeoutMs = (timeoutUs + 999) / 1000; //向上取整，避免定时器提前唤醒后空转
+    return poll(static_cast<int>(timeoutMs), activeChannels);
+}
+
 Poller* Poller::newDefaultPoller(EventLoop* loop) {
     if (::getenv("MUDUO_USE_POLL")) {
         return new PollPoller(loop);
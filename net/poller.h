@@ -28,6 +28,11 @@ namespace net {
         // 轮询，通常是调用select、poll、epoll_wait等函数  
         virtual Timestamp poll(int timeoutMs, ChannelList* activeChannels) = 0;
 
+        /// Must be called in the loop thread.
+        // 以微秒为超时单位的轮询，用于不使用timerfd的精确定时器模式
+        // 默认实现把超时时间向上取整到毫秒后调用poll
+        virtual Timestamp pollPrecise(int64_t timeoutUs, ChannelList* activeChannels);
+
         /// Must be called in the loop thread.  
         // 更新事件处理器（通常是要处理的事件发生改变时调用）
         virtual void updateChannel(Channel* channel) = 0;
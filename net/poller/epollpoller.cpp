@@ -9,6 +9,8 @@
 #include <errno.h>
 #include <poll.h>
 #include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <time.h>
 #include <unistd.h>
 
 using namespace kaycc;
@@ -61,12 +63,17 @@ namespace {
 EPollPoller::EPollPoller(EventLoop* loop)
     : Poller(loop),
       epollfd_(::epoll_create1(EPOLL_CLOEXEC)), 
+    #ifdef SYS_epoll_pwait2
+      pwait2Supported_(true),
+    #else
+      pwait2Supported_(false),
+    #endif
       events_(kInitEventListSize) { //vector这样用时初始化kInitEventListSize个大小空间  
 
     if (epollfd_ < 0) {
-        LOG << "EPollPoller::EPollPoller failed." << std::endl;
+        LOG_ERROR << "EPollPoller::EPollPoller failed." << std::endl;
     } else {
-        LOG << "EPollPoller::EPollPoller:" << epollfd_ << std::endl;
+        LOG_DEBUG << "EPollPoller::EPollPoller:" << epollfd_ << std::endl;
     }
 
 }
@@ -76,16 +83,52 @@ EPollPoller::~EPollPoller() {
 }
 
 Timestamp EPollPoller::poll(int timeoutMs, ChannelList* activeChannels) {
-    LOG << "fd total count " << channels_.size() << std::endl;
+    LOG_TRACE << "fd total count " << channels_.size() << std::endl;
 
     int numEvents = ::epoll_wait(epollfd_,  ///使用epoll_wait()，等待事件返回,返回发生的事件数目  
                                  &*events_.begin(),
                                  static_cast<int>(events_.size()),
                                  timeoutMs);
     int savedErrno = errno;
+    return handlePollResult(numEvents, savedErrno, activeChannels);
+}
+
+// epoll_wait的超时时间只能精确到毫秒，epoll_pwait2使用timespec，可以精确到纳秒，
+// 这样定时器的超时时间就可以直接作为等待时间，不再需要timerfd
+Timestamp EPollPoller::pollPrecise(int64_t timeoutUs, ChannelList* activeChannels) {
+#ifdef SYS_epoll_pwait2
+    if (pwait2Supported_) {
+        LOG_TRACE << "fd total count " << channels_.size() << std::endl;
+
+        struct timespec ts;
+        ts.tv_sec = static_cast<time_t>(timeoutUs / Timestamp::kMicroSecondsPerSecond);
+        ts.tv_nsec = static_cast<long>((timeoutUs % Timestamp::kMicroSecondsPerSecond) * 1000);
+
+        // glibc 2.35之前没有epoll_pwait2的封装，这里直接使用系统调用，sigmask为NULL时与epoll_wait的行为一致
+        int numEvents = static_cast<int>(::syscall(SYS_epoll_pwait2,
+                                                   epollfd_,
+                                                   &*events_.begin(),
+                                                   static_cast<int>(events_.size()),
+                                                   &ts,
+                                                   NULL,
+                                                   0));
+        int savedErrno = errno;
+        if (numEvents < 0 && savedErrno == ENOSYS) { //内核版本低于5.11，以后都使用epoll_wait
+            LOG_INFO << "epoll_pwait2 is not supported, fall back to epoll_wait" << std::endl;
+            pwait2Supported_ = false;
+        } else {
+            return handlePollResult(numEvents, savedErrno, activeChannels);
+        }
+    }
+#endif
+
+    return Poller::pollPrecise(timeoutUs, activeChannels);
+}
+
+Timestamp EPollPoller::handlePollResult(int numEvents, int savedErrno, ChannelList* activeChannels) {
     Timestamp now(Timestamp::now()); //得到时间戳  
     if (numEvents > 0) {
-        std::cout << numEvents << " events happended." << std::endl;
+        LOG_TRACE << numEvents << " events happended." << std::endl;
         fillActiveChannels(numEvents, activeChannels); //调用fillActiveChannels，传入numEvents也就是发生的事件数目
 
         if (implicit_cast<size_t>(numEvents) == events_.size()) { //如果返回的事件数目等于当前事件数组大小，就分配2倍空间  
@@ -93,13 +136,13 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList* activeChannels) {
         }
 
     } else if (numEvents == 0) {
-        std::cout << "nothing happended" << std::endl;
+        LOG_TRACE << "nothing happended" << std::endl;
 
     } else {
 
         if (savedErrno != EINTR) { //如果不是EINTR信号，就把错误号保存下来，并且输入到日志中  
             errno = savedErrno;
-            std::cout << "EPollPoller::poll() error not EINTR:" << savedErrno << std::endl;
+            LOG_ERROR << "EPollPoller::poll() error not EINTR:" << savedErrno << std::endl;
         }
 
     }
@@ -130,7 +173,7 @@ void EPollPoller::fillActiveChannels(int numEvents, ChannelList* activeChannels)
 void EPollPoller::updateChannel(Channel* channel) {
     Poller::assertInLoopThread();
     const int index = channel->index();
-    LOG << "fd=" << channel->fd() << " events=" << channel->events() << " index=" << index << std::endl;
+    LOG_TRACE << "fd=" << channel->fd() << " events=" << channel->events() << " index=" << index << std::endl;
 
     if (index == kNew || index == kDeleted) {
         int fd = channel->fd();
@@ -168,7 +211,7 @@ void EPollPoller::updateChannel(Channel* channel) {
 void EPollPoller::removeChannel(Channel* channel) {
     Poller::assertInLoopThread();
     int fd = channel->fd();
-    LOG << "fd = " << fd << std::endl;
+    LOG_TRACE << "fd = " << fd << std::endl;
     assert(channels_.find(fd) != channels_.end());
     assert(channels_[fd] == channel);
     assert(channel->isNoneEvent());
@@ -194,15 +237,15 @@ void EPollPoller::update(int operation, Channel* channel) {
 
     int fd = channel->fd();
 
-    LOG << "epoll_ctl op = " << operationToString(operation)
+    LOG_TRACE << "epoll_ctl op = " << operationToString(operation)
         << " fd = " << fd << " event = { " << channel->eventsToString() << " }" << std::endl;
 
     if (::epoll_ctl(epollfd_, operation, fd, &event) < 0) {
         if (operation == EPOLL_CTL_DEL) {
-            std::cout <<  "epoll_ctl op =" << operationToString(operation) << " fd=" << fd;
+            LOG_ERROR << "epoll_ctl op =" << operationToString(operation) << " fd=" << fd << " errno=" << errno << std::endl;
             
         } else {
-            std::cout <<  "epoll_ctl op =" << operationToString(operation) << " fd=" << fd;
+            LOG_ERROR << "epoll_ctl op =" << operationToString(operation) << " fd=" << fd << " errno=" << errno << std::endl;
         }
 
     }
@@ -19,6 +19,10 @@ namespace net {
         // 轮询，通常是调用select、poll、epoll_wait等函数  
         virtual Timestamp poll(int timeoutMs, ChannelList* activeChannels);
 
+        /// Must be called in the loop thread.
+        // 使用epoll_pwait2以纳秒精度的timespec作为超时时间，内核不支持时退化为epoll_wait
+        virtual Timestamp pollPrecise(int64_t timeoutUs, ChannelList* activeChannels);
+
         /// Must be called in the loop thread.  
         // 更新事件处理器（通常是要处理的事件发生改变时调用）
         virtual void updateChannel(Channel* channel);
@@ -32,6 +36,9 @@ namespace net {
 
         static const char* operationToString(int op);
 
+        // 处理epoll_wait/epoll_pwait2的返回结果
+        Timestamp handlePollResult(int numEvents, int savedErrno, ChannelList* activeChannels);
+
         void fillActiveChannels(int numEvents, ChannelList* activeChannels) const;
 
         void update(int operation, Channel* channel);
@@ -39,6 +46,7 @@ namespace net {
         typedef std::vector<struct epoll_event> EventList;
 
         int epollfd_;
+        bool pwait2Supported_; //内核是否支持epoll_pwait2(Linux 5.11+)
         EventList events_;
             //struct epoll_event {
             //   __uint32_t   events;      /* Epoll events */
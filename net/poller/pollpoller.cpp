@@ -6,6 +6,8 @@
 #include <errno.h>
 #include <assert.h>
 #include <poll.h>
+#include <signal.h>
+#include <time.h>
 
 using namespace kaycc;
 using namespace kaycc::net;
@@ -23,16 +25,31 @@ Timestamp PollPoller::poll(int timeoutMs, ChannelList* activeChannels) {
     int numEvents = ::poll(&*pollfds_.begin(), pollfds_.size(), timeoutMs);
     int savedError = errno;
 
+    return handlePollResult(numEvents, savedError, activeChannels);
+}
+
+Timestamp PollPoller::pollPrecise(int64_t timeoutUs, ChannelList* activeChannels) {
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(timeoutUs / Timestamp::kMicroSecondsPerSecond);
+    ts.tv_nsec = static_cast<long>((timeoutUs % Timestamp::kMicroSecondsPerSecond) * 1000);
+
+    int numEvents = ::ppoll(&*pollfds_.begin(), pollfds_.size(), &ts, NULL);
+    int savedError = errno;
+
+    return handlePollResult(numEvents, savedError, activeChannels);
+}
+
+Timestamp PollPoller::handlePollResult(int numEvents, int savedError, ChannelList* activeChannels) {
     Timestamp now(Timestamp::now());
     if (numEvents > 0) {
-        LOG <<  __FILE__ << ":" << __LINE__ << ":" << __FUNCTION__ << " " << numEvents << " events happended." << std::endl;
+        LOG_TRACE << numEvents << " events happended." << std::endl;
         fillActiveChannels(numEvents, activeChannels);
     } else if (numEvents == 0) {
-        LOG << "nothing happended." << std::endl;
+        LOG_TRACE << "nothing happended." << std::endl;
     } else {
         if (savedError != EINTR) {
             errno = savedError; 
-            LOG << "PollPoller::poll error not EINTER: " << savedError << std::endl;
+            LOG_ERROR << "PollPoller::poll error not EINTER: " << savedError << std::endl;
         }
     }
 
@@ -61,7 +78,7 @@ void PollPoller::fillActiveChannels(int numEvents, ChannelList* activeChannels)
 
 void PollPoller::updateChannel(Channel* channel) {
     Poller::assertInLoopThread();
-    LOG << "fd=" << channel->fd() << " events=" << channel->events() << std::endl;;
+    LOG_TRACE << "fd=" << channel->fd() << " events=" << channel->events() << std::endl;
 
     // a new one, add to pollfds_
     if (channel->index() < 0) {
@@ -97,7 +114,7 @@ void PollPoller::updateChannel(Channel* channel) {
 
 void PollPoller::removeChannel(Channel* channel) {
     Poller::assertInLoopThread();
-    LOG << "fd=" << channel->fd() << std::endl;
+    LOG_TRACE << "fd=" << channel->fd() << std::endl;
     assert(channels_.find(channel->fd()) != channels_.end()); //删除必须能找到
     assert(channels_[channel->fd()] == channel);  //一定对应
     assert(channel->isNoneEvent()); //一定没有事件关注了
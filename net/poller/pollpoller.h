@@ -17,6 +17,10 @@ namespace net {
         // 轮询，通常是调用select、poll、epoll_wait等函数  
         virtual Timestamp poll(int timeoutMs, ChannelList* activeChannels);
 
+        /// Must be called in the loop thread.
+        // 使用ppoll，超时时间为timespec，精度可以到纳秒
+        virtual Timestamp pollPrecise(int64_t timeoutUs, ChannelList* activeChannels);
+
         /// Must be called in the loop thread.  
         // 更新事件处理器（通常是要处理的事件发生改变时调用）
         virtual void updateChannel(Channel* channel);
@@ -26,6 +30,8 @@ namespace net {
         virtual void removeChannel(Channel* channel);
 
     private:
+        Timestamp handlePollResult(int numEvents, int savedErrno, ChannelList* activeChannels);
+
         void fillActiveChannels(int numEvents, ChannelList* activeChannels) const;
 
         typedef std::vector<struct pollfd> PollFdList;
@@ -150,13 +150,13 @@ void Socket::setReusePort(bool on) {
                            &optval, static_cast<socklen_t>(sizeof(optval)));
 
     if (ret < 0 && on) {
-        LOG << "SO_REUSEPORT failed: " << ret << std::endl;
+        LOG_ERROR << "SO_REUSEPORT failed: " << ret << std::endl;
     }
 
 #else 
 
     if (on) {
-        LOG << "SO_REUSEPORT is not supported." << std::endl;
+        LOG_ERROR << "SO_REUSEPORT is not supported." << std::endl;
     }
 
 #endif
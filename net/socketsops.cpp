@@ -9,6 +9,7 @@
 #include <stdio.h> // snprintf
 #include <string.h> //bzero
 #include <unistd.h>
+#include <sys/uio.h> //readv
 #include <assert.h>
 
 using namespace kaycc;
@@ -65,7 +66,7 @@ int sockets::createNonblockingOrDie(sa_family_t family) {
 #if VALGRIND
     int sockfd = ::socket(family, SOCK_STREAM, IPPROTO_TCP);
     if (sockfd < 0) {
-        LOG << "sockets::createNonblockingOrDie faild: " << sockfd << std::endl;
+        LOG_ERROR << "sockets::createNonblockingOrDie faild: " << sockfd << std::endl;
     }
 
     //设置非阻塞和close on exec 
@@ -74,7 +75,7 @@ int sockets::createNonblockingOrDie(sa_family_t family) {
 #else
     int sockfd = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP); 
     if (sockfd < 0) {
-        LOG << "sockets::createNonblockingOrDie faild: " << sockfd << std::endl;
+        LOG_ERROR << "sockets::createNonblockingOrDie faild: " << sockfd << std::endl;
     }
 #endif
 
@@ -84,7 +85,7 @@ int sockets::createNonblockingOrDie(sa_family_t family) {
 void sockets::bindOrDie(int sockfd, const struct sockaddr* addr) {
     int ret = ::bind(sockfd, addr, static_cast<socklen_t>(sizeof(struct sockaddr_in6)));
     if (ret < 0) {
-        LOG << "sockets::bindOrDie failed: " << ret << std::endl;
+        LOG_ERROR << "sockets::bindOrDie failed: " << ret << std::endl;
     }
 
 }
@@ -92,7 +93,7 @@ void sockets::bindOrDie(int sockfd, const struct sockaddr* addr) {
 void sockets::listenOrDie(int sockfd) {
     int ret = ::listen(sockfd, SOMAXCONN); // #define SOMAXCONN   128
     if (ret < 0) {
-        LOG << "sockets::listenOrDie failed: " << ret << std::endl;
+        LOG_ERROR << "sockets::listenOrDie failed: " << ret << std::endl;
     }
 }
 
@@ -107,7 +108,7 @@ int sockets::accept(int sockfd, struct sockaddr_in6* addr) {
     if (connfd < 0) {
         //若出现下面某些错误，系统可能会改变errno number，所以先把它保存起来。
         int savedErrno = errno;
-        LOG << "accept" << std::endl;
+        LOG_TRACE << "accept" << std::endl;
 
         switch (savedErrno) {
             case EAGAIN:
@@ -127,10 +128,10 @@ int sockets::accept(int sockfd, struct sockaddr_in6* addr) {
             case ENOMEM:
             case ENOTSOCK:
             case EOPNOTSUPP:
-                LOG << "unexpected error of ::accept " << savedErrno << std::endl; //致命错误直接FATAL  
+                LOG_ERROR << "unexpected error of ::accept " << savedErrno << std::endl; //致命错误直接FATAL  
                 break;
             default:
-                LOG << "unkonwn error of ::accept " << savedErrno << std::endl;
+                LOG_ERROR << "unkonwn error of ::accept " << savedErrno << std::endl;
                 break;
         }
 
@@ -158,14 +159,14 @@ ssize_t sockets::write(int sockfd, const void* buf, size_t count) {
 // 关闭套接字 
 void sockets::close(int sockfd) {
     if (::close(sockfd) < 0) {
-        LOG << "sockets::close failed." << std::endl;
+        LOG_ERROR << "sockets::close failed." << std::endl;
     }
 }
 
 // 关闭套接字的写端 
 void sockets::shutdownWrite(int sockfd) {
     if (::shutdown(sockfd, SHUT_WR) < 0) {
-        LOG << "sockets::shutdownWrite failed." << std::endl;
+        LOG_ERROR << "sockets::shutdownWrite failed." << std::endl;
     }
 
 }
@@ -201,7 +202,7 @@ void sockets::fromIpPort(const char* ip, uint16_t port, struct sockaddr_in* addr
     addr->sin_family = AF_INET;
     addr->sin_port = hostToNetwork16(port);
     if (::inet_pton(AF_INET, ip, &addr->sin_addr) <= 0) {
-        LOG << "sockets::fromIpPort failed." << std::endl;
+        LOG_ERROR << "sockets::fromIpPort failed." << std::endl;
     }
 
 }
@@ -211,7 +212,7 @@ void sockets::fromIpPort(const char* ip, uint16_t port, struct sockaddr_in6* add
     addr->sin6_family = AF_INET6;
     addr->sin6_port = hostToNetwork16(port);
     if (::inet_pton(AF_INET6, ip, &addr->sin6_addr) <= 0) {
-        LOG << "sockets::fromIpPort failed." << std::endl;
+        LOG_ERROR << "sockets::fromIpPort failed." << std::endl;
     }
 
 }
@@ -251,7 +252,7 @@ struct sockaddr_in6 sockets::getLocalAddr(int sockfd) {
     bzero(&localaddr, sizeof(localaddr));
     socklen_t addrlen = static_cast<socklen_t>(sizeof(localaddr));
     if (::getsockname(sockfd, sockaddr_cast(&localaddr), &addrlen) < 0) {
-        LOG << "sockets::getLocalAddr failed." << std::endl;
+        LOG_ERROR << "sockets::getLocalAddr failed." << std::endl;
     }
 
     return localaddr;
@@ -263,7 +264,7 @@ struct sockaddr_in6 sockets::getPeerAddr(int sockfd) {
     bzero(&peeraddr, sizeof(peeraddr));
     socklen_t addrlen = static_cast<socklen_t>(sizeof(peeraddr));
     if (::getpeername(sockfd, sockaddr_cast(&peeraddr), &addrlen) < 0) {
-        LOG << "sockets::getPeerAddr failed." << std::endl;
+        LOG_ERROR << "sockets::getPeerAddr failed." << std::endl;
     }
 
     return peeraddr;
@@ -0,0 +1,95 @@
+#include "taskoffloader.h"
+
+#include "eventloop.h"
+#include "tcpconnection.h"
+
+#include <boost/bind.hpp>
+
+#include <assert.h>
+
+using namespace kaycc;
+using namespace kaycc::net;
+
+TaskOffloader::TaskOffloader(ThreadPool* pool, size_t lowWaterMark)
+    : pool_(pool) {
+    pool_->setLowWaterMarkCallback(boost::bind(&TaskOffloader::onPoolDrained, this), lowWaterMark);
+}
+
+TaskOffloader::~TaskOffloader() {
+    pool_->setLowWaterMarkCallback(TaskFunc(), 0);
+}
+
+size_t TaskOffloader::pendingCount() const {
+    MutexLockGuard lock(mutex_);
+    return pending_.size();
+}
+
+bool TaskOffloader::submit(const TcpConnectionPtr& conn, const TaskFunc& task) {
+    return submit(conn, boost::shared_ptr<Strand>(), task);
+}
+
+bool TaskOffloader::submit(const TcpConnectionPtr& conn, const boost::shared_ptr<Strand>& strand, const TaskFunc& task) {
+    assert(!strand || strand->pool() == pool_);
+    MutexLockGuard lock(mutex_);
+
+    // 已经有任务在排队时不能插队，直接排到后面
+    if (pending_.empty() && trySubmit(strand, task)) {
+        return true;
+    }
+
+    PendingTask pendingTask;
+    pendingTask.conn = conn;
+    pendingTask.key = keyOf(conn);
+    pendingTask.strand = strand;
+    pendingTask.task = task;
+    pending_.push_back(pendingTask);
+
+    Parked* parked = parked_.find(pendingTask.key);
+    if (parked == NULL) {
+        Parked p;
+        p.count = 0;
+        parked_.insert(pendingTask.key, p);
+        parked = parked_.find(pendingTask.key);
+    }
+
+    if (parked->count == 0 || parked->conn.lock() != conn) { //第一次暂存，或者接管了已经销毁的连接的一项
+        parked->conn = conn;
+        // 在锁内暂停，保证onPoolDrained里的恢复一定发生在暂停之后
+        conn->getLoop()->runInLoop(boost::bind(&TcpConnection::stopRead, conn));
+    }
+    ++parked->count;
+    paused_.increment();
+    return false;
+}
+
+// 在线程池的工作线程里调用。
+// submit里tryRun失败和入队都在mutex_内，这里也要加mutex_，所以不会漏掉刚暂存的任务
+void TaskOffloader::onPoolDrained() {
+    MutexLockGuard lock(mutex_);
+    while (!pending_.empty()) {
+        PendingTask& front = pending_.front();
+        TcpConnectionPtr conn(front.conn.lock());
+
+        if (conn && !trySubmit(front.strand, front.task)) { //又满了，等下一次低水位回调
+            break;
+        }
+
+        // 连接已经断开时丢弃它的任务；连接暂存的任务都重新提交了才恢复读
+        Parked* parked = parked_.find(front.key);
+        assert(parked != NULL && parked->count > 0);
+        if (--parked->count == 0) {
+            TcpConnectionPtr owner(parked->conn.lock()); //可能是接管了这一项的新连接
+            parked_.erase(front.key);
+            if (owner) {
+                owner->getLoop()->runInLoop(boost::bind(&TaskOffloader::resumeReading, owner));
+            }
+        }
+        pending_.pop_front();
+    }
+}
+
+void TaskOffloader::resumeReading(const TcpConnectionPtr& conn) {
+    if (conn->connected()) {
+        conn->startRead();
+    }
+}
@@ -0,0 +1,95 @@
+#ifndef KAYCC_NET_TASKOFFLOADER_H
+#define KAYCC_NET_TASKOFFLOADER_H
+
+#include "callbacks.h"
+#include "../base/int_hash_map.h"
+#include "../base/mutex.h"
+#include "../base/strand.h"
+#include "../base/threadpool.h"
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include <deque>
+
+/*
+IO线程把计算任务交给ThreadPool时使用，保证IO线程永远不会阻塞在ThreadPool::run上。
+submit()用tryRun提交，线程池满时：
+1.暂停该连接的读（TcpConnection::stopRead），对端的数据留在内核缓冲区里，由TCP流控反压到对端；
+2.任务暂存在本地队列里，按提交顺序排队；
+3.线程池降到低水位时（ThreadPool::setLowWaterMarkCallback），把暂存的任务重新提交，
+  一个连接暂存的任务全部重新提交之后才恢复它的读。
+一个线程池对应一个TaskOffloader，多个IO线程可以共用，所有接口都是线程安全的。
+TaskOffloader会占用线程池的低水位回调，生命期要比线程池的工作线程长。
+*/
+
+namespace kaycc {
+namespace net {
+
+    class TaskOffloader : boost::noncopyable {
+    public:
+        typedef ThreadPool::TaskFunc TaskFunc;
+
+        // pool必须设置了maxQueueSize，否则永远不会满
+        TaskOffloader(ThreadPool* pool, size_t lowWaterMark);
+        ~TaskOffloader();
+
+        // 返回true表示已经进入线程池，false表示线程池已满，任务被暂存、连接暂停读
+        bool submit(const TcpConnectionPtr& conn, const TaskFunc& task);
+
+        // 同上，但task通过strand执行（Strand::tryPost），strand必须使用这个线程池
+        bool submit(const TcpConnectionPtr& conn, const boost::shared_ptr<Strand>& strand, const TaskFunc& task);
+
+        // 暂存中的任务数
+        size_t pendingCount() const;
+
+        // 因为线程池满而暂存（同时暂停连接的读）的任务总数
+        int64_t pausedCount() const {
+            return paused_.get();
+        }
+
+        ThreadPool* pool() const {
+            return pool_;
+        }
+
+    private:
+        struct PendingTask {
+            boost::weak_ptr<TcpConnection> conn;
+            uint64_t key; //parked_的键
+            boost::shared_ptr<Strand> strand; //为NULL时直接提交到线程池
+            TaskFunc task;
+        };
+
+        bool trySubmit(const boost::shared_ptr<Strand>& strand, const TaskFunc& task) {
+            return strand ? strand->tryPost(task) : pool_->tryRun(task);
+        }
+
+        void onPoolDrained();
+        static void resumeReading(const TcpConnectionPtr& conn);
+
+        // 一个连接暂存的任务
+        struct Parked {
+            boost::weak_ptr<TcpConnection> conn;
+            int count;
+        };
+
+        // 连接对象的地址作为parked_的键。连接销毁后地址可能被新连接重用，
+        // 这时新连接接管这一项，要等旧连接暂存的任务也处理完才恢复读
+        static uint64_t keyOf(const TcpConnectionPtr& conn) {
+            return reinterpret_cast<uintptr_t>(conn.get());
+        }
+
+        ThreadPool* pool_;
+        mutable MutexLock mutex_;
+        std::deque<PendingTask> pending_;
+        IntHashMap<Parked> parked_; //count为0时删除
+
+        AtomicInt64 paused_;
+    };
+
+} //end net
+}
+
+#endif
@@ -46,13 +46,13 @@ TcpClient::TcpClient(EventLoop* loop,
     connector_->setNewConnectionCallback(
         boost::bind(&TcpClient::newConnection, this, _1));
 
-    LOG << "TcpClient::TcpClient[" << name_
+    LOG_DEBUG << "TcpClient::TcpClient[" << name_
         << "] - connector " << get_pointer(connector_) << std::endl;
 
 }
 
 TcpClient::~TcpClient() {
-    LOG << "TcpClient::~TcpClient[" << name_
+    LOG_DEBUG << "TcpClient::~TcpClient[" << name_
         << "] - connector " << get_pointer(connector_) << std::endl;
 
     TcpConnectionPtr conn;
@@ -90,7 +90,7 @@ TcpClient::~TcpClient() {
 }
 
 void TcpClient::connect() {
-    LOG << "TcpClient::connect[" << name_ << "] - connecting to "
+    LOG_INFO << "TcpClient::connect[" << name_ << "] - connecting to "
         << connector_->serverAddress().toIpPort() << std::endl;
 
     connect_ = true;
@@ -141,6 +141,7 @@ void TcpClient::newConnection(int sockfd) {
                                             localAddr,
                                             peerAddr));
 
+    conn->setKeepAlive(true);
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
@@ -170,7 +171,7 @@ void TcpClient::removeConnection(const TcpConnectionPtr& conn) {
     loop_->queueInLoop(boost::bind(&TcpConnection::connectDestroyed, conn));
 
     if (retry_ && connect_) {
-        LOG << "TcpClient::connect[" << name_ << "] - Reconnecting to "
+        LOG_INFO << "TcpClient::connect[" << name_ << "] - Reconnecting to "
             << connector_->serverAddress().toIpPort() << std::endl;
 
         //这里的重连是连接成功后断开的重连，所以实际上是重启 
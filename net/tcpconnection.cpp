@@ -9,6 +9,7 @@
 
 #include <boost/bind.hpp>
 #include <errno.h>
+#include <stdio.h> //snprintf
 
 using namespace kaycc;
 using namespace kaycc::net;
@@ -18,7 +19,7 @@ using namespace kaycc::net;
  * 默认的连接完成回调函数 
  */
 void kaycc::net::defaultConnectionCallback(const TcpConnectionPtr& conn) {
-    LOG << conn->localAddress().toIpPort() << " -> "
+    LOG_TRACE << conn->localAddress().toIpPort() << " -> "
         << conn->peerAddress().toIpPort() << " is "
         << (conn->connected() ? "UP" : "DOWN") << std::endl;
 
@@ -30,7 +31,7 @@ void kaycc::net::defaultConnectionCallback(const TcpConnectionPtr& conn) {
  * 默认的数据到来的回调函数————丢弃！所以必须要设置自己的消息回调函数 
  */  
 void kaycc::net::defaultMessageCallback(const TcpConnectionPtr& , Buffer* buffer, Timestamp) {
-    LOG << "defaultMessageCallback in" << std::endl;
+    LOG_TRACE << "defaultMessageCallback in" << std::endl;
     buffer->retrieveAll();
 }
 
@@ -40,17 +41,53 @@ TcpConnection::TcpConnection(EventLoop* loop,
                       const InetAddress& localAddr,
                       const InetAddress& peerAddr)
     : loop_(loop),
+      id_(0),
       name_(name),
       state_(kConnecting),
       reading_(true),
+      bytesReceived_(0),
+      migrating_(false),
       socket_(new Socket(sockfd)),
       channel_(new Channel(loop, sockfd)),
       localAddr_(localAddr),
       peerAddr_(peerAddr),
       highWaterMark_(64*1024*1024) { //64MB
+    init(sockfd);
+}
+
+TcpConnection::TcpConnection(EventLoop* loop,
+                      uint64_t id,
+                      const boost::shared_ptr<const std::string>& namePrefix,
+                      int sockfd,
+                      const InetAddress& localAddr,
+                      const InetAddress& peerAddr)
+    : loop_(loop),
+      id_(id),
+      namePrefix_(namePrefix),
+      state_(kConnecting),
+      reading_(true),
+      bytesReceived_(0),
+      migrating_(false),
+      socket_(new Socket(sockfd)),
+      channel_(new Channel(loop, sockfd)),
+      localAddr_(localAddr),
+      peerAddr_(peerAddr),
+      highWaterMark_(64*1024*1024) { //64MB
+    init(sockfd);
+}
+
+void TcpConnection::init(int sockfd) {
+    assert(getLoop() != NULL);
+
+    initChannel();
+
+    LOG_DEBUG << "TcpConnection::ctor[" << name() << "] at " << this
+        << " fd=" << sockfd << std::endl;
 
-    assert(loop_ != NULL);
+    getLoop()->connectionCreated();
+}
 
+void TcpConnection::initChannel() {
     channel_->setReadCallback(
         boost::bind(&TcpConnection::handleRead, this, _1));
 
@@ -62,19 +99,21 @@ TcpConnection::TcpConnection(EventLoop* loop,
 
     channel_->setErrorCallback(
         boost::bind(&TcpConnection::handleError, this));
+}
 
-    LOG << "TcpConnection::ctor[" << name << "] at " << this
-        << " fd=" << sockfd << std::endl;
-
-    socket_->setKeepAlive(true);
+void TcpConnection::formatName() const {
+    char buf[32];
+    snprintf(buf, sizeof buf, "%llu", static_cast<unsigned long long>(id_));
+    name_ = *namePrefix_ + buf;
 }
 
 TcpConnection::~TcpConnection() {
-    LOG << "TcpConnection::dtor[" << name_ << "] at " << this
+    LOG_DEBUG << "TcpConnection::dtor[" << name() << "] at " << this
         << " fd=" << channel_->fd()
         << " state=" << stateToString() << std::endl;
 
     assert(state_ == kDisconnected);
+    getLoop()->connectionDestroyed();
 }
 
 // 获取tcp信息 
@@ -97,11 +136,11 @@ void TcpConnection::send(const void* message, int len) {
 
 void TcpConnection::send(const std::string& message) {
     if (state_ == kConnected) {
-        if (loop_->isInLoopThread()) { //loop_如果是所属的io线程，就调用sendInLoop
+        if (!migrating_.load(std::memory_order_acquire) && getLoop()->isInLoopThread()) { //loop_如果是所属的io线程，就调用sendInLoop
             sendInLoop(message);
 
         } else { //loop_如果不是所属的io线程，就转入到io线程发送（ 将该functon保存在队列中，并唤醒wakeupFd_，再在eventloop循环中调用）
-            loop_->runInLoop(
+            queueInOwnerLoop(
                 boost::bind(&TcpConnection::sendInLoop,
                             this,
                             message));
@@ -112,12 +151,12 @@ void TcpConnection::send(const std::string& message) {
 
 void TcpConnection::send(Buffer* buf) {
     if (state_ == kConnected) {
-        if (loop_->isInLoopThread()) {
+        if (!migrating_.load(std::memory_order_acquire) && getLoop()->isInLoopThread()) {
             sendInLoop(buf->peek(), buf->readableBytes());
             buf->retrieveAll();
 
         } else {
-            loop_->runInLoop(
+            queueInOwnerLoop(
                 boost::bind(&TcpConnection::sendInLoop,
                             this,
                             buf->retrieveAllAsString()));
@@ -161,12 +200,12 @@ http://blog.csdn.net/freeelinux/article/details/53636117
 */
 
 void TcpConnection::sendInLoop(const void* data, size_t len) {
-    loop_->assertInLoopThread();
+    getLoop()->assertInLoopThread();
     ssize_t nwrote = 0;
     size_t remaining = len;
     bool faultError = false;
     if (state_ == kDisconnected) {
-        LOG << "disconnected, give up writing" << std::endl;
+        LOG_WARN << "disconnected, give up writing" << std::endl;
         return;
     } 
 
@@ -185,13 +224,13 @@ void TcpConnection::sendInLoop(const void* data, size_t len) {
             remaining = len - nwrote;
 
             if (remaining == 0 && writeCompleteCallback_) {
-                loop_->queueInLoop(boost::bind(writeCompleteCallback_, shared_from_this()));
+                queueInOwnerLoop(boost::bind(writeCompleteCallback_, shared_from_this()));
             }
 
         } else { // nwrote < 0
             nwrote = 0;
             if (errno != EWOULDBLOCK) {
-                LOG << "TcpConnection::sendInLoop" << std::endl;
+                LOG_ERROR << "TcpConnection::sendInLoop" << std::endl;
 
                 if (errno == EPIPE || errno == ECONNRESET) {
                     faultError = true;
@@ -209,7 +248,7 @@ void TcpConnection::sendInLoop(const void* data, size_t len) {
         if (oldLen + remaining >= highWaterMark_ //缓存中的老数据 + 这次还剩下的发送数据 >= highWaterMark_
             && oldLen < highWaterMark_
             && highWaterMarkCallback_) {
-            loop_->queueInLoop(boost::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
+            queueInOwnerLoop(boost::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
         }
 
         // 把剩余数据追加到outputbuffer，并注册POLLOUT事件 
@@ -227,13 +266,13 @@ void TcpConnection::sendInLoop(const void* data, size_t len) {
 void TcpConnection::shutdown() {
     if (state_ == kConnected) {
         setState(kDisconnecting);
-        loop_->runInLoop(boost::bind(&TcpConnection::shutdownInLoop, this));
+        runInOwnerLoop(boost::bind(&TcpConnection::shutdownInLoop, this));
     }
 }
 
 // 在循环中关闭写端
 void TcpConnection::shutdownInLoop() {
-    loop_->assertInLoopThread();
+    getLoop()->assertInLoopThread();
 
     if (!channel_->isWriting()) {
         socket_->shutdownWrite();
@@ -244,7 +283,7 @@ void TcpConnection::shutdownInLoop() {
 void TcpConnection::forceClose() {
     if (state_ == kConnected || state_ == kDisconnecting) {
         setState(kDisconnecting);
-        loop_->queueInLoop(boost::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+        queueInOwnerLoop(boost::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
     }
 
 }
@@ -253,7 +292,7 @@ void TcpConnection::forceClose() {
 void TcpConnection::forceCloseWithDelay(double seconds) {
     if (state_ == kConnected || state_ == kDisconnecting) {
         setState(kDisconnecting);
-        loop_->runAfter(
+        getLoop()->runAfter(
             seconds,
             makeWeakCallback(shared_from_this(),
                              &TcpConnection::forceClose)); //// not forceCloseInLoop to avoid race condition
@@ -262,7 +301,7 @@ void TcpConnection::forceCloseWithDelay(double seconds) {
 
 // 强制退出循环
 void TcpConnection::forceCloseInLoop() {
-    loop_->assertInLoopThread();
+    getLoop()->assertInLoopThread();
 
     if (state_ == kConnected || state_ == kDisconnecting) {
         // as if we received 0 byte in handleRead();
@@ -291,12 +330,16 @@ void TcpConnection::setTcpNoDelay(bool on) {
     socket_->setTcpNoDelay(on);
 }
 
+void TcpConnection::setKeepAlive(bool on) {
+    socket_->setKeepAlive(on);
+}
+
 void TcpConnection::startRead() {
-    loop_->runInLoop(boost::bind(&TcpConnection::startReadInLoop, this));
+    runInOwnerLoop(boost::bind(&TcpConnection::startReadInLoop, this));
 }
 
 void TcpConnection::startReadInLoop() {
-    loop_->assertInLoopThread();
+    getLoop()->assertInLoopThread();
     if (!reading_ || !channel_->isReading()) {
         channel_->enableReading(); //关注读事件
         reading_ = true;
@@ -304,11 +347,11 @@ void TcpConnection::startReadInLoop() {
 }
 
 void TcpConnection::stopRead() {
-    loop_->runInLoop(boost::bind(&TcpConnection::stopReadInLoop, this));
+    runInOwnerLoop(boost::bind(&TcpConnection::stopReadInLoop, this));
 }
 
 void TcpConnection::stopReadInLoop() {
-    loop_->assertInLoopThread();
+    getLoop()->assertInLoopThread();
     if (reading_ || channel_->isReading()) {
         channel_->disableReading();
         reading_ = false;
@@ -317,7 +360,7 @@ void TcpConnection::stopReadInLoop() {
 
 // called when TcpServer accepts a new connection   should be called only once
 void TcpConnection::connectEstablished() {
-    loop_->assertInLoopThread();
+    getLoop()->assertInLoopThread();
     assert(state_ == kConnecting);
 
     setState(kConnected);
@@ -330,7 +373,7 @@ void TcpConnection::connectEstablished() {
 
 // called when TcpServer has removed me from its map  should be called only once
 void TcpConnection::connectDestroyed() {
-    loop_->assertInLoopThread();
+    getLoop()->assertInLoopThread();
 
     if (state_ == kConnected) {
         setState(kDisconnected);
@@ -342,20 +385,146 @@ void TcpConnection::connectDestroyed() {
     channel_->remove();
 }
 
+void TcpConnection::runInOwnerLoop(const Functor& cb) {
+    if (!migrating_.load(std::memory_order_acquire) && getLoop()->isInLoopThread()) {
+        cb();
+    } else {
+        queueInOwnerLoop(cb);
+    }
+}
+
+void TcpConnection::queueInOwnerLoop(const Functor& cb) {
+    MutexLockGuard lock(migrateMutex_);
+    if (migrating_.load(std::memory_order_relaxed)) {
+        inTransit_.push_back(cb);
+    } else {
+        // 在锁里排队：不会排到finishMigrateInLoop后面去，那时连接已经不属于这个线程了
+        getLoop()->queueInLoop(cb);
+    }
+}
+
+void TcpConnection::migrateTo(EventLoop* newLoop,
+                              const MigrateDetachCallback& detached,
+                              const MigrateDoneCallback& done) {
+    assert(newLoop != NULL);
+    queueInOwnerLoop(boost::bind(&TcpConnection::migrateInLoop, shared_from_this(), newLoop, detached, done));
+}
+
+/*
+迁移分三步，每一步都在连接当时所在的线程里：
+    1. migrateInLoop（原线程）：设置migrating_，之后从任何线程来的调用都保存到inTransit_；
+       再把finishMigrateInLoop排到原线程的队列末尾，让设置migrating_之前已经排队的函数先在原线程里执行完。
+    2. finishMigrateInLoop（原线程）：把Channel从原来的Poller里移除，换成新线程的Channel（读写事件先不注册），
+       然后修改loop_，把attachInLoop排到新线程。
+    3. attachInLoop（新线程）：按reading_和outputBuffer_重新注册读写事件，清除migrating_，执行inTransit_里的函数。
+*/
+void TcpConnection::migrateInLoop(EventLoop* newLoop,
+                                  const MigrateDetachCallback& detached,
+                                  const MigrateDoneCallback& done) {
+    EventLoop* loop = getLoop();
+    loop->assertInLoopThread();
+
+    if (state_ != kConnected || newLoop == loop) {
+        if (done) {
+            done(shared_from_this(), false);
+        }
+        return;
+    }
+
+    MutexLockGuard lock(migrateMutex_);
+    if (migrating_.load(std::memory_order_relaxed)) { //前一次迁移还没完成，等它完成后在新线程里再迁移
+        inTransit_.push_back(
+            boost::bind(&TcpConnection::migrateInLoop, shared_from_this(), newLoop, detached, done));
+        return;
+    }
+
+    migrating_.store(true, std::memory_order_release);
+    loop->queueInLoop(
+        boost::bind(&TcpConnection::finishMigrateInLoop, shared_from_this(), newLoop, detached, done));
+}
+
+void TcpConnection::finishMigrateInLoop(EventLoop* newLoop,
+                                        const MigrateDetachCallback& detached,
+                                        const MigrateDoneCallback& done) {
+    EventLoop* loop = getLoop();
+    loop->assertInLoopThread();
+
+    if (state_ != kConnected) { //排队期间连接关闭了
+        endMigration(done, false);
+        return;
+    }
+
+    TcpConnectionPtr guardThis(shared_from_this());
+    if (detached) {
+        detached(guardThis);
+    }
+
+    channel_->disableAll();
+    channel_->remove();
+
+    // Channel属于某一个EventLoop，换一个新的，回调函数不变
+    boost::scoped_ptr<Channel> channel(new Channel(newLoop, socket_->fd()));
+    channel_.swap(channel);
+    initChannel();
+    channel_->tie(guardThis);
+
+    loop->connectionDestroyed();
+    newLoop->connectionCreated();
+
+    loop_.store(newLoop, std::memory_order_release);
+    newLoop->queueInLoop(boost::bind(&TcpConnection::attachInLoop, guardThis, done));
+}
+
+void TcpConnection::attachInLoop(const MigrateDoneCallback& done) {
+    getLoop()->assertInLoopThread();
+
+    if (state_ != kDisconnected) {
+        if (reading_) {
+            channel_->enableReading();
+        }
+        if (outputBuffer_.readableBytes() > 0) {
+            channel_->enableWriting();
+        }
+    }
+
+    endMigration(done, true);
+}
+
+void TcpConnection::endMigration(const MigrateDoneCallback& done, bool migrated) {
+    getLoop()->assertInLoopThread();
+
+    std::vector<Functor> functors;
+    {
+        MutexLockGuard lock(migrateMutex_);
+        functors.swap(inTransit_);
+        migrating_.store(false, std::memory_order_release);
+    }
+
+    // 先通知（TcpServer在这里把连接加入新线程的连接表），inTransit_里可能有forceClose
+    if (done) {
+        done(shared_from_this(), migrated);
+    }
+
+    for (size_t i = 0; i < functors.size(); ++i) {
+        functors[i]();
+    }
+}
+
 // 处理读
 void TcpConnection::handleRead(Timestamp receiveTime) {
-    loop_->assertInLoopThread();
+    getLoop()->assertInLoopThread();
     int savedErrno = 0;
 
     ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
     if (n > 0) {
+        bytesReceived_ += n;
          // 调用用户的数据到来回调函数
         messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
     } else if (n == 0) {
         handleClose(); //对方关闭socket，发送fin，关闭连接
     } else {
         errno = savedErrno;
-        LOG << "TcpConnection::handleRead" << std::endl;
+        LOG_ERROR << "TcpConnection::handleRead" << std::endl;
         handleError();
     }
 
@@ -363,7 +532,7 @@ void TcpConnection::handleRead(Timestamp receiveTime) {
 
 // 处理写
 void TcpConnection::handleWrite() {
-    loop_->assertInLoopThread();
+    getLoop()->assertInLoopThread();
     if (channel_->isWriting()) {
         ssize_t n = sockets::write(channel_->fd(),
                                   outputBuffer_.peek(),
@@ -378,7 +547,7 @@ void TcpConnection::handleWrite() {
                 channel_->disableWriting();
                 if (writeCompleteCallback_) {
                     // 调用用户的写完成回调函数
-                    loop_->queueInLoop(boost::bind(writeCompleteCallback_, shared_from_this()));
+                    queueInOwnerLoop(boost::bind(writeCompleteCallback_, shared_from_this()));
                 }
 
                 // 如果当前状态是正在关闭连接  
@@ -389,20 +558,20 @@ void TcpConnection::handleWrite() {
             }
 
         } else { //n <= 0   写入错误
-            LOG << "TcpConnection::handleWrite failed: " << n << std::endl;
+            LOG_ERROR << "TcpConnection::handleWrite failed: " << n << std::endl;
 
         }
 
     } else {
-        LOG << "Connection fd =" << channel_->fd()
+        LOG_TRACE << "Connection fd =" << channel_->fd()
             << " is down, no more writing" << std::endl;
     }
 }
 
 // 处理关闭
 void TcpConnection::handleClose() {
-    loop_->assertInLoopThread();
-    LOG << "fd = " << channel_->fd() << " state = " << stateToString() << std::endl;
+    getLoop()->assertInLoopThread();
+    LOG_TRACE << "fd = " << channel_->fd() << " state = " << stateToString() << std::endl;
 
     assert(state_ == kConnected || state_ == kDisconnecting);
     // we don't close fd, leave it to dtor, so we can find leaks easily.
@@ -418,7 +587,7 @@ void TcpConnection::handleClose() {
 // 处理错误 
 void TcpConnection::handleError() {
     int err = sockets::getSocketError(channel_->fd());
-    LOG << "TcpConnection::handleError [" << name_
+    LOG_ERROR << "TcpConnection::handleError [" << name()
         << "] - SO_ERROR = " << err << std::endl;
 
 }
\ No newline at end of file
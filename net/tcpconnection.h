@@ -4,8 +4,15 @@
 #include "callbacks.h"
 #include "buffer.h"
 #include "inetaddress.h"
+#include "../base/mutex.h"
+
+#include <atomic>
+#include <mutex> //std::call_once
+#include <stdint.h>
+#include <vector>
 
 #include <boost/any.hpp>
+#include <boost/function.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/shared_ptr.hpp>
@@ -24,6 +31,11 @@ TcpConnection中封装了inputBuffer和outputBuffer，用来表示应用层的
 
 调用send时，可能不是TcpConnection所属的IO线程，这是通过loop_->runInLoop可以轮转到其所属的IO线程。因为TcpConnection中保存了其所属EventLoop的指针，可以通过EventLoop::runInLoop将所调用的函数添加到所属EventLoop的任务队列中。
 
+迁移：
+migrateTo把已经建立的连接交给另一个EventLoop。在原来的线程里把Channel从Poller里移除，换成属于新线程的Channel，
+再到新线程里重新注册读写事件，inputBuffer、outputBuffer、回调函数和上下文都不变。迁移期间从任何线程调用的send、shutdown等
+先保存在inTransit_里，到了新线程再按顺序执行，所以数据不会乱序。
+
 断开连接： 
 TcpConnection的断开是采用被动方式，即对方先关闭连接，本地read(2)返回0后，调用顺序如下： 
 handleClose()->TcpServer::removeConnection->TcpConnection::connectDestroyed()。
@@ -105,13 +117,31 @@ namespace net {
                       const InetAddress& localAddr,
                       const InetAddress& peerAddr);
 
+        // TcpServer用：只保存id，名字（namePrefix + id）在第一次调用name()时才格式化，
+        // 多数连接从来不需要名字（不打开DEBUG日志时），建立连接时就不用分配和格式化字符串
+        TcpConnection(EventLoop* loop,
+                      uint64_t id,
+                      const boost::shared_ptr<const std::string>& namePrefix,
+                      int sockfd,
+                      const InetAddress& localAddr,
+                      const InetAddress& peerAddr);
+
         ~TcpConnection();
 
+        // 连接迁移后会变化，用来判断isInLoopThread总是正确的
         EventLoop* getLoop() const {
-            return loop_;
+            return loop_.load(std::memory_order_acquire);
+        }
+
+        // TcpServer里从1开始，在同一个TcpServer里唯一；用名字构造的连接为0
+        uint64_t id() const {
+            return id_;
         }
 
         const std::string& name() const {
+            if (namePrefix_) {
+                std::call_once(nameOnce_, &TcpConnection::formatName, this);
+            }
             return name_;
         }
 
@@ -154,6 +184,9 @@ namespace net {
         // 关闭或开启Nagle算法  
         void setTcpNoDelay(bool on);
 
+        // 关闭或开启保活机制。TcpServer的连接从监听套接字继承了SO_KEEPALIVE，不用再设置
+        void setKeepAlive(bool on);
+
         void startRead();
 
         void stopRead();
@@ -206,6 +239,23 @@ namespace net {
             closeCallback_ = cb;
         }
 
+        // 迁移过程中的回调，连接在它所在的线程里调用
+        // detached: 在原来的线程里，Channel已经不再处理事件、getLoop()还没有改变时调用
+        // done: 成功时在新线程里调用（migrated为true），连接已经不是kConnected等原因放弃时在原来的线程里调用（false）
+        typedef boost::function<void (const TcpConnectionPtr&)> MigrateDetachCallback;
+        typedef boost::function<void (const TcpConnectionPtr&, bool migrated)> MigrateDoneCallback;
+
+        // 把连接迁移到newLoop，线程安全，总是排队到连接当前的线程执行，不会在事件处理的中途切换。
+        // TcpServer的连接要用TcpServer::migrateConnection，它负责更新连接表
+        void migrateTo(EventLoop* newLoop,
+                       const MigrateDetachCallback& detached = MigrateDetachCallback(),
+                       const MigrateDoneCallback& done = MigrateDoneCallback());
+
+        // 累计收到的字节数，在连接所在的线程里读
+        uint64_t bytesReceived() const {
+            return bytesReceived_;
+        }
+
         // called when TcpServer accepts a new connection   should be called only once
         void connectEstablished();
 
@@ -248,11 +298,42 @@ namespace net {
         void startReadInLoop();
         void stopReadInLoop();
 
-        EventLoop* loop_;
-        const std::string name_;
+        typedef boost::function<void ()> Functor;
+
+        // 在连接所在的线程里执行cb：已经在这个线程里、并且没有在迁移时直接执行，否则排队
+        void runInOwnerLoop(const Functor& cb);
+        // 排队到连接所在的线程，迁移期间先保存在inTransit_里
+        void queueInOwnerLoop(const Functor& cb);
+
+        void migrateInLoop(EventLoop* newLoop,
+                           const MigrateDetachCallback& detached,
+                           const MigrateDoneCallback& done);
+        void finishMigrateInLoop(EventLoop* newLoop,
+                                 const MigrateDetachCallback& detached,
+                                 const MigrateDoneCallback& done);
+        void attachInLoop(const MigrateDoneCallback& done);
+        // 迁移结束（或者放弃），执行迁移期间保存的函数
+        void endMigration(const MigrateDoneCallback& done, bool migrated);
+
+        void init(int sockfd);
+        void initChannel();
+        void formatName() const;
+
+        std::atomic<EventLoop*> loop_;   //只在所在的线程里修改（迁移）
+        const uint64_t id_;
+        const boost::shared_ptr<const std::string> namePrefix_; //不为NULL时name_延迟格式化
+        mutable std::once_flag nameOnce_;
+        mutable std::string name_;
 
         StateE state_;
         bool reading_;
+        uint64_t bytesReceived_;
+
+        // 迁移状态：migrating_只在连接所在的线程里修改（加锁），可以不加锁读；
+        // 修改migrating_和往loop_排队都在migrateMutex_里进行，排队的函数和迁移之间的先后顺序是确定的
+        MutexLock migrateMutex_;
+        std::atomic<bool> migrating_;
+        std::vector<Functor> inTransit_; // @GuardedBy migrateMutex_
 
         boost::scoped_ptr<Socket> socket_;
 
@@ -282,7 +363,7 @@ namespace net {
         boost::any context_;
 
         // FIXME: creationTime_, lastReceiveTime_
-        // bytesReceived_, bytesSent_ 
+        // bytesSent_ 
 
     };
 
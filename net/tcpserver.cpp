@@ -3,16 +3,111 @@
 #include "acceptor.h"
 #include "eventloop.h"
 #include "eventloopthreadpool.h"
+#include "loopselector.h"
 #include "socketsops.h"
+#include "taskoffloader.h"
+#include "../base/latch.h"
 #include "../base/log.h"
+#include "../base/strand.h"
 
 #include <boost/bind.hpp>
 
-#include <stdio.h> // snprintf
+#include <algorithm>
 
 using namespace kaycc;
 using namespace kaycc::net;
 
+namespace {
+    // setMessageThreadPool模式下每个连接的状态
+    struct StrandContext : boost::noncopyable {
+        StrandContext(ThreadPool* pool, TaskOffloader* o)
+            : strand(Strand::create(pool)),
+              offloader(o),
+              posted(false) {
+        }
+
+        boost::shared_ptr<Strand> strand;
+        TaskOffloader* offloader;
+
+        MutexLock mutex;
+        Buffer pending;          //IO线程收到、还没有交给Strand的数据，受mutex保护
+        Timestamp receiveTime;   //最近一次收到数据的时间，受mutex保护
+        bool posted;             //已经提交了回调、还没有取走pending，受mutex保护
+
+        Buffer work;             //只在Strand里访问，用户回调没取走的数据留在这里
+    };
+
+    typedef boost::shared_ptr<StrandContext> StrandContextPtr;
+
+    // 在Strand里执行
+    void runMessageCallback(const StrandContextPtr& ctx, const MessageCallback& cb, const TcpConnectionPtr& conn) {
+        Timestamp receiveTime;
+        {
+            MutexLockGuard lock(ctx->mutex);
+            ctx->posted = false; //之后收到的数据要再提交一次回调
+            if (ctx->pending.readableBytes() == 0) {
+                return;
+            }
+
+            if (ctx->work.readableBytes() == 0) {
+                ctx->work.swap(ctx->pending);
+            } else {
+                ctx->work.append(ctx->pending.peek(), ctx->pending.readableBytes());
+                ctx->pending.retrieveAll();
+            }
+            receiveTime = ctx->receiveTime;
+        }
+
+        cb(conn, &ctx->work, receiveTime);
+    }
+
+    // 在IO线程里执行，把inputBuffer里的数据转移到pending，尽量用swap避免拷贝。
+    // 已经有回调在排队时只追加数据，由那个回调一起处理
+    void dispatchMessage(const StrandContextPtr& ctx, const MessageCallback& cb,
+                         const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime) {
+        {
+            MutexLockGuard lock(ctx->mutex);
+            if (ctx->pending.readableBytes() == 0) {
+                ctx->pending.swap(*buf);
+            } else {
+                ctx->pending.append(buf->peek(), buf->readableBytes());
+                buf->retrieveAll();
+            }
+            ctx->receiveTime = receiveTime;
+            if (ctx->posted) {
+                return;
+            }
+            ctx->posted = true;
+        }
+
+        // 不阻塞IO线程：线程池满时回调被暂存，连接暂停读，数据留在内核缓冲区里，pending不会继续增长
+        ctx->offloader->submit(conn, ctx->strand, boost::bind(&runMessageCallback, ctx, cb, conn));
+    }
+
+    // 每次再平衡最多迁移的连接数
+    const int kMaxMigrationsPerRound = 64;
+
+    // kRebalanceLatency时，两个线程的处理时间相差不到这么多（微秒）就不迁移
+    const int64_t kMinLatencyGapUs = 100;
+
+    bool moreBytesReceived(const TcpConnectionPtr& lhs, const TcpConnectionPtr& rhs) {
+        return lhs->bytesReceived() > rhs->bytesReceived();
+    }
+
+    // 收集还没有断开的连接，作为迁移的候选
+    void collectConnected(std::vector<TcpConnectionPtr>* candidates, const TcpConnectionPtr& conn) {
+        if (conn->connected()) {
+            candidates->push_back(conn);
+        }
+    }
+
+    // Acceptor必须在它自己的线程里析构（要从Poller里移除Channel）
+    void destroyAcceptor(Acceptor* acceptor, Latch* latch) {
+        delete acceptor;
+        latch->countDown();
+    }
+}
+
 
 TcpServer::TcpServer(EventLoop* loop,
                     const InetAddress& listenAddr,
@@ -21,33 +116,75 @@ TcpServer::TcpServer(EventLoop* loop,
     : loop_(loop),
       ipPort_(listenAddr.toIpPort()),
       name_(name),
-      acceptor_(new Acceptor(loop, listenAddr, option == kReusePort)),
+      listenAddr_(listenAddr),
+      option_(option),
+      acceptor_(new Acceptor(loop, listenAddr, option != kNoReusePort)),
+      acceptBatch_(Acceptor::kDefaultAcceptBatch),
+      tcpNoDelay_(false),
       threadPool_(new EventLoopThreadPool(loop, name_)),
       connectionCallback_(defaultConnectionCallback),
       messageCallback_(defaultMessageCallback),
-      nextConnId_(1) {
+      messagePool_(NULL),
+      connNamePrefix_(new std::string(name_ + "-" + ipPort_ + "#")),
+      rebalanceInterval_(0.0),
+      rebalanceMetric_(kRebalanceConnections),
+      rebalanceImbalance_(0.0),
+      migrationMutex_(),
+      migrationsDone_(migrationMutex_) {
 
     acceptor_->setNewConnectionCallback(
-        boost::bind(&TcpServer::newConnection, this, _1, _2));
+        boost::bind(&TcpServer::newConnection, this, _1, _2, _3));
 
 }
 
 TcpServer::~TcpServer() {
     loop_->assertInLoopThread();
-    LOG << "cpServer::~TcpServer [" << name_ << "] destructing" << std::endl;
+    LOG_INFO << "TcpServer::~TcpServer [" << name_ << "] destructing" << std::endl;
 
-     // 断开每一个连接 
-    for (ConnectionMap::iterator it(connections_.begin()); 
-        it != connections_.end(); ++it) {
+    if (rebalanceInterval_ > 0.0) {
+        loop_->cancel(rebalanceTimer_);
+    }
+
+    // 先停止各个IO线程的accept，等它们的Acceptor都析构完，之后不会再有新连接
+    if (!loopAcceptors_.empty()) {
+        Latch latch(static_cast<int>(loopAcceptors_.size()));
+        for (size_t i = 0; i < loopAcceptors_.size(); ++i) {
+            loopAcceptors_[i]->getLoop()->runInLoop(
+                boost::bind(&destroyAcceptor, loopAcceptors_[i], &latch));
+        }
+        latch.wait();
+        loopAcceptors_.clear();
+    }
 
-        TcpConnectionPtr conn(it->second);
-        it->second.reset();
+    // 迁移中的连接不在任何分片里，等它们到达新线程的连接表
+    {
+        MutexLockGuard lock(migrationMutex_);
+        while (migrationsInFlight_.get() > 0) {
+            migrationsDone_.wait();
+        }
+    }
 
-        // 销毁连接
-        conn->getLoop()->runInLoop(
-            boost::bind(&TcpConnection::connectDestroyed, conn)); 
+     // 断开每一个连接，每个分片在自己的线程里处理，等全部完成后IO线程不会再回调TcpServer
+    Latch latch(static_cast<int>(shards_.size()));
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        shards_[i].loop->runInLoop(
+            boost::bind(&TcpServer::destroyShardInLoop, this, i, &latch));
     }
+    latch.wait();
+
+}
 
+void TcpServer::destroyShardInLoop(size_t index, Latch* latch) {
+    Shard& shard = shards_[index];
+    shard.loop->assertInLoopThread();
+
+    ConnectionMap connections;
+    connections.swap(shard.connections);
+
+    // 销毁连接
+    connections.forEach(boost::bind(&TcpConnection::connectDestroyed, _2));
+
+    latch->countDown();
 }
 
 void TcpServer::setThreadNum(int numThreads) {
@@ -55,15 +192,90 @@ void TcpServer::setThreadNum(int numThreads) {
     threadPool_->setThreadNum(numThreads);
 }
 
+void TcpServer::setCpuAffinity(const std::vector<int>& cpus) {
+    assert(started_.get() == 0);
+    threadPool_->setCpuAffinity(cpus);
+}
+
+void TcpServer::setLoopSelector(const boost::shared_ptr<LoopSelector>& selector) {
+    assert(started_.get() == 0);
+    loopSelector_ = selector;
+}
+
+void TcpServer::setAcceptBatch(int batch) {
+    assert(started_.get() == 0);
+    acceptBatch_ = batch;
+    acceptor_->setAcceptBatch(batch);
+}
+
+void TcpServer::setMessageThreadPool(ThreadPool* pool, size_t lowWaterMark) {
+    assert(started_.get() == 0);
+    messagePool_ = pool;
+    messageOffloader_.reset(pool != NULL ? new TaskOffloader(pool, lowWaterMark) : NULL);
+}
+
+void TcpServer::setTcpNoDelay(bool on) {
+    assert(started_.get() == 0);
+    tcpNoDelay_ = on;
+    acceptor_->setTcpNoDelay(on);
+}
+
+void TcpServer::setRebalance(double intervalSeconds, RebalanceMetric metric, double imbalance) {
+    assert(started_.get() == 0);
+    assert(intervalSeconds > 0.0 && imbalance >= 0.0);
+    rebalanceInterval_ = intervalSeconds;
+    rebalanceMetric_ = metric;
+    rebalanceImbalance_ = imbalance;
+}
+
 void TcpServer::start() {
     if (started_.getAndSet(1) == 0) { //设置为1，返回之前的值,以后都为1就不会进入if语句  
         threadPool_->start(threadInitCallback_);
 
         assert(!acceptor_->listenning());
-        loop_->runInLoop(
-            boost::bind(&Acceptor::listen, get_pointer(acceptor_))); //get_pointer(acceptor_) 返回acceptor_.get()
+        loop_->runInLoop(boost::bind(&TcpServer::listenInLoop, this));
+    }
+
+}
+
+void TcpServer::listenInLoop() {
+    loop_->assertInLoopThread();
+    ioLoops_ = threadPool_->getAllLoops();
+    shards_.resize(ioLoops_.size());
+    for (size_t i = 0; i < ioLoops_.size(); ++i) {
+        shards_[i].loop = ioLoops_[i];
+    }
+
+    if (option_ == kReusePortPerLoop) {
+        startLoopAcceptors();
+    } else {
+        acceptor_->listen();
+    }
+
+    if (rebalanceInterval_ > 0.0) {
+        rebalanceTimer_ = loop_->runEvery(rebalanceInterval_, boost::bind(&TcpServer::rebalance, this));
+    }
+}
+
+void TcpServer::startLoopAcceptors() {
+    loop_->assertInLoopThread();
+    const std::vector<EventLoop*>& loops = ioLoops_;
+    if (loops.size() == 1 && loops[0] == loop_) { //没有IO线程
+        acceptor_->listen();
+        return;
     }
 
+    // acceptor_只用来在构造时绑定端口（端口被占用时尽早失败），不监听，
+    // 内核只会把连接分给处于listen状态的套接字
+    for (size_t i = 0; i < loops.size(); ++i) {
+        Acceptor* acceptor = new Acceptor(loops[i], listenAddr_, true);
+        acceptor->setAcceptBatch(acceptBatch_);
+        acceptor->setTcpNoDelay(tcpNoDelay_);
+        acceptor->setNewConnectionCallback(
+            boost::bind(&TcpServer::newConnectionInLoop, this, loops[i], _1, _2, _3));
+        loopAcceptors_.push_back(acceptor);
+        loops[i]->runInLoop(boost::bind(&Acceptor::listen, acceptor));
+    }
 }
 
 /*
@@ -75,67 +287,192 @@ TcpServer对客端而言就是一个服务器，客端使用TcpServer自然会
 
 /// Not thread safe, but in loop
 /// 新连接到来回调函数
-void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr) {
+void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr, const InetAddress& localAddr) {
     loop_->assertInLoopThread();
-    EventLoop* ioLoop = threadPool_->getNextLoop();
-
-    char buf[64];
-    snprintf(buf, sizeof(buf), "-%s#%d", ipPort_.c_str(), nextConnId_); ////端口+连接id 
-    ++nextConnId_; //++之后就是下一个连接id 
-
-    std::string connName = name_ + buf;
-    LOG << "TcpServer::newConnection [" << name_
-        << "] - new connection [" << connName
-        << "] from " << peerAddr.toIpPort() << std::endl;
+    EventLoop* ioLoop = loopSelector_ ? loopSelector_->select(ioLoops_, peerAddr) : threadPool_->getNextLoop();
+    newConnectionInLoop(ioLoop, sockfd, peerAddr, localAddr);
+}
 
-    InetAddress localAddr(sockets::getLocalAddr(sockfd));
+// kReusePortPerLoop时在ioLoop里调用，否则在baseLoop里调用
+void TcpServer::newConnectionInLoop(EventLoop* ioLoop, int sockfd,
+                                    const InetAddress& peerAddr, const InetAddress& localAddr) {
+    uint64_t connId = nextConnId_.incrementAndGet(); //从1开始
 
-    TcpConnectionPtr conn(new TcpConnection(ioLoop, // //创建一个连接对象，ioLoop是round-robin选择出来的  
-                                            connName,
+    //创建一个连接对象，ioLoop是LoopSelector（默认round-robin）选择出来的
+    //名字是 name-ip:port#id，用到时才格式化
+    TcpConnectionPtr conn(new TcpConnection(ioLoop,
+                                            connId,
+                                            connNamePrefix_,
                                             sockfd,
                                             localAddr,
                                             peerAddr));
 
-    //TcpConnection的引用计数此处为1，新建了一个Tcpconnection  
-    connections_[connName] = conn;
-    //TcpConnection的引用计数此处为2，因为加入到connections_中
+    LOG_DEBUG << "TcpServer::newConnection [" << name_
+        << "] - new connection [" << conn->name()
+        << "] from " << peerAddr.toIpPort() << std::endl;
 
     ////实际TcpServer的connectionCallback等回调函数是对conn的回调函数的封装，所以在这里设置过去 
     conn->setConnectionCallback(connectionCallback_);
-    conn->setMessageCallback(messageCallback_);
+    if (messagePool_) {
+        StrandContextPtr ctx(new StrandContext(messagePool_, messageOffloader_.get()));
+        conn->setMessageCallback(boost::bind(&dispatchMessage, ctx, messageCallback_, _1, _2, _3));
+    } else {
+        conn->setMessageCallback(messageCallback_);
+    }
     conn->setWriteCompleteCallback(writeCompleteCallback_);
 
     //将TcpServer的removeConnection设置了TcpConnection的关闭回调函数中
+    //~TcpServer会等所有IO线程销毁完连接，之后不会再有关闭回调
     conn->setCloseCallback(
-        boost::bind(&TcpServer::removeConnection, this, _1)); // FIXME: unsafe 
+        boost::bind(&TcpServer::removeConnection, this, _1));
 
-    ioLoop->runInLoop(boost::bind(&TcpConnection::connectEstablished, conn));
-    //调用TcpConenction:;connectEstablished函数内部会将引用计数加一然后减一，此处仍为2  
-    //但是本函数介绍结束后conn对象会析构掉，所以引用计数为1，仅剩connections_列表中存活一个  
+    ioLoop->runInLoop(boost::bind(&TcpServer::connectionEstablishedInLoop, this, conn)); //kReusePortPerLoop时直接执行
+    //本函数结束后conn只剩下连接表里的一个引用
 }
 
-/// Thread safe.
-/// 删除连接
-void TcpServer::removeConnection(const TcpConnectionPtr& conn) {
-    loop_->runInLoop(boost::bind(&TcpServer::removeConnectionInLoop, this, conn));
+void TcpServer::connectionEstablishedInLoop(const TcpConnectionPtr& conn) {
+    conn->getLoop()->assertInLoopThread();
+    bool inserted = shardOf(conn->getLoop()).connections.insert(conn->id(), conn);
+    (void)inserted;
+    assert(inserted);
+    conn->connectEstablished();
 }
 
+TcpServer::Shard& TcpServer::shardOf(EventLoop* ioLoop) {
+    // IO线程一般不多，顺序查找就够了
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        if (shards_[i].loop == ioLoop) {
+            return shards_[i];
+        }
+    }
+    assert(false);
+    return shards_[0];
+}
 
 /// Not thread safe, but in loop
-void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn) {
-    loop_->assertInLoopThread();
+/// 删除连接
+void TcpServer::removeConnection(const TcpConnectionPtr& conn) {
+    EventLoop* ioLoop = conn->getLoop();
+    ioLoop->assertInLoopThread();
 
-    LOG << "TcpServer::removeConnectionInLoop [" << name_
+    LOG_DEBUG << "TcpServer::removeConnection [" << name_
         << "] - connection " << conn->name() << std::endl;
 
-    size_t n = connections_.erase(conn->name());
-    (void)n;
-    assert(n == 1);
-
-    EventLoop* ioLoop = conn->getLoop();
+    bool erased = shardOf(ioLoop).connections.erase(conn->id());
+    (void)erased;
+    assert(erased);
 
+    // 现在是在这个连接的Channel的事件处理中，不能直接销毁，放到这一轮循环的最后
     ioLoop->queueInLoop(
         boost::bind(&TcpConnection::connectDestroyed, conn));
 }
 
+void TcpServer::migrateConnection(const TcpConnectionPtr& conn, EventLoop* ioLoop) {
+    assert(std::find(ioLoops_.begin(), ioLoops_.end(), ioLoop) != ioLoops_.end());
+    if (ioLoops_.size() < 2) { //没有IO线程，只有baseLoop
+        return;
+    }
+
+    migrationsInFlight_.increment();
+    conn->migrateTo(ioLoop,
+                    boost::bind(&TcpServer::connectionDetachedInLoop, this, _1),
+                    boost::bind(&TcpServer::connectionMigratedInLoop, this, _1, _2));
+}
+
+// 在原来的线程里，连接已经不再处理事件
+void TcpServer::connectionDetachedInLoop(const TcpConnectionPtr& conn) {
+    EventLoop* ioLoop = conn->getLoop();
+    ioLoop->assertInLoopThread();
+    bool erased = shardOf(ioLoop).connections.erase(conn->id());
+    (void)erased;
+    assert(erased);
+}
+
+// 成功时在新线程里，放弃时（连接已经关闭）还在原来的线程里，连接没有离开原来的分片
+void TcpServer::connectionMigratedInLoop(const TcpConnectionPtr& conn, bool migrated) {
+    EventLoop* ioLoop = conn->getLoop();
+    ioLoop->assertInLoopThread();
+    if (migrated) {
+        bool inserted = shardOf(ioLoop).connections.insert(conn->id(), conn);
+        (void)inserted;
+        assert(inserted);
+        LOG_DEBUG << "TcpServer::migrateConnection [" << name_
+            << "] - connection " << conn->name() << " migrated" << std::endl;
+    }
+    migrationFinished();
+}
+
+void TcpServer::rebalance() {
+    loop_->assertInLoopThread();
+    if (ioLoops_.size() < 2 || migrationsInFlight_.get() > 0) { //上一轮还没有完成，负载计数还不准
+        return;
+    }
+
+    size_t hot = 0;
+    size_t cold = 0;
+    std::vector<int64_t> loads(ioLoops_.size());
+    for (size_t i = 0; i < ioLoops_.size(); ++i) {
+        loads[i] = rebalanceMetric_ == kRebalanceConnections
+                   ? ioLoops_[i]->connectionCount()
+                   : ioLoops_[i]->recentLatencyUs();
+        if (loads[i] > loads[hot]) {
+            hot = i;
+        }
+        if (loads[i] < loads[cold]) {
+            cold = i;
+        }
+    }
+
+    int64_t gap = loads[hot] - loads[cold];
+    if (gap <= static_cast<int64_t>(static_cast<double>(loads[cold]) * rebalanceImbalance_)) {
+        return;
+    }
+
+    // 按连接数时挪走差值的一半；按处理时间时假设时间和连接数成正比，挪走对应比例的连接
+    int hotConnections = ioLoops_[hot]->connectionCount();
+    int count = 0;
+    if (rebalanceMetric_ == kRebalanceConnections) {
+        count = static_cast<int>(gap / 2);
+    } else if (gap >= kMinLatencyGapUs && hotConnections > 1) {
+        count = std::max(1, static_cast<int>(hotConnections * gap / (2 * loads[hot])));
+    }
+    count = std::min(count, kMaxMigrationsPerRound);
+    if (count <= 0) {
+        return;
+    }
+
+    LOG_INFO << "TcpServer::rebalance [" << name_ << "] - move " << count
+        << " connections, load " << loads[hot] << " -> " << loads[cold] << std::endl;
+
+    migrationsInFlight_.increment(); //migrateFromLoop执行前TcpServer不能析构
+    ioLoops_[hot]->runInLoop(
+        boost::bind(&TcpServer::migrateFromLoop, this, ioLoops_[hot], ioLoops_[cold], count));
+}
+
+void TcpServer::migrateFromLoop(EventLoop* from, EventLoop* to, int count) {
+    from->assertInLoopThread();
+
+    std::vector<TcpConnectionPtr> candidates;
+    Shard& shard = shardOf(from);
+    candidates.reserve(shard.connections.size());
+    shard.connections.forEach(boost::bind(&collectConnected, &candidates, _2));
+
+    size_t n = std::min(candidates.size(), static_cast<size_t>(count));
+    if (rebalanceMetric_ == kRebalanceLatency) {
+        std::partial_sort(candidates.begin(), candidates.begin() + n, candidates.end(), moreBytesReceived);
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        migrateConnection(candidates[i], to);
+    }
+
+    migrationFinished();
+}
 
+// 计数在锁外减，降到0时在锁里通知，析构函数在锁里检查计数之后才等待，不会错过通知
+void TcpServer::migrationFinished() {
+    if (migrationsInFlight_.decrementAndGet() == 0) {
+        MutexLockGuard lock(migrationMutex_);
+        migrationsDone_.notifyAll();
+    }
+}
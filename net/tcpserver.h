@@ -8,20 +8,29 @@ TcpServer的拥有一个Acceptor和EventLoopThreadPool。Acceptor是对accept连
 */
 
 #include "../base/atomic.h"
+#include "../base/condition.h"
+#include "../base/int_hash_map.h"
+#include "../base/mutex.h"
 #include "tcpconnection.h"
+#include "timerid.h"
 
-#include <map>
+#include <vector>
 #include <boost/noncopyable.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
 
 
 namespace kaycc {
+    class Latch;
+    class ThreadPool;
+
 namespace net {
 
     class Acceptor;
     class EventLoop;
     class EventLoopThreadPool;
+    class LoopSelector;
+    class TaskOffloader;
 
     ///
     /// TCP server, supports single-threaded and thread-pool models.
@@ -37,6 +46,20 @@ namespace net {
 
             // 复用端口 
             kReusePort,
+
+            // 每个IO线程有自己的SO_REUSEPORT监听套接字和Acceptor，由内核把新连接分给各个线程，
+            // 连接在接受它的线程里建立和处理，不经过baseLoop，也不用跨线程转交。
+            // setThreadNum(0)时和kReusePort一样，在baseLoop里accept
+            kReusePortPerLoop,
+        };
+
+        // 自动再平衡时衡量IO线程负载的指标
+        enum RebalanceMetric {
+            // EventLoop::connectionCount()，从连接最多的线程挪走任意的连接
+            kRebalanceConnections,
+
+            // EventLoop::recentLatencyUs()，从最忙的线程挪走累计收到数据最多的连接
+            kRebalanceLatency,
         };
 
         TcpServer(EventLoop* loop,
@@ -67,11 +90,35 @@ namespace net {
         */
         void setThreadNum(int numThreads);
 
+        // 把IO线程绑定到CPU上，cpus为空时按CPU拓扑分散到不同的物理核上，
+        // 见EventLoopThreadPool::setCpuAffinity。必须在start之前设置
+        void setCpuAffinity(const std::vector<int>& cpus = std::vector<int>());
+
         // 设置线程初始化回调函数 
         void setThreadInitCallback(const ThreadInitCallback& cb) {
             threadInitCallback_ = cb;
         }
 
+        // 选择新连接由哪个IO线程处理，默认（NULL）是轮询，见loopselector.h。
+        // kReusePortPerLoop模式下由内核分配，不使用。必须在start之前设置
+        void setLoopSelector(const boost::shared_ptr<LoopSelector>& selector);
+
+        // Acceptor每次读事件最多accept的连接数，默认Acceptor::kDefaultAcceptBatch。必须在start之前设置
+        void setAcceptBatch(int batch);
+
+        // 所有连接的TCP_NODELAY，设置在监听套接字上由连接继承。必须在start之前设置
+        void setTcpNoDelay(bool on);
+
+        // 打开自动再平衡：每intervalSeconds秒在baseLoop里比较各个IO线程的负载，
+        // 最高的比最低的多出imbalance（比例）以上时，从最忙的线程挪一部分连接到最闲的线程。必须在start之前设置
+        void setRebalance(double intervalSeconds,
+                          RebalanceMetric metric = kRebalanceConnections,
+                          double imbalance = 0.25);
+
+        // 把连接迁移到ioLoop（必须是这个TcpServer的IO线程），buffer和回调都保留，线程安全。
+        // 只能在start之后、TcpServer析构之前调用
+        void migrateConnection(const TcpConnectionPtr& conn, EventLoop* ioLoop);
+
         /// valid after calling start()
         boost::shared_ptr<EventLoopThreadPool> threadPool() {
             return threadPool_;
@@ -97,25 +144,84 @@ namespace net {
             writeCompleteCallback_ = cb;
         }
 
+        // 设置后，每个连接有一个自己的Strand，MessageCallback不在IO线程里调用，
+        // 而是在pool里按到达顺序串行执行（同一连接的消息不会并发，不同连接之间并行）。
+        // 收到的数据先从连接的inputBuffer转移出来，回调拿到的Buffer只在这个Strand里使用，
+        // 没有取走的数据会留到下一次回调。
+        // 每个连接同时最多有一个回调在排队，IO线程用tryRun提交，不会阻塞：pool设置了setMaxQueueSize并且已满时，
+        // 暂停这个连接的读，队列长度降到lowWaterMark时再提交并恢复读（内部用TaskOffloader，会占用pool的低水位回调）。
+        // 必须在start之前设置
+        void setMessageThreadPool(ThreadPool* pool, size_t lowWaterMark = 0);
+
     private:
         /// Not thread safe, but in loop
         /// 新连接到来回调函数
-        void newConnection(int sockfd, const InetAddress& peerAddr);
+        void newConnection(int sockfd, const InetAddress& peerAddr, const InetAddress& localAddr);
 
-        /// Thread safe.
-        /// 删除连接
-        void removeConnection(const TcpConnectionPtr& conn);
+        /// 在ioLoop里创建连接，kReusePortPerLoop时由ioLoop自己的Acceptor直接调用
+        void newConnectionInLoop(EventLoop* ioLoop, int sockfd,
+                                 const InetAddress& peerAddr, const InetAddress& localAddr);
+
+        /// 在连接的IO线程里加入连接表，然后connectEstablished
+        void connectionEstablishedInLoop(const TcpConnectionPtr& conn);
 
         /// Not thread safe, but in loop
-        void removeConnectionInLoop(const TcpConnectionPtr& conn);
+        /// 删除连接，在连接自己的IO线程里调用（TcpConnection的closeCallback）
+        void removeConnection(const TcpConnectionPtr& conn);
+
+        // 迁移时的回调：在原来的线程里从连接表删除，在新线程里加入新线程的连接表
+        void connectionDetachedInLoop(const TcpConnectionPtr& conn);
+        void connectionMigratedInLoop(const TcpConnectionPtr& conn, bool migrated);
 
-        typedef std::map<std::string, TcpConnectionPtr> ConnectionMap;
+        // 再平衡，在baseLoop的定时器里调用
+        void rebalance();
+
+        // 在最忙的线程from里选出count个连接迁移到to
+        void migrateFromLoop(EventLoop* from, EventLoop* to, int count);
+        void migrationFinished();
+
+        // 析构时在每个IO线程里销毁它的连接
+        void destroyShardInLoop(size_t index, Latch* latch);
+
+        // 开始监听，在baseLoop里调用
+        void listenInLoop();
+
+        // 各个IO线程的Acceptor开始监听，在baseLoop里调用
+        void startLoopAcceptors();
+
+        // 按TcpConnection::id()查找
+        typedef IntHashMap<TcpConnectionPtr> ConnectionMap;
+
+        // 连接表按IO线程分片，每个分片只在它的loop线程里访问，不加锁，
+        // 连接关闭时直接在自己的线程里删除，不用经过baseLoop
+        struct Shard {
+            EventLoop* loop;
+            ConnectionMap connections;
+        };
+
+        // ioLoops_里的下标，start之后不再变化
+        Shard& shardOf(EventLoop* ioLoop);
 
         EventLoop* loop_;  // the acceptor loop
 
         const std::string ipPort_;
         const std::string name_;
+        const InetAddress listenAddr_;
+        const Option option_;
         boost::scoped_ptr<Acceptor> acceptor_;    // avoid revealing Acceptor
+
+        // kReusePortPerLoop时每个IO线程一个Acceptor，只在各自的线程里使用和析构
+        std::vector<Acceptor*> loopAcceptors_;
+
+        // 不为NULL时用它来选择新连接的IO线程，ioLoops_是start之后所有的IO线程，shards_和它一一对应
+        boost::shared_ptr<LoopSelector> loopSelector_;
+        std::vector<EventLoop*> ioLoops_;
+        std::vector<Shard> shards_;
+
+        // 在start时应用到每个Acceptor
+        int acceptBatch_;
+        bool tcpNoDelay_;
+
         boost::shared_ptr<EventLoopThreadPool> threadPool_;
 
         ConnectionCallback connectionCallback_;
@@ -125,14 +231,29 @@ namespace net {
         // 线程初始化回调函数 
         ThreadInitCallback threadInitCallback_;
 
+        // 不为NULL时MessageCallback通过每个连接的Strand在这个线程池里执行
+        ThreadPool* messagePool_;
+        boost::scoped_ptr<TaskOffloader> messageOffloader_; //线程池满时暂存回调、暂停读
+
         // 服务器是否已经启动
         AtomicInt32 started_;
 
-        // 下一个连接的id 
-        int nextConnId_;
+        // 下一个连接的id，kReusePortPerLoop时多个IO线程会同时取
+        AtomicInt64 nextConnId_;
+
+        // 连接名字的前缀 name-ip:port#，所有连接共享，名字在用到时才拼上id
+        const boost::shared_ptr<const std::string> connNamePrefix_;
+
+        // 自动再平衡，rebalanceInterval_为0时不打开
+        double rebalanceInterval_;
+        RebalanceMetric rebalanceMetric_;
+        double rebalanceImbalance_;
+        TimerId rebalanceTimer_;
 
-        // 存放所有的连接 
-        ConnectionMap connections_;
+        // 还没有完成的迁移（连接不在任何一个分片里），析构时在migrationsDone_上等它们完成
+        AtomicInt32 migrationsInFlight_;
+        MutexLock migrationMutex_;
+        Condition migrationsDone_; //migrationsInFlight_降到0时通知
 
     };
 
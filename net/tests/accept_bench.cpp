@@ -0,0 +1,134 @@
+#include "../tcpserver.h"
+
+#include "../../base/timestamp.h"
+#include "../eventloop.h"
+#include "../eventloopthread.h"
+#include "../inetaddress.h"
+
+#include <boost/bind.hpp>
+
+#include <atomic>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace kaycc;
+using namespace kaycc::net;
+
+// 连接突发时的accept速率：客户端一次发起kBurst个非阻塞connect（本机回环上握手由内核完成，
+// 连接都排在accept队列里），等服务器全部accept之后关闭，重复kRounds轮。
+// 比较不同的Acceptor batch大小，wakeups是accept这些连接用了多少轮poll。
+// 用法：accept_bench [burst] [rounds]
+
+int kBurst = 500;
+int kRounds = 20;
+
+std::atomic<int> g_accepted(0);
+std::atomic<int64_t> g_firstIteration(-1);
+std::atomic<int64_t> g_lastIteration(0);
+
+void onConnection(const TcpConnectionPtr& conn) {
+    if (!conn->connected()) {
+        return;
+    }
+    int64_t iteration = conn->getLoop()->iteration();
+    int64_t expected = -1;
+    g_firstIteration.compare_exchange_strong(expected, iteration);
+    g_lastIteration.store(iteration);
+    ++g_accepted;
+}
+
+void createServer(EventLoop* loop, TcpServer** server, const InetAddress& addr, int batch) {
+    *server = new TcpServer(loop, addr, "AcceptBench");
+    (*server)->setAcceptBatch(batch);
+    (*server)->setConnectionCallback(onConnection);
+    (*server)->start();
+}
+
+void destroyServer(TcpServer* server) {
+    delete server;
+}
+
+void run(EventLoop* loop, uint16_t port, int batch) {
+    InetAddress addr(port, true);
+    TcpServer* server = NULL;
+    loop->runInLoop(boost::bind(&createServer, loop, &server, addr, batch));
+    usleep(100 * 1000);
+
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int64_t wakeups = 0;
+    double seconds = 0;
+    std::vector<int> fds;
+    for (int round = 0; round < kRounds; ++round) {
+        g_accepted = 0;
+        g_firstIteration = -1;
+
+        Timestamp start(Timestamp::now());
+        for (int i = 0; i < kBurst; ++i) {
+            int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+            int ret = ::connect(fd, reinterpret_cast<struct sockaddr*>(&sa), sizeof sa);
+            assert(ret == 0 || errno == EINPROGRESS);
+            (void)ret;
+            fds.push_back(fd);
+        }
+        while (g_accepted.load() < kBurst) {
+            sched_yield();
+        }
+        seconds += timeDifference(Timestamp::now(), start);
+        wakeups += g_lastIteration.load() - g_firstIteration.load() + 1;
+
+        for (size_t i = 0; i < fds.size(); ++i) {
+            ::close(fds[i]);
+        }
+        fds.clear();
+        usleep(50 * 1000); //等服务器把连接都关掉
+    }
+
+    int total = kBurst * kRounds;
+    printf("%-8d %12.0f %12.2f %10lld\n", batch, total / seconds, seconds * 1e6 / total,
+           static_cast<long long>(wakeups));
+
+    loop->runInLoop(boost::bind(&destroyServer, server));
+    usleep(100 * 1000);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        kBurst = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        kRounds = atoi(argv[2]);
+    }
+
+    // 每个连接两端各一个fd
+    struct rlimit rl;
+    ::getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    ::setrlimit(RLIMIT_NOFILE, &rl);
+    if (rl.rlim_cur < static_cast<rlim_t>(2 * kBurst + 64)) {
+        kBurst = static_cast<int>(rl.rlim_cur / 2) - 32;
+    }
+
+    EventLoopThread loopThread;
+    EventLoop* loop = loopThread.startLoop();
+
+    printf("burst %d x %d rounds\n", kBurst, kRounds);
+    printf("%-8s %12s %12s %10s\n", "batch", "conn/s", "us/conn", "wakeups");
+    int batches[] = {1, 4, 16, 64};
+    for (size_t i = 0; i < sizeof batches / sizeof batches[0]; ++i) {
+        run(loop, static_cast<uint16_t>(23600 + i), batches[i]);
+    }
+}
@@ -0,0 +1,140 @@
+#include "../tcpserver.h"
+
+#include "../../base/count_down_latch.h"
+#include "../../base/thread.h"
+#include "../../base/timestamp.h"
+#include "../eventloop.h"
+#include "../eventloopthread.h"
+#include "../eventloopthreadpool.h"
+#include "../inetaddress.h"
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <vector>
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace kaycc;
+using namespace kaycc::net;
+
+// 连接的建立和关闭速率（churn）：每个客户端线程反复 connect -> 发1字节 -> 收到回显 -> 关闭（RST，不留TIME_WAIT）。
+// 计时到服务器端所有TcpConnection都析构为止（EventLoop::connectionCount()归零），
+// 这样关闭连接时在服务器内部的开销（从连接表删除、connectDestroyed）也算在内。
+// 用法：churn_bench [ioThreads] [clientThreads] [connectionsPerClient]
+
+const uint16_t kPort = 23700;
+
+int g_ioThreads = 4;
+int g_clients = 2;
+int g_connections = 5000;
+
+void onConnection(const TcpConnectionPtr&) {
+}
+
+void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+    conn->send(buf);
+}
+
+void createServer(EventLoop* loop, TcpServer** server) {
+    *server = new TcpServer(loop, InetAddress(kPort, true), "ChurnBench");
+    (*server)->setThreadNum(g_ioThreads);
+    (*server)->setConnectionCallback(onConnection);
+    (*server)->setMessageCallback(onMessage);
+    (*server)->start();
+}
+
+void destroyServer(TcpServer* server) {
+    delete server;
+}
+
+void collectLoops(TcpServer* server, std::vector<EventLoop*>* loops, CountDownLatch* latch) {
+    *loops = server->threadPool()->getAllLoops();
+    latch->countDown();
+}
+
+void client() {
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(kPort);
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    struct linger lg;
+    lg.l_onoff = 1;
+    lg.l_linger = 0;
+
+    for (int i = 0; i < g_connections; ++i) {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        int ret = ::connect(fd, reinterpret_cast<struct sockaddr*>(&sa), sizeof sa);
+        assert(ret == 0);
+        char c = 'x';
+        ret = static_cast<int>(::write(fd, &c, 1));
+        assert(ret == 1);
+        ret = static_cast<int>(::read(fd, &c, 1));
+        assert(ret == 1);
+        (void)ret;
+        ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof lg);
+        ::close(fd);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        g_ioThreads = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        g_clients = atoi(argv[2]);
+    }
+    if (argc > 3) {
+        g_connections = atoi(argv[3]);
+    }
+
+    EventLoopThread loopThread;
+    EventLoop* loop = loopThread.startLoop();
+    TcpServer* server = NULL;
+    loop->runInLoop(boost::bind(&createServer, loop, &server));
+    usleep(100 * 1000);
+
+    std::vector<EventLoop*> loops;
+    CountDownLatch latch(1);
+    loop->runInLoop(boost::bind(&collectLoops, server, &loops, &latch));
+    latch.wait();
+
+    Timestamp start(Timestamp::now());
+    boost::ptr_vector<Thread> threads;
+    for (int i = 0; i < g_clients; ++i) {
+        threads.push_back(new Thread(client));
+        threads.back().start();
+    }
+    for (int i = 0; i < g_clients; ++i) {
+        threads[i].join();
+    }
+
+    // 等服务器端的连接全部销毁
+    for (;;) {
+        int alive = 0;
+        for (size_t i = 0; i < loops.size(); ++i) {
+            alive += loops[i]->connectionCount();
+        }
+        if (alive == 0) {
+            break;
+        }
+        sched_yield();
+    }
+    double seconds = timeDifference(Timestamp::now(), start);
+
+    int total = g_clients * g_connections;
+    printf("io threads %d, clients %d, %d connections in %.3fs: %.0f conn/s, %.1f us/conn\n",
+           g_ioThreads, g_clients, total, seconds, total / seconds, seconds * 1e6 / total);
+
+    loop->runInLoop(boost::bind(&destroyServer, server));
+    usleep(100 * 1000);
+}
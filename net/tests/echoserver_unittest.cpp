@@ -10,19 +10,21 @@
 #include <utility>
 
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 using namespace kaycc;
 using namespace kaycc::net;
 
 int numThreads = 0;
+TcpServer::Option option = TcpServer::kNoReusePort;
 
 class EchoServer
 {
  public:
   EchoServer(EventLoop* loop, const InetAddress& listenAddr)
     : loop_(loop),
-      server_(loop, listenAddr, "EchoServer")
+      server_(loop, listenAddr, "EchoServer", option)
   {
     server_.setConnectionCallback(
         boost::bind(&EchoServer::onConnection, this, _1));
@@ -72,6 +74,12 @@ int main(int argc, char* argv[])
 {
   LOG << "pid = " << getpid() << ", tid = " << currentthread::tid() << std::endl;
   LOG << "sizeof TcpConnection = " << sizeof(TcpConnection) << std::endl;
+  // 最后一个参数是reuseport时每个IO线程自己accept，去掉它之后其余参数的含义不变
+  if (argc > 1 && strcmp(argv[argc - 1], "reuseport") == 0)
+  {
+    option = TcpServer::kReusePortPerLoop;
+    --argc;
+  }
   if (argc > 1)
   {
     numThreads = atoi(argv[1]);
@@ -0,0 +1,175 @@
+#include "../loopselector.h"
+
+#include "../../base/count_down_latch.h"
+#include "../eventloop.h"
+#include "../eventloopthread.h"
+#include "../inetaddress.h"
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+using namespace kaycc;
+using namespace kaycc::net;
+
+// 各个LoopSelector的选择结果。负载计数直接在EventLoop上制造：
+// 连接数用connectionCreated/connectionDestroyed，队列长度用阻塞住的loop，处理时间用sleep的回调
+
+const int kLoops = 4;
+
+std::vector<EventLoop*> g_loops;
+
+InetAddress peer(int i) {
+    char ip[32];
+    snprintf(ip, sizeof ip, "10.%d.%d.%d", (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff);
+    return InetAddress(ip, static_cast<uint16_t>(1024 + i % 50000));
+}
+
+void testRoundRobin() {
+    RoundRobinSelector selector;
+    for (int i = 0; i < kLoops * 3; ++i) {
+        assert(selector.select(g_loops, peer(i)) == g_loops[i % kLoops]);
+    }
+}
+
+void testLeastConnections() {
+    LeastConnectionsSelector selector;
+    // 负载相同时轮询
+    std::set<EventLoop*> chosen;
+    for (int i = 0; i < kLoops; ++i) {
+        chosen.insert(selector.select(g_loops, peer(i)));
+    }
+    assert(chosen.size() == static_cast<size_t>(kLoops));
+
+    for (int i = 0; i < 5; ++i) {
+        g_loops[0]->connectionCreated();
+        g_loops[1]->connectionCreated();
+        g_loops[3]->connectionCreated();
+    }
+    g_loops[2]->connectionCreated();
+    for (int i = 0; i < 10; ++i) {
+        assert(selector.select(g_loops, peer(i)) == g_loops[2]);
+    }
+
+    for (int i = 0; i < 5; ++i) {
+        g_loops[0]->connectionDestroyed();
+        g_loops[1]->connectionDestroyed();
+        g_loops[3]->connectionDestroyed();
+    }
+    g_loops[2]->connectionDestroyed();
+}
+
+void block(CountDownLatch* started, CountDownLatch* release) {
+    started->countDown();
+    release->wait();
+}
+
+void noop() {
+}
+
+void testLeastPending() {
+    LeastPendingSelector selector;
+    CountDownLatch started(1);
+    CountDownLatch release(1);
+    g_loops[1]->runInLoop(boost::bind(&block, &started, &release));
+    started.wait();
+
+    // loop 1阻塞在回调里，之后投递的回调都在排队
+    for (int i = 0; i < 3; ++i) {
+        g_loops[1]->queueInLoop(noop);
+    }
+    assert(g_loops[1]->pendingCount() == 3);
+    for (int i = 0; i < 20; ++i) {
+        assert(selector.select(g_loops, peer(i)) != g_loops[1]);
+    }
+
+    release.countDown();
+    while (g_loops[1]->pendingCount() != 0) {
+        usleep(1000);
+    }
+}
+
+void sleepMs(int ms) {
+    ::usleep(ms * 1000);
+}
+
+void testLowestLatency() {
+    LowestLatencySelector selector;
+    // 每次循环都很慢，滑动平均升高
+    for (int i = 0; i < 20; ++i) {
+        CountDownLatch done(1);
+        g_loops[3]->runInLoop(boost::bind(&sleepMs, 5));
+        g_loops[3]->runInLoop(boost::bind(&CountDownLatch::countDown, &done));
+        done.wait();
+    }
+    usleep(10 * 1000);
+    printf("latency(us):");
+    for (int i = 0; i < kLoops; ++i) {
+        printf(" %lld", static_cast<long long>(g_loops[i]->recentLatencyUs()));
+    }
+    printf("\n");
+    assert(g_loops[3]->recentLatencyUs() > 1000);
+    for (int i = 0; i < 20; ++i) {
+        assert(selector.select(g_loops, peer(i)) != g_loops[3]);
+    }
+}
+
+void testConsistentHash() {
+    ConsistentHashSelector selector;
+
+    // 同一个IP的不同端口总是同一个线程
+    InetAddress a("192.168.1.10", 1000);
+    InetAddress b("192.168.1.10", 2000);
+    assert(selector.select(g_loops, a) == selector.select(g_loops, b));
+
+    // 分布大致均匀
+    const int kPeers = 20000;
+    std::map<EventLoop*, int> counts;
+    std::vector<EventLoop*> before(kPeers);
+    for (int i = 0; i < kPeers; ++i) {
+        before[i] = selector.select(g_loops, peer(i));
+        ++counts[before[i]];
+    }
+    printf("hash distribution:");
+    for (int i = 0; i < kLoops; ++i) {
+        printf(" %d", counts[g_loops[i]]);
+        assert(counts[g_loops[i]] > kPeers / kLoops / 2);
+    }
+    printf("\n");
+
+    // 去掉一个线程，只有原来在它上面的客户端换线程
+    std::vector<EventLoop*> fewer(g_loops.begin(), g_loops.end() - 1);
+    int moved = 0;
+    for (int i = 0; i < kPeers; ++i) {
+        EventLoop* after = selector.select(fewer, peer(i));
+        if (after != before[i]) {
+            assert(before[i] == g_loops[kLoops - 1]);
+            ++moved;
+        }
+    }
+    printf("moved %d of %d after removing a loop\n", moved, kPeers);
+    assert(moved == counts[g_loops[kLoops - 1]]);
+}
+
+int main() {
+    boost::ptr_vector<EventLoopThread> threads;
+    for (int i = 0; i < kLoops; ++i) {
+        threads.push_back(new EventLoopThread);
+        g_loops.push_back(threads.back().startLoop());
+    }
+
+    testRoundRobin();
+    testLeastConnections();
+    testLeastPending();
+    testLowestLatency();
+    testConsistentHash();
+
+    printf("done\n");
+}
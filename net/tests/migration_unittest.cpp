@@ -0,0 +1,310 @@
+#include "../tcpserver.h"
+
+#include "../../base/count_down_latch.h"
+#include "../../base/mutex.h"
+#include "../../base/thread.h"
+#include "../eventloop.h"
+#include "../eventloopthread.h"
+#include "../eventloopthreadpool.h"
+#include "../inetaddress.h"
+#include "../loopselector.h"
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace kaycc;
+using namespace kaycc::net;
+
+// 1. 客户端不停地发递增的序号，服务器回显，同时另一个线程在服务器端往连接里推递增的序号，
+//    主线程反复把这两个连接迁移到随机的IO线程，客户端检查收到的数据没有丢失和乱序
+// 2. 所有连接都分给第一个IO线程，打开按连接数的再平衡，检查各线程的连接数变得均匀，之后连接仍然可用
+// 3. 迁移还在进行时析构TcpServer
+
+const uint16_t kPort = 23800;
+const int kIoThreads = 4;
+
+MutexLock g_mutex;
+std::vector<TcpConnectionPtr> g_connections; // @GuardedBy g_mutex
+
+void onConnection(const TcpConnectionPtr& conn) {
+    MutexLockGuard lock(g_mutex);
+    if (conn->connected()) {
+        g_connections.push_back(conn);
+    } else {
+        for (size_t i = 0; i < g_connections.size(); ++i) {
+            if (g_connections[i] == conn) {
+                g_connections.erase(g_connections.begin() + i);
+                break;
+            }
+        }
+    }
+}
+
+void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+    conn->send(buf);
+}
+
+// 所有连接都给第一个线程，制造不均衡
+class FirstLoopSelector : public LoopSelector {
+public:
+    virtual EventLoop* select(const std::vector<EventLoop*>& loops, const InetAddress&) {
+        return loops[0];
+    }
+};
+
+void createServer(EventLoop* loop, TcpServer** server, bool rebalance, CountDownLatch* latch) {
+    *server = new TcpServer(loop, InetAddress(kPort, true), "MigrationTest");
+    (*server)->setThreadNum(kIoThreads);
+    (*server)->setConnectionCallback(onConnection);
+    (*server)->setMessageCallback(onMessage);
+    if (rebalance) {
+        (*server)->setLoopSelector(boost::shared_ptr<LoopSelector>(new FirstLoopSelector));
+        (*server)->setRebalance(0.05);
+    }
+    (*server)->start();
+    latch->countDown();
+}
+
+void destroyServer(TcpServer* server, CountDownLatch* latch) {
+    delete server;
+    latch->countDown();
+}
+
+void collectLoops(TcpServer* server, std::vector<EventLoop*>* loops, CountDownLatch* latch) {
+    *loops = server->threadPool()->getAllLoops();
+    latch->countDown();
+}
+
+int connectServer() {
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(kPort);
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    int ret = ::connect(fd, reinterpret_cast<struct sockaddr*>(&sa), sizeof sa);
+    assert(ret == 0);
+    (void)ret;
+    return fd;
+}
+
+void readFully(int fd, void* buf, size_t len) {
+    char* p = static_cast<char*>(buf);
+    while (len > 0) {
+        ssize_t n = ::read(fd, p, len);
+        assert(n > 0);
+        p += n;
+        len -= n;
+    }
+}
+
+TcpConnectionPtr waitConnections(size_t count) {
+    for (;;) {
+        {
+            MutexLockGuard lock(g_mutex);
+            if (g_connections.size() >= count) {
+                return g_connections.back();
+            }
+        }
+        usleep(1000);
+    }
+}
+
+const uint32_t kNumbers = 200000;
+
+// 客户端：发kNumbers个序号，同时读回显并检查
+void echoClient(int fd) {
+    const uint32_t kChunk = 256;
+    uint32_t sent = 0;
+    uint32_t expected = 0;
+    while (expected < kNumbers) {
+        if (sent < kNumbers) {
+            uint32_t buf[kChunk];
+            uint32_t n = std::min(kChunk, kNumbers - sent);
+            for (uint32_t i = 0; i < n; ++i) {
+                buf[i] = sent++;
+            }
+            ssize_t nw = ::write(fd, buf, n * sizeof(uint32_t));
+            assert(nw == static_cast<ssize_t>(n * sizeof(uint32_t)));
+            (void)nw;
+        }
+
+        uint32_t buf[kChunk];
+        uint32_t n = std::min(kChunk, sent - expected);
+        readFully(fd, buf, n * sizeof(uint32_t));
+        for (uint32_t i = 0; i < n; ++i) {
+            if (buf[i] != expected) {
+                printf("echo out of order: got %u expected %u\n", buf[i], expected);
+                abort();
+            }
+            ++expected;
+        }
+    }
+}
+
+// 服务器端在非IO线程里往连接推序号
+void pusher(const TcpConnectionPtr& conn) {
+    for (uint32_t i = 0; i < kNumbers; i += 64) {
+        uint32_t buf[64];
+        for (uint32_t j = 0; j < 64; ++j) {
+            buf[j] = i + j;
+        }
+        conn->send(buf, static_cast<int>(sizeof buf));
+    }
+}
+
+void pushReader(int fd) {
+    for (uint32_t expected = 0; expected < kNumbers; ) {
+        uint32_t buf[64];
+        readFully(fd, buf, sizeof buf);
+        for (uint32_t j = 0; j < 64; ++j) {
+            if (buf[j] != expected) {
+                printf("push out of order: got %u expected %u\n", buf[j], expected);
+                abort();
+            }
+            ++expected;
+        }
+    }
+}
+
+void testMigrateWhileStreaming(EventLoop* loop) {
+    TcpServer* server = NULL;
+    CountDownLatch created(1);
+    loop->runInLoop(boost::bind(&createServer, loop, &server, false, &created));
+    created.wait();
+    usleep(100 * 1000);
+
+    std::vector<EventLoop*> loops;
+    CountDownLatch collected(1);
+    loop->runInLoop(boost::bind(&collectLoops, server, &loops, &collected));
+    collected.wait();
+
+    int echoFd = connectServer();
+    TcpConnectionPtr echoConn = waitConnections(1);
+    int pushFd = connectServer();
+    TcpConnectionPtr pushConn = waitConnections(2);
+
+    Thread echoThread(boost::bind(&echoClient, echoFd));
+    Thread pushThread(boost::bind(&pusher, pushConn));
+    Thread readThread(boost::bind(&pushReader, pushFd));
+    echoThread.start();
+    pushThread.start();
+    readThread.start();
+
+    int migrations = 0;
+    int moved = 0;
+    EventLoop* last = echoConn->getLoop();
+    srand(1);
+    for (int i = 0; i < 500; ++i) {
+        server->migrateConnection(echoConn, loops[rand() % loops.size()]);
+        server->migrateConnection(pushConn, loops[rand() % loops.size()]);
+        migrations += 2;
+        usleep(200);
+        if (echoConn->getLoop() != last) {
+            last = echoConn->getLoop();
+            ++moved;
+        }
+    }
+    assert(moved > 0);
+
+    echoThread.join();
+    pushThread.join();
+    readThread.join();
+    printf("streamed %u numbers each way with %d migration requests, echo connection moved %d times\n",
+           kNumbers, migrations, moved);
+
+    // 迁移还在进行时析构
+    for (int i = 0; i < 100; ++i) {
+        server->migrateConnection(echoConn, loops[i % loops.size()]);
+    }
+    echoConn.reset();
+    pushConn.reset();
+    CountDownLatch destroyed(1);
+    loop->runInLoop(boost::bind(&destroyServer, server, &destroyed));
+    destroyed.wait();
+    ::close(echoFd);
+    ::close(pushFd);
+
+    MutexLockGuard lock(g_mutex);
+    assert(g_connections.empty());
+}
+
+void testRebalance(EventLoop* loop) {
+    TcpServer* server = NULL;
+    CountDownLatch created(1);
+    loop->runInLoop(boost::bind(&createServer, loop, &server, true, &created));
+    created.wait();
+    usleep(100 * 1000);
+
+    std::vector<EventLoop*> loops;
+    CountDownLatch collected(1);
+    loop->runInLoop(boost::bind(&collectLoops, server, &loops, &collected));
+    collected.wait();
+
+    const int kClients = 40;
+    std::vector<int> fds;
+    for (int i = 0; i < kClients; ++i) {
+        fds.push_back(connectServer());
+    }
+    waitConnections(kClients);
+
+    bool balanced = false;
+    for (int round = 0; round < 200 && !balanced; ++round) {
+        usleep(10 * 1000);
+        int maxCount = 0;
+        int minCount = kClients;
+        for (size_t i = 0; i < loops.size(); ++i) {
+            maxCount = std::max(maxCount, loops[i]->connectionCount());
+            minCount = std::min(minCount, loops[i]->connectionCount());
+        }
+        balanced = maxCount - minCount <= 1;
+    }
+    printf("connections per loop:");
+    for (size_t i = 0; i < loops.size(); ++i) {
+        printf(" %d", loops[i]->connectionCount());
+    }
+    printf("\n");
+    assert(balanced);
+
+    // 迁移后的连接仍然可以收发
+    for (int i = 0; i < kClients; ++i) {
+        uint32_t n = static_cast<uint32_t>(i);
+        ssize_t nw = ::write(fds[i], &n, sizeof n);
+        assert(nw == sizeof n);
+        (void)nw;
+        uint32_t echo = 0;
+        readFully(fds[i], &echo, sizeof echo);
+        assert(echo == n);
+    }
+
+    CountDownLatch destroyed(1);
+    loop->runInLoop(boost::bind(&destroyServer, server, &destroyed));
+    destroyed.wait();
+    for (int i = 0; i < kClients; ++i) {
+        ::close(fds[i]);
+    }
+}
+
+int main() {
+    EventLoopThread loopThread;
+    EventLoop* loop = loopThread.startLoop();
+
+    testMigrateWhileStreaming(loop);
+    testRebalance(loop);
+
+    printf("done\n");
+}
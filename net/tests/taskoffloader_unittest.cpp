@@ -0,0 +1,151 @@
+#include "../taskoffloader.h"
+
+#include "../../base/atomic.h"
+#include "../../base/mutex.h"
+#include "../../base/threadpool.h"
+#include "../buffer.h"
+#include "../eventloop.h"
+#include "../eventloopthread.h"
+#include "../inetaddress.h"
+#include "../tcpconnection.h"
+#include "../tcpserver.h"
+
+#include <boost/bind.hpp>
+
+#include <vector>
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace kaycc;
+using namespace kaycc::net;
+
+// 线程池只有1个线程、队列容量2，客户端一次发kFirstBatch条消息，大部分任务被暂存、连接暂停读；
+// 之后再发kSecondBatch条消息。检查：
+// 1. 第二批消息只有在这个连接暂存的任务全部重新提交之后才会被读到（不会每重新提交一个就恢复读）
+// 2. 所有任务都执行了，并且按消息的顺序执行
+
+const uint16_t kPort = 23900;
+const int kFirstBatch = 30;
+const int kSecondBatch = 10;
+
+TaskOffloader* g_offloader = NULL;
+
+MutexLock g_mutex;
+std::vector<uint32_t> g_executed;   // @GuardedBy g_mutex
+AtomicInt32 g_received;
+AtomicInt32 g_earlyReads; //第二批的第一条消息被读到时还有暂存的任务
+
+void work(uint32_t seq) {
+    usleep(1000);
+    MutexLockGuard lock(g_mutex);
+    g_executed.push_back(seq);
+}
+
+void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+    while (buf->readableBytes() >= sizeof(uint32_t)) {
+        uint32_t seq = 0;
+        memcpy(&seq, buf->peek(), sizeof seq);
+        buf->retrieve(sizeof seq);
+        g_received.increment();
+
+        if (seq == static_cast<uint32_t>(kFirstBatch) && g_offloader->pendingCount() > 0) {
+            g_earlyReads.increment();
+        }
+        g_offloader->submit(conn, boost::bind(&work, seq));
+    }
+}
+
+void createServer(EventLoop* loop, TcpServer** server) {
+    *server = new TcpServer(loop, InetAddress(kPort, true), "OffloaderTest");
+    (*server)->setMessageCallback(onMessage);
+    (*server)->start();
+}
+
+void destroyServer(TcpServer* server) {
+    delete server;
+}
+
+int connectServer() {
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(kPort);
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    int ret = ::connect(fd, reinterpret_cast<struct sockaddr*>(&sa), sizeof sa);
+    assert(ret == 0);
+    (void)ret;
+    return fd;
+}
+
+void sendBatch(int fd, uint32_t first, int count) {
+    std::vector<uint32_t> seqs;
+    for (int i = 0; i < count; ++i) {
+        seqs.push_back(first + i);
+    }
+    ssize_t n = ::write(fd, &seqs[0], seqs.size() * sizeof(uint32_t));
+    assert(n == static_cast<ssize_t>(seqs.size() * sizeof(uint32_t)));
+    (void)n;
+}
+
+size_t executedCount() {
+    MutexLockGuard lock(g_mutex);
+    return g_executed.size();
+}
+
+int main() {
+    ThreadPool pool("OffloaderPool");
+    pool.setMaxQueueSize(2);
+    pool.start(1);
+    TaskOffloader offloader(&pool, 1);
+    g_offloader = &offloader;
+
+    EventLoopThread loopThread;
+    EventLoop* loop = loopThread.startLoop();
+    TcpServer* server = NULL;
+    loop->runInLoop(boost::bind(&createServer, loop, &server));
+    usleep(100 * 1000);
+
+    int fd = connectServer();
+    sendBatch(fd, 0, kFirstBatch);
+    while (g_received.get() < kFirstBatch) {
+        usleep(1000);
+    }
+    assert(offloader.pendingCount() > 0); //线程池已经满了
+
+    // 暂存的任务还没有全部重新提交，连接处于暂停读的状态
+    sendBatch(fd, kFirstBatch, kSecondBatch);
+
+    const size_t kTotal = kFirstBatch + kSecondBatch;
+    for (int i = 0; i < 5000 && executedCount() < kTotal; ++i) {
+        usleep(1000);
+    }
+
+    printf("received %d, executed %zu, paused %ld, rejected %ld, early reads %d\n",
+           g_received.get(), executedCount(), offloader.pausedCount(),
+           pool.rejectedCount(), g_earlyReads.get());
+    assert(g_received.get() == static_cast<int>(kTotal));
+    assert(executedCount() == kTotal);
+    assert(offloader.pausedCount() > 0);
+    assert(g_earlyReads.get() == 0);
+    {
+        MutexLockGuard lock(g_mutex);
+        for (size_t i = 0; i < g_executed.size(); ++i) {
+            assert(g_executed[i] == i);
+        }
+    }
+
+    ::close(fd);
+    loop->runInLoop(boost::bind(&destroyServer, server));
+    usleep(100 * 1000);
+    pool.stop();
+    printf("done\n");
+}
@@ -0,0 +1,169 @@
+#include "../timer.h"
+
+#include "../eventloop.h"
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace kaycc;
+using namespace kaycc::net;
+
+// 1. Timer的slack对齐：到期时间向上对齐到slack的整数倍，不早于要求的时间，最多晚slack；slack为0时不对齐
+// 2. timerfd模式和精确模式（KAYCC_PRECISE_TIMER）下，runAfter/runEvery都不会提前触发，
+//    包括在循环里已经花掉一段处理时间之后再添加的定时器
+
+void noop() {
+}
+
+void testAlignment() {
+    const double kSlacks[] = {0.0, 0.000001, 0.0005, 0.001, 0.01, 0.25};
+    const int64_t kBase = 1234567890123LL;
+    for (size_t i = 0; i < sizeof kSlacks / sizeof kSlacks[0]; ++i) {
+        int64_t slackUs = static_cast<int64_t>(kSlacks[i] * Timestamp::kMicroSecondsPerSecond);
+        for (int64_t offset = 0; offset < 2000; offset += 7) {
+            Timestamp when(kBase + offset);
+            Timer timer(noop, when, 0.0, kSlacks[i]);
+            int64_t us = timer.expiration().microSecondsSinceEpoch();
+            assert(us >= when.microSecondsSinceEpoch());
+            if (slackUs == 0) {
+                assert(us == when.microSecondsSinceEpoch());
+            } else {
+                assert(us % slackUs == 0);
+                assert(us - when.microSecondsSinceEpoch() < slackUs);
+            }
+        }
+    }
+
+    // 已经对齐的时间不变
+    Timer aligned(noop, Timestamp(1000000), 0.0, 0.001);
+    assert(aligned.expiration().microSecondsSinceEpoch() == 1000000);
+
+    // 重复定时器重新计算的到期时间也要对齐
+    Timer repeat(noop, Timestamp(1000), 0.003, 0.002);
+    repeat.restart(Timestamp(5001));
+    int64_t us = repeat.expiration().microSecondsSinceEpoch();
+    assert(us >= 8001 && us % 2000 == 0 && us - 8001 < 2000);
+}
+
+struct Expectation {
+    Timestamp earliest; //最早允许触发的单调时间
+    bool fired;
+};
+
+EventLoop* g_loop = NULL;
+std::vector<Expectation> g_expected;
+int g_pending = 0;
+int g_earlyFires = 0;
+double g_maxLateMs = 0.0;
+
+void check(size_t index) {
+    Expectation& e = g_expected[index];
+    Timestamp now(Timestamp::monotonicNow());
+    double lateMs = timeDifference(now, e.earliest) * 1000;
+    if (lateMs < 0) {
+        ++g_earlyFires;
+        printf("timer %zu fired %.3f ms early\n", index, -lateMs);
+    }
+    g_maxLateMs = std::max(g_maxLateMs, lateMs);
+    if (!e.fired) {
+        e.fired = true;
+        if (--g_pending == 0) {
+            g_loop->quit();
+        }
+    }
+}
+
+size_t expect(double delay) {
+    Expectation e;
+    e.earliest = addTime(Timestamp::monotonicNow(), delay);
+    e.fired = false;
+    g_expected.push_back(e);
+    ++g_pending;
+    return g_expected.size() - 1;
+}
+
+void addAfter(double delay, double slack) {
+    size_t index = expect(delay);
+    g_loop->runAfter(delay, boost::bind(&check, index), slack);
+}
+
+const int kTicks = 20;
+int g_ticks = 0;
+Timestamp g_everyStart;
+
+// 第k次触发不早于 添加时间 + k * interval
+void tick(double interval) {
+    ++g_ticks;
+    Timestamp earliest(addTime(g_everyStart, interval * g_ticks));
+    if (Timestamp::monotonicNow() < earliest) {
+        ++g_earlyFires;
+        printf("runEvery tick %d fired early\n", g_ticks);
+    }
+    if (g_ticks == kTicks) {
+        if (--g_pending == 0) {
+            g_loop->quit();
+        }
+    }
+}
+
+// 在循环里先忙5毫秒，再添加定时器，计时起点必须是添加的时刻而不是本次循环开始的时刻
+void busyThenAdd() {
+    usleep(5000);
+    addAfter(0.001, 0.0);
+    addAfter(0.002, 0.0005);
+}
+
+void runTimers(bool precise) {
+    if (precise) {
+        ::setenv("KAYCC_PRECISE_TIMER", "1", 1);
+    } else {
+        ::unsetenv("KAYCC_PRECISE_TIMER");
+    }
+
+    g_expected.clear();
+    g_pending = 0;
+    g_earlyFires = 0;
+    g_maxLateMs = 0.0;
+    g_ticks = 0;
+
+    EventLoop loop;
+    g_loop = &loop;
+    const double kDelays[] = {0.0005, 0.001, 0.003, 0.01, 0.02};
+    const double kSlacks[] = {0.0, 0.0001, 0.001, 0.005};
+    for (size_t i = 0; i < sizeof kDelays / sizeof kDelays[0]; ++i) {
+        for (size_t j = 0; j < sizeof kSlacks / sizeof kSlacks[0]; ++j) {
+            addAfter(kDelays[i], kSlacks[j]);
+        }
+    }
+
+    const double kInterval = 0.002;
+    ++g_pending;
+    g_everyStart = Timestamp::monotonicNow();
+    loop.runEvery(kInterval, boost::bind(&tick, kInterval));
+    loop.runAfter(0.005, boost::bind(&busyThenAdd)); //runEvery要40毫秒才结束，循环不会在它之前退出
+
+    loop.loop();
+    g_loop = NULL;
+
+    printf("%s: %zu timers, %d ticks, early %d, max late %.3f ms\n",
+           precise ? "precise" : "timerfd", g_expected.size(), g_ticks, g_earlyFires, g_maxLateMs);
+    assert(g_earlyFires == 0);
+    assert(g_ticks >= kTicks);
+    for (size_t i = 0; i < g_expected.size(); ++i) {
+        assert(g_expected[i].fired);
+    }
+}
+
+int main() {
+    testAlignment();
+    runTimers(false);
+    runTimers(true);
+    printf("done\n");
+}
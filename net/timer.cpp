@@ -7,8 +7,19 @@ AtomicInt64 Timer::s_numCreated_;
 
 void Timer::restart(Timestamp now) {
     if (repeat_) {
-        expiration_ = addTime(now, interval_);
+        expiration_ = alignExpiration(addTime(now, interval_), slack_);
     } else {
         expiration_ = Timestamp::invalid();
     }
 }
+
+Timestamp Timer::alignExpiration(Timestamp when, double slack) {
+    int64_t slackUs = static_cast<int64_t>(slack * Timestamp::kMicroSecondsPerSecond);
+    if (slackUs <= 0 || !when.valid()) {
+        return when;
+    }
+
+    // 向上取整，保证定时器不会提前触发，最多延迟slack
+    int64_t us = when.microSecondsSinceEpoch();
+    return Timestamp((us + slackUs - 1) / slackUs * slackUs);
+}
@@ -10,22 +10,26 @@
 namespace kaycc {
 namespace net {
 
+    // slack为允许的延迟（秒），超时时间会向上对齐到slack的整数倍，
+    // 这样相近的定时器会落在同一个时间点上，由TimerQueue一次批量触发，减少唤醒次数
     class Timer : boost::noncopyable {
     public:
-        Timer(const TimerCallback& cb, Timestamp when, double interval)
+        Timer(const TimerCallback& cb, Timestamp when, double interval, double slack = 0.0)
             : callback_(cb),
-              expiration_(when),
+              expiration_(alignExpiration(when, slack)),
               interval_(interval),
+              slack_(slack),
               repeat_(interval > 0),
               sequence_(s_numCreated_.incrementAndGet()) {
 
             }
 
     #if __cpluscplus >= 201103L
-        Timer(const TimerCallback&& cb, Timestamp when, double interval)
+        Timer(const TimerCallback&& cb, Timestamp when, double interval, double slack = 0.0)
             : callback_(std::move(cb)),
-              expiration_(when),
+              expiration_(alignExpiration(when, slack)),
               interval_(interval),
+              slack_(slack),
               repeat_(interval > 0),
               sequence_(s_numCreated_.incrementAndGet()) {
 
@@ -44,6 +48,10 @@ namespace net {
             return repeat_;
         }
 
+        double slack() const {
+            return slack_;
+        }
+
         int64_t sequence() const {
             return sequence_;
         }
@@ -55,9 +63,13 @@ namespace net {
         }
 
     private:
+        // 把when向上对齐到slack的整数倍，slack <= 0时不对齐
+        static Timestamp alignExpiration(Timestamp when, double slack);
+
         const TimerCallback callback_;
         Timestamp expiration_;
         const double interval_;
+        const double slack_;
         const bool repeat_;
         const int64_t sequence_;
 
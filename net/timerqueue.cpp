@@ -21,17 +21,17 @@ namespace detail {
     int createTimerfd() {
         int timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
         if (timerfd < 0) {
-            LOG << "Failed in timerfd_create" << std::endl;
+            LOG_ERROR << "Failed in timerfd_create" << std::endl;
         }
 
         return timerfd;
     }
 
-    // 从现在到某一个指定的时间点的时间长度 
-    struct timespec howMuchTimeFromNow(Timestamp when) {
-        int64_t microseconds = when.microSecondsSinceEpoch() -  Timestamp::now().microSecondsSinceEpoch();
-        if (microseconds < 100) {
-            microseconds = 100;
+    // 单调时间转换为timespec，用于TFD_TIMER_ABSTIME，不需要再取一次当前时间
+    struct timespec toTimespec(Timestamp when) {
+        int64_t microseconds = when.microSecondsSinceEpoch();
+        if (microseconds <= 0) { //全0的it_value会停止timerfd
+            microseconds = 1;
         }
 
         struct  timespec ts;
@@ -45,10 +45,10 @@ namespace detail {
         uint64_t howmany;
 
         ssize_t n = ::read(timerfd, &howmany, sizeof(howmany));
-        LOG << "TimerQueue::handleRead() " << howmany << " at " << now.toString() << std::endl;
+        LOG_TRACE << "TimerQueue::handleRead() " << howmany << " at " << now.toString() << std::endl;
 
         if (n != sizeof(howmany)) {
-            LOG << "TimerQueue::handleRead() reads " << n << " bytes instead of 8" << std::endl;
+            LOG_ERROR << "TimerQueue::handleRead() reads " << n << " bytes instead of 8" << std::endl;
         }
     }
     
@@ -68,10 +68,10 @@ namespace detail {
         bzero(&newValue, sizeof(newValue));
         bzero(&oldValue, sizeof(oldValue));
 
-        newValue.it_value = howMuchTimeFromNow(expiration);
-        int ret = ::timerfd_settime(timerfd, 0, &newValue, &oldValue);
+        newValue.it_value = toTimespec(expiration); //已经过去的时间会立即触发
+        int ret = ::timerfd_settime(timerfd, TFD_TIMER_ABSTIME, &newValue, &oldValue);
         if (ret) {
-            LOG << "timerfd_settime()" << std::endl;
+            LOG_ERROR << "timerfd_settime()" << std::endl;
         }
 
     }
@@ -85,19 +85,23 @@ using namespace kaycc;
 using namespace kaycc::net;
 using namespace kaycc::net::detail;
 
-TimerQueue::TimerQueue(EventLoop* loop)
+TimerQueue::TimerQueue(EventLoop* loop, bool useTimerfd)
     : loop_(loop),
-      timerfd_(createTimerfd()),
+      timerfd_(useTimerfd ? createTimerfd() : -1),
       timerfdChannel_(loop, timerfd_),
       timers_(),
-      callingExpiredTimers_(false) {
+      callingExpiredTimers_(false),
+      windowStartWakeups_(0),
+      prevWindowStartWakeups_(0) {
 
-    // 设置超时的回调函数,处理读事件
-    timerfdChannel_.setReadCallback(
-        boost::bind(&TimerQueue::handleRead, this));
+    if (usingTimerfd()) {
+        // 设置超时的回调函数,处理读事件
+        timerfdChannel_.setReadCallback(
+            boost::bind(&TimerQueue::handleRead, this));
 
-     // 设置为可读  
-    timerfdChannel_.enableReading();
+         // 设置为可读  
+        timerfdChannel_.enableReading();
+    }
 
 }
 
@@ -105,9 +109,11 @@ TimerQueue::TimerQueue(EventLoop* loop)
  * 销毁定时器队列 
  */ 
 TimerQueue::~TimerQueue() {
-    timerfdChannel_.disableAll();
-    timerfdChannel_.remove(); //从当前eventloop中移除
-    ::close(timerfd_);
+    if (usingTimerfd()) {
+        timerfdChannel_.disableAll();
+        timerfdChannel_.remove(); //从当前eventloop中移除
+        ::close(timerfd_);
+    }
 
     for (TimerList::iterator it = timers_.begin(); 
         it != timers_.end(); ++it) {
@@ -116,8 +122,8 @@ TimerQueue::~TimerQueue() {
 }
 
 // 添加一个定时器 
-TimerId TimerQueue::addTimer(const TimerCallback& cb, Timestamp when, double interval) {
-    Timer* timer = new Timer(cb, when, interval);
+TimerId TimerQueue::addTimer(const TimerCallback& cb, Timestamp when, double interval, double slack) {
+    Timer* timer = new Timer(cb, when, interval, slack);
     loop_->runInLoop(
         boost::bind(&TimerQueue::addTimerInLoop, this, timer));
 
@@ -125,8 +131,8 @@ TimerId TimerQueue::addTimer(const TimerCallback& cb, Timestamp when, double int
 }
 
 #if __cpluscplus >= 201103L
- TimerId TimerQueue::addTimer(const TimerCallback&& cb, Timestamp when, double interval) {
-    Timer* timer = new Timer(std::move(cb), when, interval);
+ TimerId TimerQueue::addTimer(const TimerCallback&& cb, Timestamp when, double interval, double slack) {
+    Timer* timer = new Timer(std::move(cb), when, interval, slack);
     loop_->runInLoop(
         boost::bind(&TimerQueue::addTimerInLoop, this, timer));
 
@@ -143,7 +149,8 @@ void TimerQueue::cancel(TimerId timerId) {
 void TimerQueue::addTimerInLoop(Timer* timer) {
     loop_->assertInLoopThread();
     bool earliestChanged = insert(timer);
-    if (earliestChanged) { //如果该计时器是最早超时的那个，需要重新设置系统定时器的超时事件
+    if (earliestChanged && usingTimerfd()) { //如果该计时器是最早超时的那个，需要重新设置系统定时器的超时事件
+        // 不使用timerfd时，EventLoop在下一次轮询前会重新计算超时时间，不需要任何系统调用
         // 重新设置系统定时器的超时时间  
         resetTimerfd(timerfd_, timer->expiration());
     }
@@ -174,10 +181,54 @@ void TimerQueue::cancelInLoop(TimerId timerId) {
 
 void TimerQueue::handleRead() {
     loop_->assertInLoopThread();
-    Timestamp now(Timestamp::now());
+    Timestamp now(loop_->cachedMonotonicNow()); //轮询刚刚返回时取的时间
     // 将计时器里数据（这个数据是通过timerfd_settime写入的）读取出来，否则会重复激发定时器  
     readTimerfd(timerfd_, now);
 
+    handleExpired(now);
+}
+
+Timestamp TimerQueue::earliestExpiration() const {
+    loop_->assertInLoopThread();
+    if (timers_.empty()) {
+        return Timestamp::invalid();
+    }
+
+    return timers_.begin()->first;
+}
+
+double TimerQueue::wakeupsPerSecond() const {
+    Timestamp start;
+    int64_t startWakeups = 0;
+    {
+        MutexLockGuard lock(rateMutex_);
+        start = prevWindowStart_.valid() ? prevWindowStart_ : windowStart_;
+        startWakeups = prevWindowStart_.valid() ? prevWindowStartWakeups_ : windowStartWakeups_;
+    }
+    if (!start.valid()) {
+        return 0.0;
+    }
+
+    double elapsed = timeDifference(Timestamp::monotonicNow(), start);
+    if (elapsed <= 0.0) {
+        return 0.0;
+    }
+    return static_cast<double>(wakeups_.get() - startWakeups) / elapsed;
+}
+
+void TimerQueue::handleExpired(Timestamp now) {
+    loop_->assertInLoopThread();
+
+    // 统计唤醒频率，窗口每秒滚动一次，只在这时加锁
+    int64_t wakeups = wakeups_.incrementAndGet();
+    if (!windowStart_.valid() || timeDifference(now, windowStart_) >= 1.0) {
+        MutexLockGuard lock(rateMutex_);
+        prevWindowStart_ = windowStart_;
+        prevWindowStartWakeups_ = windowStartWakeups_;
+        windowStart_ = now;
+        windowStartWakeups_ = wakeups - 1; //这一次唤醒算在新窗口里
+    }
+
     std::vector<Entry> expired = getExpired(now);
 
     callingExpiredTimers_ = true;
@@ -197,8 +248,7 @@ void TimerQueue::handleRead() {
 std::vector<TimerQueue::Entry> TimerQueue::getExpired(Timestamp now) {
     assert(timers_.size() == activeTimers_.size());
     std::vector<Entry> expired;
-    #define UINTPTR_MAX (4294967295U)
-    Entry sentry(now, reinterpret_cast<Timer*>(UINTPTR_MAX));//UINTPTR_MAX, Maximum value of uintptr_t, 2^32-1, or higher
+    Entry sentry(now, reinterpret_cast<Timer*>(UINTPTR_MAX));//UINTPTR_MAX, Maximum value of uintptr_t, 64位系统上是2^64-1，保证超时时间等于now的定时器也被取出
     // 获取所有超时时间比当前时间早的定时器，即已到期的定时器（timers_.begin()与end之间就是所有的已超时的定时器）
     TimerList::iterator end = timers_.lower_bound(sentry); //lower_bound返回第一个不小于sentry的位置
     assert(end == timers_.end() || now < end->first);
@@ -244,7 +294,7 @@ void  TimerQueue::reset(const std::vector<Entry>& expired, Timestamp now) {
     }
 
     // 重新设置系统计时器的超时时间  
-    if (nextExpire.valid()) {
+    if (nextExpire.valid() && usingTimerfd()) {
         resetTimerfd(timerfd_, nextExpire);
     }
 
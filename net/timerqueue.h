@@ -5,6 +5,8 @@
 #include <vector>
 #include <boost/noncopyable.hpp>
 
+#include "../base/atomic.h"
+#include "../base/mutex.h"
 #include "../base/timestamp.h"
 #include "callbacks.h"
 #include "channel.h"
@@ -15,21 +17,45 @@ namespace net {
     class Timer;
     class TimerId;
 
+    // 定时器队列内部的时间全部是单调时钟（Timestamp::monotonicNow()），修改系统时间不会打乱定时器的顺序，
+    // EventLoop::runAt传入的墙上时间在添加时转换为单调时间
     class TimerQueue : boost::noncopyable {
     public:
-        explicit TimerQueue(EventLoop* loop);
+        // useTimerfd为false时不创建timerfd，由EventLoop把最早的超时时间作为轮询的超时时间，
+        // 并在每次轮询返回后调用handleExpired
+        explicit TimerQueue(EventLoop* loop, bool useTimerfd = true);
         ~TimerQueue();
 
         /// Must be thread safe. Usually be called from other threads.  
         // 添加一个定时器 
-        TimerId addTimer(const TimerCallback& cb, Timestamp when, double interval);
+        // slack为允许的延迟（秒），见Timer
+        TimerId addTimer(const TimerCallback& cb, Timestamp when, double interval, double slack = 0.0);
     #if __cpluscplus >= 201103L
-        TimerId addTimer(const TimerCallback&& cb, Timestamp when, double interval);
+        TimerId addTimer(const TimerCallback&& cb, Timestamp when, double interval, double slack = 0.0);
     #endif
 
         // 取消一个定时器  
         void cancel(TimerId timerId);
 
+        bool usingTimerfd() const {
+            return timerfd_ >= 0;
+        }
+
+        // 最早的超时时间，没有定时器时返回Timestamp::invalid()，只能在loop线程调用
+        Timestamp earliestExpiration() const;
+
+        // 执行所有已到期的定时器，只能在loop线程调用
+        void handleExpired(Timestamp now);
+
+        // 因定时器到期而唤醒的总次数，线程安全
+        int64_t wakeups() const {
+            return wakeups_.get();
+        }
+
+        // 最近1~2秒内每秒的定时器唤醒次数，线程安全。在读取时按当前时间计算，
+        // 定时器停下来以后会逐渐降到0
+        double wakeupsPerSecond() const;
+
     private:
 
         typedef std::pair<Timestamp, Timer*> Entry; //计数器的实体类型，key-value，key为时间戳，value为计时器的指针
@@ -49,7 +75,7 @@ namespace net {
 
         // 所属的Reactor
         EventLoop* loop_;
-        const int timerfd_; //定时器文件描述符（Reactor用这个文件描述符产生的事件激活定时器事件处理器）
+        const int timerfd_; //定时器文件描述符（Reactor用这个文件描述符产生的事件激活定时器事件处理器），不使用timerfd时为-1
 
         // 定时器事件通道
         Channel timerfdChannel_;
@@ -60,6 +86,15 @@ namespace net {
         bool callingExpiredTimers_; // 是否正在处理超时任务
         ActiveTimerSet cancelingTimers_; // 被取消的定时器的集合 
 
+        // 唤醒次数统计，只在loop线程修改，其他线程可以读。
+        // 速率窗口每秒向前滚动一次，读取时从上一个窗口的起点算到现在
+        AtomicInt64 wakeups_;
+        mutable MutexLock rateMutex_;
+        Timestamp windowStart_;          // @GuardedBy rateMutex_
+        int64_t windowStartWakeups_;     // @GuardedBy rateMutex_
+        Timestamp prevWindowStart_;      // @GuardedBy rateMutex_
+        int64_t prevWindowStartWakeups_; // @GuardedBy rateMutex_
+
     };
 
 }